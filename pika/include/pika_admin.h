@@ -43,6 +43,8 @@ private:
   int64_t slave_port_;
   int64_t filenum_;
   int64_t pro_offset_;
+  // Offsets of all the binlog shards, the first one is filenum_ pro_offset_
+  std::vector<BinlogOffset> offsets_;
   virtual void DoInitial(const PikaCmdArgsType &argvs, const CmdInfo* const ptr_info);
 };
 
@@ -350,6 +352,8 @@ public:
   virtual void Do();
 private:
   std::string operation_;
+  // Of binlog seek
+  uint32_t seek_time_;
   virtual void DoInitial(const PikaCmdArgsType &argvs, const CmdInfo* const ptr_info);
 };
 #endif
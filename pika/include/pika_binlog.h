@@ -6,10 +6,12 @@
 #ifndef PIKA_BINLOG_H_
 #define PIKA_BINLOG_H_
 
+#include <atomic>
 #include <cstdio>
 #include <list>
 #include <string>
 #include <deque>
+#include <vector>
 #include <pthread.h>
 
 #ifndef __STDC_FORMAT_MACROS
@@ -29,6 +31,50 @@ std::string NewFileName(const std::string name, const uint32_t current);
 
 class Version;
 
+struct BinlogIndexEntry {
+  BinlogIndexEntry(uint64_t _offset = 0, uint64_t _item = 0, uint32_t _time = 0)
+      : offset(_offset), item(_item), time(_time) {}
+  // Where the item starts in the file, its number in the file and its time
+  uint64_t offset;
+  uint64_t item;
+  uint32_t time;
+};
+
+/*
+ * Entries of the index of the binlog file, a torn tail is ignored,
+ * empty if there is no index
+ */
+Status LoadBinlogIndex(const std::string& binlog_file,
+                       std::vector<BinlogIndexEntry>* entries);
+
+/*
+ * Walk the items of a binlog file from offset, which is where an item
+ * starts, the items ending after limit are not returned
+ */
+class BinlogItemScanner {
+ public:
+  BinlogItemScanner(const std::string& filename, uint64_t offset, uint64_t limit);
+  ~BinlogItemScanner();
+
+  // Offset and time of the next item, EndFile if no more
+  Status Next(uint64_t* offset, uint32_t* time);
+
+ private:
+  slash::SequentialFile* file_;
+  Status status_;
+  uint64_t offset_;
+  const uint64_t limit_;
+  // The block offset_ is in
+  char* const block_;
+  uint64_t block_start_;
+  size_t block_len_;
+  bool loaded_;
+
+  // No copying allowed
+  BinlogItemScanner(const BinlogItemScanner&);
+  void operator=(const BinlogItemScanner&);
+};
+
 class Binlog {
  public:
   Binlog(const std::string& Binlog_path, const int file_size = 100 * 1024 * 1024);
@@ -40,12 +86,46 @@ class Binlog {
   Status Put(const std::string &item);
   Status Put(const char* item, int len);
 
+  /*
+   * Group commit, called without the lock. Callers queue their items,
+   * the first one in the queue takes the lock and writes the items queued
+   * so far with one append and one version save, the others wait for it.
+   * Items of one call are written in order and together
+   */
+  Status GroupPut(const std::string &item);
+  Status GroupPut(const std::vector<std::string> &items);
+  /*
+   * Items of the master written as its records were, packed[i] is the
+   * compressed record of items[i] if it was compressed, empty if not.
+   * Nothing is compressed here, so the offsets agree with the master's
+   * whatever compression either side uses
+   */
+  Status GroupPut(const std::vector<std::string> &items,
+                  const std::vector<std::string> &packed);
+
+  /*
+   * Items not shorter than kBinlogCompressMinLen are compressed by snappy
+   * when it saves space, their records are marked by kRecordCompressed
+   */
+  void set_compression(bool compression) { compression_ = compression; }
+  // Items tried to compress, their bytes before and after, time it took
+  uint64_t compress_in_bytes()  { return compress_in_bytes_; }
+  uint64_t compress_out_bytes() { return compress_out_bytes_; }
+  uint64_t compress_micros()    { return compress_micros_; }
+
   Status GetProducerStatus(uint32_t* filenum, uint64_t* pro_offset);
   /*
    * Set Producer pro_num and pro_offset with lock
    */
   Status SetProducerStatus(uint32_t filenum, uint64_t pro_offset);
 
+  /*
+   * Position of the first item written at or after time, by the index
+   * of the files. It is the producer position with item_time 0 if all
+   * items are older
+   */
+  Status Seek(uint32_t time, uint32_t* filenum, uint64_t* offset, uint32_t* item_time);
+
   static Status AppendBlank(slash::WritableFile *file, uint64_t len);
 
   slash::WritableFile *queue() { return queue_; }
@@ -59,14 +139,45 @@ class Binlog {
 
  private:
 
+  struct Writer;
+
+  // An item to write, as it is or compressed
+  struct Record {
+    Record(const Slice& d, bool c) : data(d), compressed(c) {}
+    Slice data;
+    bool compressed;
+  };
+
   void InitLogFile();
-  Status EmitPhysicalRecord(RecordType t, const char *ptr, size_t n, int *temp_pro_offset);
+  void RollFile();
 
+  /*
+   * The index of the current file, rebuilt from the items after its last
+   * entry when it is behind the file
+   */
+  void NewIndex();
+  void RecoverIndex();
+  void AddIndexEntry(uint64_t offset, uint32_t time);
+  void FlushIndex();
+  void RestoreIndex(uint64_t file_items, uint64_t index_item,
+                    uint64_t index_offset, int block_offset);
+  void EmitPhysicalRecord(RecordType t, bool compressed, const char *ptr, size_t n, uint64_t now);
 
   /*
-   * Produce
+   * Compress the item into *out if it is worth, out is left empty if not
+   */
+  void Compress(const Slice &item, std::string* out);
+  /*
+   * Encode the item into buf_ as records of the current file,
+   * return where it starts in buf_
+   */
+  size_t Produce(const Record &record, uint64_t now);
+  /*
+   * Append the items with one append and one version save
+   * Note: mutex lock should be held
    */
-  Status Produce(const Slice &item, int *pro_offset);
+  Status Write(const Record* records, size_t num);
+  Status DoGroupPut(const std::string* items, const std::string* packed, size_t num);
 
   uint32_t consumer_num_;
   uint64_t item_num_;
@@ -75,8 +186,24 @@ class Binlog {
   slash::WritableFile *queue_;
   slash::RWFile *versionfile_;
 
+  // Index of the current file, entries not appended yet, items in the
+  // file and the item and offset of the last entry
+  slash::WritableFile *index_;
+  std::string index_buf_;
+  uint64_t file_items_;
+  uint64_t index_item_;
+  uint64_t index_offset_;
+
   slash::Mutex mutex_;
 
+  // Queue of GroupPut callers, the front one writes for the group
+  slash::Mutex writers_mutex_;
+  std::deque<Writer*> writers_;
+  // Items of the group, used by the front writer only
+  std::vector<Record> group_items_;
+  // Records encoded but not appended yet
+  std::string buf_;
+
   uint32_t pro_num_;
 
   int block_offset_;
@@ -87,6 +214,11 @@ class Binlog {
 
   uint64_t file_size_;
 
+  std::atomic<bool> compression_;
+  std::atomic<uint64_t> compress_in_bytes_;
+  std::atomic<uint64_t> compress_out_bytes_;
+  std::atomic<uint64_t> compress_micros_;
+
   // Not use
   //int32_t retry_;
 
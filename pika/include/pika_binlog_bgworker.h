@@ -22,9 +22,8 @@ class BinlogBGWorker {
   Cmd* GetCmd(const std::string& opt) {
     return GetCmdFromTable(opt, cmds_);
   }
-  void Schedule(PikaCmdArgsType *argv, const std::string& raw_args,
-                uint64_t serial, bool readonly) {
-    BinlogBGArg *arg = new BinlogBGArg(argv, raw_args, serial, readonly, this);
+  void Schedule(PikaCmdArgsType *argv, bool readonly) {
+    BinlogBGArg *arg = new BinlogBGArg(argv, readonly, this);
     binlogbg_thread_.StartThread();
     binlogbg_thread_.Schedule(&DoBinlogBG, static_cast<void*>(arg));
   }
@@ -35,14 +34,11 @@ class BinlogBGWorker {
   pink::BGThread binlogbg_thread_;
   
   struct BinlogBGArg {
-    PikaCmdArgsType *argv;
-    std::string raw_args;
-    uint64_t serial;
+    PikaCmdArgsType *argv; // Logged already by the binlog receiver
     bool readonly; // Server readonly status at the view of binlog dispatch thread
     BinlogBGWorker *myself;
-    BinlogBGArg(PikaCmdArgsType* _argv, const std::string& _raw, uint64_t _s,
-                bool _readonly, BinlogBGWorker* _my)
-        : argv(_argv), raw_args(_raw), serial(_s), readonly(_readonly), myself(_my) {
+    BinlogBGArg(PikaCmdArgsType* _argv, bool _readonly, BinlogBGWorker* _my)
+        : argv(_argv), readonly(_readonly), myself(_my) {
     }
   };
 };
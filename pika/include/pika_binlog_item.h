@@ -0,0 +1,150 @@
+// Copyright (c) 2018-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef PIKA_BINLOG_ITEM_H_
+#define PIKA_BINLOG_ITEM_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "slash/include/slash_coding.h"
+
+/*
+ * Binary binlog item, written instead of the RESP of the command when
+ * binlog-format is binary:
+ *   magic(1) version(1) flags(1) varint64 time of the master in ms
+ *   varint32 argc
+ *   the name, varint32 index in kBinlogCmdNames if kBinlogItemCmdId is set,
+ *     otherwise like an arg
+ *   every arg, varint32 length and the bytes
+ * A RESP item starts with '*', so both kinds may be in one binlog.
+ * It goes to the slave as "binlogb <item>" and is logged there as it is
+ */
+const char kBinlogItemMagic = '\x01';
+const char kBinlogItemVersion = 1;
+const unsigned char kBinlogItemCmdId = 0x01;
+const std::string kBinlogBinaryCmd = "binlogb";
+
+// Append only, the index is in the binlog
+static const char* const kBinlogCmdNames[] = {
+  "set", "del", "expire", "expireat", "pexpire", "pexpireat", "persist",
+  "setex", "setnx", "mset", "msetnx", "incr", "incrby", "incrbyfloat",
+  "decr", "decrby", "getset", "append", "setrange", "setbit",
+  "hset", "hmset", "hsetnx", "hdel", "hincrby", "hincrbyfloat",
+  "lpush", "rpush", "lpushx", "rpushx", "lpop", "rpop", "lset", "lrem",
+  "ltrim", "linsert", "rpoplpush",
+  "sadd", "srem", "spop", "smove", "sunionstore", "sinterstore", "sdiffstore",
+  "zadd", "zincrby", "zrem", "zremrangebyscore", "zremrangebyrank",
+  "zremrangebylex", "zunionstore", "zinterstore",
+  "pfadd", "pfmerge", "geoadd",
+  "ehset", "ehsetnx", "ehsetex", "ehexpire", "ehexpireat", "ehpersist",
+  "ehdel", "ehincrby", "ehincrbyfloat", "ehmset", "ehmsetex",
+};
+const uint32_t kBinlogCmdNum = sizeof(kBinlogCmdNames) / sizeof(kBinlogCmdNames[0]);
+
+inline bool IsBinaryBinlogItem(const std::string& item) {
+  return !item.empty() && item[0] == kBinlogItemMagic;
+}
+
+// Index of the lowercase name in kBinlogCmdNames, -1 if not there
+inline int BinlogCmdId(const std::string& name) {
+  static const std::unordered_map<std::string, int> ids = [] {
+    std::unordered_map<std::string, int> m;
+    for (uint32_t i = 0; i < kBinlogCmdNum; i++) {
+      m[kBinlogCmdNames[i]] = i;
+    }
+    return m;
+  }();
+  char lower[32];
+  if (name.size() >= sizeof(lower)) {
+    return -1;
+  }
+  for (size_t i = 0; i < name.size(); i++) {
+    lower[i] = (name[i] >= 'A' && name[i] <= 'Z') ? name[i] - 'A' + 'a' : name[i];
+  }
+  auto it = ids.find(std::string(lower, name.size()));
+  return it == ids.end() ? -1 : it->second;
+}
+
+inline void EncodeBinlogItem(const std::vector<std::string>& argv,
+                             uint64_t time_ms, std::string* item) {
+  size_t len = 3 + 10 + 5;
+  for (const auto& arg : argv) {
+    len += 5 + arg.size();
+  }
+  item->clear();
+  item->reserve(len);
+  int id = argv.empty() ? -1 : BinlogCmdId(argv[0]);
+  item->push_back(kBinlogItemMagic);
+  item->push_back(kBinlogItemVersion);
+  item->push_back(id >= 0 ? kBinlogItemCmdId : 0);
+  slash::PutVarint64(item, time_ms);
+  slash::PutVarint32(item, argv.size());
+  for (size_t i = 0; i < argv.size(); i++) {
+    if (i == 0 && id >= 0) {
+      slash::PutVarint32(item, id);
+      continue;
+    }
+    slash::PutVarint32(item, argv[i].size());
+    item->append(argv[i]);
+  }
+}
+
+// False if the item is broken or of an unknown version
+inline bool DecodeBinlogItem(const char* p, size_t size,
+                             std::vector<std::string>* argv, uint64_t* time_ms) {
+  const char* limit = p + size;
+  if (size < 3 || p[0] != kBinlogItemMagic || p[1] != kBinlogItemVersion) {
+    return false;
+  }
+  bool has_id = (static_cast<unsigned char>(p[2]) & kBinlogItemCmdId) != 0;
+  uint32_t argc = 0;
+  p = slash::GetVarint64Ptr(p + 3, limit, time_ms);
+  if (p == NULL || (p = slash::GetVarint32Ptr(p, limit, &argc)) == NULL
+      || argc > size) {
+    return false;
+  }
+  argv->resize(argc);
+  for (uint32_t i = 0; i < argc; i++) {
+    uint32_t n = 0;
+    if ((p = slash::GetVarint32Ptr(p, limit, &n)) == NULL) {
+      return false;
+    }
+    if (i == 0 && has_id) {
+      if (n >= kBinlogCmdNum) {
+        return false;
+      }
+      (*argv)[0].assign(kBinlogCmdNames[n]);
+      continue;
+    }
+    if (n > static_cast<size_t>(limit - p)) {
+      return false;
+    }
+    (*argv)[i].assign(p, n);
+    p += n;
+  }
+  return p == limit;
+}
+
+// The RESP of a binary item, for what only reads commands
+inline bool BinlogItemToResp(const std::string& item, std::string* resp) {
+  std::vector<std::string> argv;
+  uint64_t time_ms = 0;
+  if (!DecodeBinlogItem(item.data(), item.size(), &argv, &time_ms)) {
+    return false;
+  }
+  resp->assign("*" + std::to_string(argv.size()) + "\r\n");
+  for (const auto& arg : argv) {
+    resp->append("$" + std::to_string(arg.size()) + "\r\n");
+    resp->append(arg);
+    resp->append("\r\n");
+  }
+  return true;
+}
+
+#endif
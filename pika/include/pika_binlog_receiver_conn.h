@@ -6,6 +6,11 @@
 #ifndef PIKA_BINLOG_RECEIVER_CONN_H_
 #define PIKA_BINLOG_RECEIVER_CONN_H_
 
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "pink/include/pink_conn.h"
 #include "pink/include/redis_parser.h"
 #include "pika_command.h"
@@ -22,10 +27,41 @@ class PikaBinlogReceiverConn: public pink::PinkConn {
 
   bool ProcessBinlogData(const pink::RedisCmdArgsType& argv);
 
+  /*
+   * Since a binlogfence, items of the conn are held until the fence of
+   * every shard came, see PikaBinlogReceiverThread::CompleteFences
+   */
+  bool fenced() const { return fenced_; }
+  int fence_shard() const { return fence_shard_; }
+  uint64_t fence_seq() const { return fence_seq_; }
+  // The first item held, the write behind the fences in shard 0
+  const PikaCmdArgsType* FirstHeld() const {
+    return held_.empty() ? nullptr : held_.front().argv;
+  }
+  void LogFence();
+  void ApplyFirstHeld();
+  // Go on with the items held, up to the next fence
+  void PassFence();
+
  private:
   static int ParserDealMessageCb(pink::RedisParser* parser, const pink::RedisCmdArgsType& argv);
   pink::ReadStatus ParseRedisParserStatus(pink::RedisParserStatus status);
   void RestoreArgs(const PikaCmdArgsType& argv);
+  // "binlogz <item>", the compressed item of one command
+  bool ProcessCompressedBinlog(const pink::RedisCmdArgsType& argv);
+  // The item of "binlogb <item>", see pika_binlog_item.h
+  bool ProcessBinaryBinlog(const std::string& item);
+  /*
+   * Takes v. packed is the compressed record of the item if it came so,
+   * the item is logged as the record of the master was
+   */
+  bool HandleBinlogItem(PikaCmdArgsType* v, const std::string& raw_args,
+                        const std::string& packed);
+  void ApplyBinlogItem(PikaCmdArgsType* v, const std::string& raw_args,
+                       const std::string& packed);
+  bool ArriveFence(PikaCmdArgsType* v, const std::string& raw_args);
+  // Log the items of the read, then dispatch them to be applied
+  void ApplyPendingBinlog();
 
   char* rbuf_;
   int rbuf_len_;
@@ -37,6 +73,28 @@ class PikaBinlogReceiverConn: public pink::PinkConn {
   std::string raw_args_;
 
   pink::RedisParser redis_parser_;
+  // For the items uncompressed
+  std::string unpacked_;
+  pink::RedisParser unpacked_parser_;
+  // The compressed record of the item being parsed by unpacked_parser_
+  std::string packed_;
+
+  // Items of the read, logged per binlog shard in the order they came
+  // in, applied after being logged
+  std::vector<std::vector<std::string> > pending_binlogs_;
+  std::vector<std::vector<std::string> > pending_packed_;
+  std::vector<PikaCmdArgsType*> pending_cmds_;
+
+  struct HeldItem {
+    PikaCmdArgsType* argv;
+    std::string raw_args;
+    std::string packed;
+  };
+  bool fenced_;
+  int fence_shard_;
+  uint64_t fence_seq_;
+  std::string fence_raw_;
+  std::deque<HeldItem> held_;
   PikaBinlogReceiverThread* binlog_receiver_;
 };
 
@@ -26,11 +26,20 @@ class PikaBinlogReceiverThread {
 
   void KillBinlogSender();
 
-  uint64_t GetnPlusSerial() {
-    return serial_++;
-  }
+  /*
+   * Each binlog shard comes on a conn of its own. A write touching keys
+   * of several shards is in shard 0 behind a fence in every shard, the
+   * conns at a fence hold their items until the fence of every shard came
+   * and the write is applied alone. All conns run in the one thread
+   */
+  void ArriveFence(PikaBinlogReceiverConn* conn);
+  void LeaveFence(PikaBinlogReceiverConn* conn);
+  void CompleteFences();
 
  private:
+  bool FenceReady(uint64_t* seq);
+  void WaitBinlogApplied();
+
   class MasterConnFactory : public pink::ConnFactory {
    public:
     explicit MasterConnFactory(PikaBinlogReceiverThread* binlog_receiver)
@@ -67,6 +76,7 @@ class PikaBinlogReceiverThread {
   Handles handles_;
   pink::ServerThread* thread_rep_;
 
-  uint64_t serial_;
+  std::set<PikaBinlogReceiverConn*> fenced_conns_;
+  bool completing_;
 };
 #endif
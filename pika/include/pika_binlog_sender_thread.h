@@ -6,12 +6,15 @@
 #ifndef PIKA_BINLOG_SENDER_THREAD_H_
 #define PIKA_BINLOG_SENDER_THREAD_H_
 
+#include <atomic>
+
 #include "pink/include/pink_thread.h"
 #include "pink/include/pink_cli.h"
 #include "slash/include/slash_slice.h"
 #include "slash/include/slash_status.h"
 #include "slash/include/env.h"
 #include "slash/include/slash_mutex.h"
+#include "pika_binlog.h"
 
 using slash::Status;
 using slash::Slice;
@@ -19,7 +22,7 @@ using slash::Slice;
 class PikaBinlogSenderThread : public pink::Thread {
  public:
 
-  PikaBinlogSenderThread(const std::string &ip, int port,
+  PikaBinlogSenderThread(const std::string &ip, int port, Binlog *logger,
                          slash::SequentialFile *queue,
                          uint32_t filenum, uint64_t con_offset);
 
@@ -29,6 +32,29 @@ class PikaBinlogSenderThread : public pink::Thread {
     return filenum_;
   }
 
+  uint64_t con_offset() {
+    return con_offset_;
+  }
+
+  // Sends and the records they carried since started, for INFO
+  uint64_t send_num() {
+    return send_num_;
+  }
+
+  uint64_t send_records() {
+    return send_records_;
+  }
+
+  uint64_t send_bytes_per_sec() {
+    return send_bytes_per_sec_;
+  }
+
+  // A batch of items failed to send, the slave may have got some of them
+  // and must trysync again from its own offset
+  bool need_resync() {
+    return need_resync_;
+  }
+
   int trim();
   uint64_t get_next(bool &is_error);
   std::string SerializeSlaveCmd();
@@ -36,9 +62,15 @@ class PikaBinlogSenderThread : public pink::Thread {
  private:
 
   Status Parse(std::string &scratch);
+  int AppendAvailable(std::string &batch);
+  void UpdateSendStat(int records, size_t bytes);
   Status Consume(std::string &scratch);
+  Status UnpackItem(std::string &scratch);
+  void WrapItem(const std::string &cmd, std::string &scratch);
   unsigned int ReadPhysicalRecord(slash::Slice *fragment);
 
+  // The binlog shard it ships
+  Binlog* const logger_;
   uint64_t con_offset_;
   uint32_t filenum_;
 
@@ -49,6 +81,23 @@ class PikaBinlogSenderThread : public pink::Thread {
   slash::SequentialFile* queue_;
   char* const backing_store_;
   Slice buffer_;
+  // Item after UnpackItem or WrapItem
+  std::string unpacked_;
+  // replicate-compressed-binlog when the slave came, a later CONFIG SET
+  // does not change what the slave logs halfway
+  const bool ship_compressed_;
+  bool warned_unpack_;
+  // Item appended to the batch by AppendAvailable
+  std::string item_;
+  // Error met by AppendAvailable, returned by the next Parse
+  Status pending_;
+
+  std::atomic<uint64_t> send_num_;
+  std::atomic<uint64_t> send_records_;
+  std::atomic<uint64_t> send_bytes_per_sec_;
+  std::atomic<bool> need_resync_;
+  uint64_t rate_start_us_;
+  uint64_t rate_bytes_;
 
   std::string ip_;
   int port_;
@@ -25,9 +25,16 @@ class PikaBinlogWriterThread : public pink::Thread {
   PikaBinlogWriterThread (int max_deque_size);
   virtual ~PikaBinlogWriterThread ();
 
-  Status WriteBinlog (const std::string &raw_args, bool is_sync);
+  // shard is the binlog shard the key of the command hashes to
+  Status WriteBinlog (const std::string &raw_args, bool is_sync, int shard);
+  // Write the items of the master to a shard as one group and wait for
+  // it, packed[i] is the compressed record of raw_args[i] if it came so
+  Status WriteBinlog (const std::vector<std::string> &raw_args,
+                      const std::vector<std::string> &packed, int shard);
   bool BinlogIoError();
   bool IsBinlogWriterIdle();
+  // Block till the commands pushed so far are in the binlog
+  void WaitBinlogWriterIdle();
   void SetMaxCmdsQueueSize(size_t max_size);
   void SetBinlogIoError(bool error);
 
@@ -38,10 +45,11 @@ class PikaBinlogWriterThread : public pink::Thread {
   slash::Mutex binlog_mutex_protector_;
   slash::CondVar binlog_read_cond_;         // 可读条件变量
   slash::CondVar binlog_write_cond_;        // 可写条件变量
+  slash::CondVar binlog_idle_cond_;         // 空闲条件变量
   std::atomic<bool> binlog_io_error_;       // 标记写binlog是否出现异常
   std::atomic<bool> is_binlog_writer_idle_; // 标记线程是否处于空闲状态
   size_t max_cmds_deque_size_ ;             // 缓冲区最大值
-  std::deque<std::string> cmds_deque_;      // 命令缓冲队列
+  std::deque<std::pair<int, std::string> > cmds_deque_;  // 命令缓冲队列，<binlog分片，命令>
 
   virtual void* ThreadMain();
 };
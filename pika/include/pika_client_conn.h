@@ -25,6 +25,9 @@ class PikaClientConn: public pink::RedisConn {
     std::string* response;
     uint64_t recv_cmd_time_us;
     uint32_t queue_size;
+    int priority;
+    // redis_cmds[0] already missed the cache in the network thread
+    bool cache_missed;
   };
 
   PikaClientConn(int fd, std::string ip_port, pink::ServerThread *server_thread,
@@ -33,16 +36,22 @@ class PikaClientConn: public pink::RedisConn {
   virtual ~PikaClientConn() {}
 
   void SyncProcessRedisCmd(const pink::RedisCmdArgsType& argv, std::string* response) override;
-  void AsynProcessRedisCmds(const std::vector<pink::RedisCmdArgsType>& argvs, std::string* response) override;
+  void AsynProcessRedisCmds(std::vector<pink::RedisCmdArgsType>* argvs, std::string* response) override;
 
+  // priority is the thread pool it ran in, reads waited there longer than
+  // the pool's queue deadline are answered with an error.
+  // cache_missed: argvs[0] missed the cache already, read rocksdb directly
   void BatchExecRedisCmd(const std::vector<pink::RedisCmdArgsType>& argvs,
                          std::string* response,
                          uint64_t recv_cmd_time_us,
-                         uint32_t queue_size);
+                         uint32_t queue_size,
+                         int priority,
+                         bool cache_missed = false);
   int ExecRedisCmd(const pink::RedisCmdArgsType& argv,
                    std::string* response,
                    uint64_t recv_cmd_time_us,
-                   uint32_t queue_size);
+                   uint32_t queue_size,
+                   bool cache_missed = false);
 
   int DealMessage(const pink::RedisCmdArgsType& argv, std::string* response);
   static void DoBackgroundTask(void* arg);
@@ -58,12 +67,29 @@ class PikaClientConn: public pink::RedisConn {
   static std::atomic<uint64_t> slowlog_count_;
   static slash::Mutex slowlog_mutex_;
 
-  std::string DoCmd(const PikaCmdArgsType& argv,
-                    const std::string& opt,
-                    uint64_t recv_cmd_time_us,
-                    uint32_t queue_size);
+  // Append the reply to *reply
+  void DoCmd(const PikaCmdArgsType& argv,
+             uint64_t recv_cmd_time_us,
+             uint32_t queue_size,
+             bool cache_missed,
+             std::string* reply);
   std::string RestoreArgs(const PikaCmdArgsType& argv);
 
+  // Serve cache hit reads in the network thread, *cache_missed tells
+  // a read left to the thread pool because it missed the cache
+  bool CanInlineCacheRead();
+  bool InlineCacheRead(const PikaCmdArgsType& argv, bool* cache_missed);
+
+  // Some command of the pipeline was costly lately, see adaptive-slow-threshold
+  bool IsCostlyBatch(const std::vector<pink::RedisCmdArgsType>& argvs);
+
+  // Run of GET in a pipeline, served by one MultiGet
+  size_t BatchGetNum(const std::vector<pink::RedisCmdArgsType>& argvs, size_t begin);
+  void BatchGet(const std::vector<pink::RedisCmdArgsType>& argvs,
+                size_t begin, size_t num,
+                uint64_t recv_cmd_time_us,
+                bool first_cache_missed);
+
   // Auth related
   class AuthStat {
    public:
@@ -86,6 +112,7 @@ struct ClientInfo {
   std::string ip_port;
   int64_t last_interaction;
   std::shared_ptr<PikaClientConn> conn;
+  uint64_t pending_reply_len;
 };
 
 #endif
@@ -5,25 +5,27 @@
 
 #ifndef PIKA_CMD_TABLE_MANAGER_H_
 #define PIKA_CMD_TABLE_MANAGER_H_
-#include <unistd.h>
-#include <sys/types.h>
-#include <sys/syscall.h>
+#include <vector>
 
 #include "slash/include/slash_mutex.h"
 #include "pika_command.h"
 
-#define gettid() syscall(__NR_gettid)
-
+// Every thread running commands gets its own Cmd objects, indexed by
+// GetCmdIndex. There is only one manager in the process, so the table of
+// the current thread is found by a thread_local pointer without any lock
 class PikaCmdTableManager {
  public:
   PikaCmdTableManager();
   virtual ~PikaCmdTableManager();
-  Cmd* GetCmd(const std::string& opt);
+  // opt is matched ignoring case, the CmdInfo is returned by info if not NULL
+  Cmd* GetCmd(const std::string& opt, const CmdInfo** info = NULL);
  private:
-  void InsertCurrentThreadCmdTable();
-  bool CheckCurrentThreadCmdTableExist(const pid_t& tid);
+  typedef std::vector<Cmd*> IndexedCmdTable;
+  IndexedCmdTable* InsertCurrentThreadCmdTable();
+
+  static thread_local IndexedCmdTable* thread_cmd_table_;
 
-  pthread_rwlock_t map_protector_;
-  std::unordered_map<pid_t, CmdTable*> thread_table_map_;
+  slash::Mutex tables_mutex_;
+  std::vector<IndexedCmdTable*> tables_;
 };
 #endif
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <map>
+#include <string>
 #include <atomic>
 
 #include "strings.h"
@@ -166,5 +167,63 @@ private:
 	pthread_rwlock_t rwlock_;
 };
 
+// 线程池排队时间分布，以及因超过排队时限被丢弃的读命令数
+const int32_t QueueAgeBucketNum = 11;
+
+class QueueAgeStats {
+public:
+	QueueAgeStats() : shed_(0) {
+		Reset();
+	}
+
+	void Add(uint64_t age_us);
+	void AddShed(uint64_t num) { shed_ += num; }
+	uint64_t shed() const { return shed_; }
+	// like "1=10,2=3,...,1000=0,inf=0", key is the upper bound in ms
+	std::string ToString() const;
+	void Reset();
+
+private:
+	std::atomic<uint64_t> buckets_[QueueAgeBucketNum];
+	std::atomic<uint64_t> shed_;
+};
+
+// 根据观测到的执行耗时学习命令的代价，用于快慢线程池的自动分流：
+// 一个命令的平均耗时超过阈值，或者它最近在某个key上执行超过阈值（比如大hash上的hgetall），
+// 之后同样的请求就交给慢线程池，不再堵住快线程池
+const int32_t CostKeySlotNum = 4096;
+const int32_t CostKeyTtlSec = 60;
+
+class CmdCostStats {
+public:
+	// cmd_num: number of command index, see GetCmdNum()
+	explicit CmdCostStats(int cmd_num);
+	~CmdCostStats();
+
+	// Execution time of the command with the index on the key, queue time
+	// not included. key is empty for commands without one
+	void Record(int cmd_index, const std::string& key, uint64_t cost_us, uint64_t threshold_us);
+	bool IsCostly(int cmd_index, const std::string& key, uint64_t threshold_us) const;
+	uint64_t AvgCost(int cmd_index) const;
+
+	void AddRouted(uint64_t num) { routed_ += num; }
+	uint64_t routed() const { return routed_; }
+	void ResetRouted() { routed_.store(0); }
+
+private:
+	void Reset();
+	static uint64_t KeyHash(int cmd_index, const std::string& key);
+
+	int cmd_num_;
+	// Moving average of the cost in us, one per command index
+	std::atomic<uint64_t>* avg_us_;
+	// Direct mapped, high 32 bits of the hash of (command, key) | last
+	// costly time in seconds, 0 if empty
+	std::atomic<uint64_t> costly_keys_[CostKeySlotNum];
+	std::atomic<uint64_t> routed_;
+
+	CmdCostStats(const CmdCostStats&);
+	void operator=(const CmdCostStats&);
+};
 
 #endif
@@ -285,6 +285,9 @@ public:
   uint32_t flag_type() const {
     return flag_ & kCmdFlagsMaskType;
   }
+  bool is_admin() const {
+    return ((flag_ & kCmdFlagsAdmin) == kCmdFlagsAdmin);
+  }
   bool is_local() const {
     return ((flag_ & kCmdFlagsMaskLocal) == kCmdFlagsLocal);
   }
@@ -338,7 +341,7 @@ public:
   bool need_write_cache() const {
     return ((flag_ & kCmdFlagsMaskPostDo) == kCmdFlagsPostDo);
   }
-  std::string name() const {
+  const std::string& name() const {
     return name_;
   }
 
@@ -353,6 +356,7 @@ private:
 
 void inline RedisAppendContent(std::string& str, const std::string& value);
 void inline RedisAppendLen(std::string& str, int64_t ori, const std::string &prefix);
+void inline RedisAppendLen(std::string& str, int64_t ori, char prefix);
 
 const std::string kNewLine = "\r\n";
 
@@ -400,6 +404,25 @@ public:
   std::string raw_message() const {
     return message_;
   }
+  // Move the reply out instead of copying it, the cmd is reset by the next Initial
+  std::string TakeMessage() {
+    if (ret_ == kNone) {
+      return std::move(message_);
+    }
+    return message();
+  }
+  // Append the reply to out, message_ keeps its buffer for the next command
+  // of the thread, unless out is empty and too small to take the reply
+  void AppendMessageTo(std::string* out) {
+    if (ret_ != kNone) {
+      out->append(message());
+    } else if (out->empty() && out->capacity() < message_.size()) {
+      out->swap(message_);
+    } else {
+      out->append(message_);
+    }
+    message_.clear();
+  }
   std::string message() const {
     std::string result;
     switch (ret_) {
@@ -461,13 +484,13 @@ public:
 
   // Inline functions for Create Redis protocol
   void AppendStringLen(int64_t ori) {
-    RedisAppendLen(message_, ori, "$");
+    RedisAppendLen(message_, ori, '$');
   }
   void AppendArrayLen(int64_t ori) {
-    RedisAppendLen(message_, ori, "*");
+    RedisAppendLen(message_, ori, '*');
   }
   void AppendInteger(int64_t ori) {
-    RedisAppendLen(message_, ori, ":");
+    RedisAppendLen(message_, ori, ':');
   }
   void AppendContent(const std::string &value) {
     RedisAppendContent(message_, value);
@@ -531,6 +554,13 @@ void InitCmdInfoTable();
 const CmdInfo* GetCmdInfo(const std::string& opt);
 void DestoryCmdInfoTable();
 
+// Every command has an index in [0, GetCmdNum()), found by a perfect hash
+// over the command names which ignores case, so argv[0] needs no lowercase
+// copy. Return -1 if opt is not a command
+int GetCmdIndex(const std::string& opt);
+int GetCmdNum();
+const CmdInfo* GetCmdInfoByIndex(int index);
+
 // Method for Cmd Table
 void InitCmdTable(CmdTable* cmd_table);
 Cmd* GetCmdFromTable(const std::string& opt, const CmdTable& cmd_table);
@@ -541,10 +571,17 @@ void inline RedisAppendContent(std::string& str, const std::string& value) {
   str.append(kNewLine);
 }
 void inline RedisAppendLen(std::string& str, int64_t ori, const std::string &prefix) {
+  if (prefix.size() == 1) {
+    pink::AppendRedisLen(&str, ori, prefix[0]);
+    return;
+  }
   char buf[32];
   slash::ll2string(buf, 32, static_cast<long long>(ori));
   str.append(prefix);
   str.append(buf);
   str.append(kNewLine);
 }
+void inline RedisAppendLen(std::string& str, int64_t ori, char prefix) {
+  pink::AppendRedisLen(&str, ori, prefix);
+}
 #endif
@@ -21,6 +21,11 @@ public:
     static std::string TimestampToDate(int64_t timestamp);
 
     static std::string AppendSubDirectory(const std::string& db_path, const std::string& sub_path);
+
+    // Sst and titan blob files, which never change once written
+    static bool IsImmutableDBFile(const std::string& path);
+    // crc32c of the whole file
+    static bool FileChecksum(const std::string& path, uint32_t* checksum);
     
 private:
     PikaCommonFunc();
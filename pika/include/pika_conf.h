@@ -17,6 +17,7 @@
 #include "slash/include/slash_mutex.h"
 #include "slash/include/slash_string.h"
 #include "slash/include/xdebug.h"
+#include "pink/include/pink_conn.h"
 #include "pika_define.h"
 
 typedef slash::RWLock RWLock;
@@ -31,6 +32,7 @@ public:
     std::string slaveof()           { RWLock l(&rwlock_, false); return slaveof_;}
     int slave_priority()            { return slave_priority_;}
     int thread_num()                { return thread_num_; }
+    bool reuse_port()               { return reuse_port_; }
     int sync_thread_num()           { return sync_thread_num_; }
     int sync_buffer_size()          { return sync_buffer_size_; }
     std::string log_path()          { RWLock l(&rwlock_, false); return log_path_; }
@@ -40,6 +42,8 @@ public:
     std::string binlog_path()       { RWLock l(&rwlock_, false); return binlog_path_; }
     std::string db_sync_path()      { RWLock l(&rwlock_, false); return db_sync_path_; }
     int db_sync_speed()             { return db_sync_speed_; }
+    int db_sync_parallel()          { return db_sync_parallel_; }
+    bool db_sync_rsync()            { return db_sync_rsync_; }
     std::string compact_cron()      { RWLock l(&rwlock_, false); return compact_cron_; }
     std::string compact_interval()  { RWLock l(&rwlock_, false); return compact_interval_; }
     int64_t write_buffer_size()     { return write_buffer_size_; }
@@ -80,10 +84,21 @@ public:
     int binlog_writer_queue_size()  { return binlog_writer_queue_size_; }
     std::string binlog_writer_method() { RWLock l(&rwlock_, false); return binlog_writer_method_; }
     int binlog_writer_num()         { return binlog_writer_num_; }
+    int binlog_shard_num()          { return binlog_shard_num_; }
+    std::string binlog_compression() { RWLock l(&rwlock_, false); return binlog_compression_; }
+    bool replicate_compressed_binlog() { return replicate_compressed_binlog_; }
+    bool binlog_binary_format()     { return binlog_binary_format_; }
     std::string conf_path()         { RWLock l(&rwlock_, false); return conf_path_; }
     bool readonly()                 { return readonly_; }
     int maxclients()                { return maxclients_; }
     int root_connection_num()       { return root_connection_num_; }
+    // Like "normal 0 0 0 pubsub 33554432 8388608 60 monitor 33554432 8388608 60"
+    std::string client_output_buffer_limit();
+    pink::OutputBufferLimit client_output_buffer_limit(pink::OutputBufferClass type) {
+        RWLock l(&rwlock_, false);
+        return client_output_buffer_limit_[type];
+    }
+    int64_t client_output_buffer_pause() { return client_output_buffer_pause_; }
     int slowlog_slower_than()       { return slowlog_log_slower_than_; }
     int slowlog_max_len()           { return slowlog_max_len_;}
     int64_t slowlog_token_capacity()   { return slowlog_token_capacity_; }
@@ -108,6 +123,7 @@ public:
     int cache_maxmemory_policy()    { return cache_maxmemory_policy_; }
     int cache_maxmemory_samples()   { return cache_maxmemory_samples_; }
     int cache_lfu_decay_time()      { return cache_lfu_decay_time_; }
+    bool cache_read_inline()        { return cache_read_inline_; }
 
     // Immutable config items, we don't use lock.
     bool daemonize()                { return daemonize_; }
@@ -138,7 +154,13 @@ public:
     bool use_thread_pool()          { return use_thread_pool_; }
     int fast_thread_pool_size()     { return fast_thread_pool_size_; }
     int slow_thread_pool_size()     { return slow_thread_pool_size_; }
+    // Max ms a request may wait in the pool, 0 means no limit
+    int fast_pool_queue_deadline()  { return fast_pool_queue_deadline_; }
+    int slow_pool_queue_deadline()  { return slow_pool_queue_deadline_; }
     const std::string slow_cmd_list() { RWLock l(&rwlock_, false); return slash::MapKeysToString(slow_cmd_map_, COMMA); }
+    // Commands slower than it in us, on average or on one key, go to the slow pool, 0 means off
+    int adaptive_slow_threshold()   { return adaptive_slow_threshold_; }
+    const std::string fast_cmd_list() { RWLock l(&rwlock_, false); return slash::MapKeysToString(fast_cmd_map_, COMMA); }
     
     // Setter
     void SetPort(const int value)           { port_ = value; }
@@ -176,11 +198,15 @@ public:
     void SetBinlogWriterQueueSize(const int value)  { binlog_writer_queue_size_ = value; }
     void SetMaxConnection(const int value)          { maxclients_ = value; }
     void SetRootConnectionNum(const int value)      { root_connection_num_ = value; }
+    // Classes not in value are kept, return false if value is malformed
+    bool SetClientOutputBufferLimit(const std::string& value);
+    void SetClientOutputBufferPause(const int64_t value) { client_output_buffer_pause_ = value; }
     void SetSlowlogSlowerThan(const int value)      { slowlog_log_slower_than_ = value; }
     void SetSlowlogMaxLen(const int value)          { slowlog_max_len_ = value; }
     void SetSlowlogTokenCapacity(const int64_t value)  { slowlog_token_capacity_ = value; }
     void SetSlowlogTokenFillEvery(const int64_t value) { slowlog_token_fill_every_ = value; }
     void SetDbSyncSpeed(const int value)            { db_sync_speed_ = value; }
+    void SetDbSyncParallel(const int value)         { db_sync_parallel_ = value; }
     void SetCompactCron(const std::string &value)   { RWLock l(&rwlock_, true); compact_cron_ = value; }
     void SetCompactInterval(const std::string &value) { RWLock l(&rwlock_, true); compact_interval_ = value; }
     void SetTargetFileSizeBase(const int value)     { target_file_size_base_ = value; }
@@ -206,7 +232,11 @@ public:
     void SetCacheMaxmemoryPolicy(const int value)   { cache_maxmemory_policy_ = value; }
     void SetCacheMaxmemorySamples(const int value)  { cache_maxmemory_samples_ = value; }
     void SetCacheLFUDecayTime(const int value)      { cache_lfu_decay_time_ = value; }
+    void SetCacheReadInline(const bool value)       { cache_read_inline_ = value; }
     void SetWriteBinlog(const bool value)           { write_binlog_ = value; }
+    void SetBinlogCompression(const std::string &value) { RWLock l(&rwlock_, true); binlog_compression_ = value; }
+    void SetReplicateCompressedBinlog(const bool value) { replicate_compressed_binlog_ = value; }
+    void SetBinlogBinaryFormat(const bool value)    { binlog_binary_format_ = value; }
     void SetRateBytesPerSec(const int64_t value)    { rate_bytes_per_sec_ = value; }
     void SetDisableWAL(const bool value)            { disable_wal_ = value; }
     void SetMinSystemFreeMem(const int64_t value)   { min_system_free_mem_ = value; }
@@ -228,6 +258,9 @@ public:
 
     void SetUseThreadPool(const bool value)         { use_thread_pool_ = value; }
     void SetFastThreadPoolSize(const int value)     { fast_thread_pool_size_ = value; }
+    void SetFastPoolQueueDeadline(const int value)  { fast_pool_queue_deadline_ = value; }
+    void SetSlowPoolQueueDeadline(const int value)  { slow_pool_queue_deadline_ = value; }
+    void SetAdaptiveSlowThreshold(const int value)  { adaptive_slow_threshold_ = value; }
     void SetSlowThreadPoolSize(const int value)     { slow_thread_pool_size_ = value; }
     void SetSlowCmdList(const std::string &value) {
         RWLock l(&rwlock_, true);
@@ -235,6 +268,12 @@ public:
         slash::StringToLower(lower_value);
         slash::StringToMapKeys(lower_value, COMMA, slow_cmd_map_);
     }
+    void SetFastCmdList(const std::string &value) {
+        RWLock l(&rwlock_, true);
+        std::string lower_value = value;
+        slash::StringToLower(lower_value);
+        slash::StringToMapKeys(lower_value, COMMA, fast_cmd_map_);
+    }
 
     int Load();
     int ConfigRewrite();
@@ -243,12 +282,18 @@ public:
         RWLock l(&rwlock_, false);
         return slow_cmd_map_.find(cmd) != slow_cmd_map_.end() ? true : false;
     }
+    // Never moved to the slow pool by adaptive-slow-threshold
+    bool is_fast_cmd(const std::string &cmd) {
+        RWLock l(&rwlock_, false);
+        return fast_cmd_map_.find(cmd) != fast_cmd_map_.end() ? true : false;
+    }
 
 private:
     std::atomic<int> port_;
     std::string slaveof_;
     std::atomic<int> slave_priority_;
     std::atomic<int> thread_num_;
+    std::atomic<bool> reuse_port_;
     std::atomic<int> sync_thread_num_;
     std::atomic<int> sync_buffer_size_;
     std::string log_path_;
@@ -257,6 +302,8 @@ private:
     std::string db_sync_path_;
     std::atomic<int> expire_dump_days_;
     std::atomic<int> db_sync_speed_;
+    std::atomic<int> db_sync_parallel_;
+    bool db_sync_rsync_;
     std::string compact_cron_;
     std::string compact_interval_;
     std::atomic<int64_t> write_buffer_size_;
@@ -292,10 +339,13 @@ private:
     std::atomic<int> cache_maxmemory_policy_;
     std::atomic<int> cache_maxmemory_samples_;
     std::atomic<int> cache_lfu_decay_time_;
+    std::atomic<bool> cache_read_inline_;
 
     std::string compression_;
     std::atomic<int> maxclients_;
     std::atomic<int> root_connection_num_;
+    pink::OutputBufferLimit client_output_buffer_limit_[pink::kOutputBufferClassNum];
+    std::atomic<int64_t> client_output_buffer_pause_;
     std::atomic<int> slowlog_log_slower_than_;
     std::atomic<int> slowlog_max_len_;
     std::atomic<int> expire_logs_days_;
@@ -303,6 +353,10 @@ private:
     std::atomic<int> binlog_writer_queue_size_;
     std::string binlog_writer_method_;
     std::atomic<int> binlog_writer_num_;
+    std::atomic<int> binlog_shard_num_;
+    std::string binlog_compression_;
+    std::atomic<bool> replicate_compressed_binlog_;
+    std::atomic<bool> binlog_binary_format_;
     std::atomic<bool> readonly_;
     std::string conf_path_;
     std::atomic<int> max_background_flushes_;
@@ -354,7 +408,11 @@ private:
     std::atomic<bool> use_thread_pool_;
     std::atomic<int> fast_thread_pool_size_;
     std::atomic<int> slow_thread_pool_size_;
+    std::atomic<int> fast_pool_queue_deadline_;
+    std::atomic<int> slow_pool_queue_deadline_;
     std::unordered_map<std::string, std::string> slow_cmd_map_;
+    std::atomic<int> adaptive_slow_threshold_;
+    std::unordered_map<std::string, std::string> fast_cmd_map_;
 
     std::atomic<int64_t> slowlog_token_capacity_;
     std::atomic<int64_t> slowlog_token_fill_every_;
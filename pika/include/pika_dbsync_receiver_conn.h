@@ -0,0 +1,50 @@
+// Copyright (c) 2018-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef PIKA_DBSYNC_RECEIVER_CONN_H_
+#define PIKA_DBSYNC_RECEIVER_CONN_H_
+
+#include <string>
+
+#include "pink/include/redis_conn.h"
+#include "slash/include/env.h"
+
+/*
+ * One file at a time is received into "<path>.dbsync" and renamed to
+ * <path> once all of it arrived, see PikaDBSyncSender for the commands
+ */
+class PikaDBSyncReceiverConn: public pink::RedisConn {
+ public:
+  PikaDBSyncReceiverConn(int fd, const std::string& ip_port);
+  virtual ~PikaDBSyncReceiverConn();
+
+  void SyncProcessRedisCmd(const pink::RedisCmdArgsType& argv, std::string* response) override;
+  int DealMessage(const pink::RedisCmdArgsType& argv, std::string* response) override {
+    return 0;
+  }
+
+ private:
+  void FileCmd(const pink::RedisCmdArgsType& argv, std::string* response);
+  void DataCmd(const pink::RedisCmdArgsType& argv);
+  void DoneCmd(const pink::RedisCmdArgsType& argv, std::string* response);
+  void ManifestCmd(const pink::RedisCmdArgsType& argv, std::string* response);
+  void LinkCmd(const pink::RedisCmdArgsType& argv, std::string* response);
+  void ClearCmd(const pink::RedisCmdArgsType& argv, std::string* response);
+  bool CheckModule(const std::string& module);
+  void CloseFile();
+
+  // Full path of the file being received, empty if none
+  std::string path_;
+  uint64_t size_;
+  // Where the next chunk goes
+  uint64_t offset_;
+  // Of the bytes before offset_, checked against the one of dbsyncdone
+  uint32_t checksum_;
+  // A chunk is missing or bad, the file will be sent again
+  bool broken_;
+  slash::RandomRWFile* file_;
+};
+
+#endif
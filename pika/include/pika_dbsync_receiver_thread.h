@@ -0,0 +1,50 @@
+// Copyright (c) 2018-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef PIKA_DBSYNC_RECEIVER_THREAD_H_
+#define PIKA_DBSYNC_RECEIVER_THREAD_H_
+
+#include <set>
+#include <string>
+
+#include "pink/include/server_thread.h"
+#include "pika_dbsync_receiver_conn.h"
+
+/*
+ * Receive the files of a full sync from the master into db-sync-path,
+ * see PikaDBSyncSender
+ */
+class PikaDBSyncReceiverThread {
+ public:
+  PikaDBSyncReceiverThread(const std::set<std::string> &ips, int port, int work_num);
+  ~PikaDBSyncReceiverThread();
+
+  int StartThread();
+
+ private:
+  class DBSyncConnFactory : public pink::ConnFactory {
+   public:
+    virtual std::shared_ptr<pink::PinkConn> NewPinkConn(
+        int connfd,
+        const std::string &ip_port,
+        pink::ServerThread *thread,
+        void* worker_specific_data,
+        pink::PinkEpoll* pink_epoll) const override {
+      return std::make_shared<PikaDBSyncReceiverConn>(connfd, ip_port);
+    }
+  };
+
+  class Handles : public pink::ServerHandle {
+   public:
+    using pink::ServerHandle::AccessHandle;
+    bool AccessHandle(std::string& ip) const override;
+  };
+
+  DBSyncConnFactory conn_factory_;
+  Handles handles_;
+  pink::ServerThread* thread_rep_;
+};
+
+#endif
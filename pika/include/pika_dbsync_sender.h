@@ -0,0 +1,97 @@
+// Copyright (c) 2018-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef PIKA_DBSYNC_SENDER_H_
+#define PIKA_DBSYNC_SENDER_H_
+
+#include <string>
+#include <vector>
+
+#include "pink/include/pink_cli.h"
+#include "pink/include/redis_cli.h"
+#include "pink/include/pink_thread.h"
+#include "slash/include/slash_mutex.h"
+#include "slash/include/slash_status.h"
+
+using slash::Status;
+
+/*
+ * Stream the files of a bgsave to the PikaDBSyncReceiverThread of a slave,
+ * on several connections at once. Each file goes as
+ *   dbsyncfile <module> <path> <size>    replied with the offset to resume at
+ *   dbsyncdata <offset> <crc32> <data>   not replied, checked by the slave
+ *   dbsyncdone <checksum>                replied +OK if the whole file is good
+ * Before that, "dbsyncmanifest <module> [<path> <size>]..." finds the sst
+ * and blob files the slave may have already, each of them is offered by
+ * "dbsynclink <module> <path> <size> <checksum>" first and only sent if
+ * the slave has not got the same one.
+ * At last "dbsyncclear <module> <path>..." removes what the slave has but
+ * the bgsave does not, and the info file goes.
+ * All the connections share one token bucket of db-sync-speed
+ */
+class PikaDBSyncSender {
+ public:
+  PikaDBSyncSender(const std::string& ip, int port,
+                   const std::string& bg_path, const std::string& module);
+  ~PikaDBSyncSender();
+
+  // Return 0 when the slave has all files and the info file
+  int Send();
+
+ private:
+  class Worker : public pink::Thread {
+   public:
+    explicit Worker(PikaDBSyncSender* sender);
+    virtual ~Worker();
+
+    Status Connect();
+    Status SendFile(const std::string& path, uint64_t size);
+    Status LinkFile(const std::string& path, uint64_t size, bool* linked);
+    Status Request(pink::RedisCmdArgsType& argv, std::string* reply);
+
+   private:
+    PikaDBSyncSender* const sender_;
+    pink::PinkCli* cli_;
+    std::string wbuf_;
+    char* const scratch_;
+
+    virtual void* ThreadMain();
+  };
+
+  struct File {
+    File(const std::string& _path, uint64_t _size)
+        : path(_path), size(_size), reusable(false) {}
+    std::string path;
+    uint64_t size;
+    // The slave may have it, try dbsynclink first
+    bool reusable;
+  };
+
+  bool ListFiles(const std::string& dir, const std::string& prefix);
+  void ExchangeManifest();
+  bool NextFile(File* file);
+  void FileFailed(const File& file);
+  void FileReused(const File& file);
+  void Throttle(size_t bytes);
+
+  const std::string ip_;
+  const int port_;
+  const std::string bg_path_;
+  const std::string module_;
+
+  // Files to send, the biggest first
+  slash::Mutex files_mutex_;
+  std::vector<File> files_;
+  size_t next_file_;
+  bool failed_;
+  uint64_t reused_num_;
+  uint64_t reused_bytes_;
+
+  slash::Mutex bucket_mutex_;
+  int64_t tokens_;
+  uint64_t last_refill_us_;
+};
+
+#endif
@@ -6,6 +6,7 @@
 #ifndef PIKA_DEFINE_H_
 #define PIKA_DEFINE_H_
 
+#include <vector>
 
 #define PIKA_MAX_WORKER_THREAD_NUM 128
 
@@ -29,9 +30,18 @@ struct SlaveItem {
   int hb_fd;
   int stage;
   void* sender;
+  // Senders of binlog shards 1 ~ n-1, the one of shard 0 is sender
+  std::vector<void*> shard_senders;
   struct timeval create_time;
 };
 
+struct BinlogOffset {
+  uint32_t filenum;
+  uint64_t offset;
+  BinlogOffset() : filenum(0), offset(0) {}
+  BinlogOffset(uint32_t num, uint64_t off) : filenum(num), offset(off) {}
+};
+
 #define PIKA_MIN_RESERVED_FDS 5000
 
 #define SLAVE_ITEM_STAGE_ONE 1
@@ -68,6 +78,22 @@ enum RecordType {
   kOldRecord = 7
 };
 
+/*
+ * Set in the type of every record of an item compressed by snappy, the
+ * records are joined before uncompressing
+ */
+const unsigned int kRecordCompressed = 0x80;
+// Shorter items are not worth compressing
+const size_t kBinlogCompressMinLen = 256;
+// A compressed item shipped as it is to the slave, "binlogz <item>"
+const std::string kBinlogCompressedCmd = "binlogz";
+// "binlogfence <shard> <seq>", written in every binlog shard before a write
+// touching keys of several shards, which goes to shard 0. The slave applies
+// the write once the fence of every shard came, see PikaBinlogReceiverThread
+const std::string kBinlogFenceCmd = "binlogfence";
+// Items ready in the binlog are shipped to a slave in one send up to it
+const size_t kBinlogSendBatchSize = 512 * 1024;
+
 /*
  * the block size that we read and write from write2file
  * the default size is 64KB
@@ -90,6 +116,23 @@ const size_t kBinlogPrefixLen = 10;
 
 const std::string kManifest = "manifest";
 
+/*
+ * Sparse index of a binlog file, write2file<N>.index, entries of
+ * offset(8) item(8) time(4) for the first item of the file and then every
+ * kBinlogIndexInterval items or kBinlogIndexBytes bytes
+ */
+const std::string kBinlogIndexSuffix = ".index";
+const uint64_t kBinlogIndexInterval = 1024;
+const uint64_t kBinlogIndexBytes = 1024 * 1024;
+const size_t kBinlogIndexEntrySize = 20;
+
+/*
+ * binlog shard n (n > 0) lives in binlog_path/shard<n>/, shard 0 in
+ * binlog_path itself as before
+ */
+const std::string kBinlogShardDir = "shard";
+const int kBinlogMaxShardNum = 16;
+
 /*
  * define common character
  *
@@ -110,6 +153,12 @@ const int kMaxBitOpInputBit = 21;
  */
 const uint32_t kDBSyncMaxGap = 50;
 const std::string kDBSyncModule = "document";
+const size_t kDBSyncChunkSize = 128 * 1024;
+// A file is written with this suffix till all of it arrives
+const std::string kDBSyncTmpSuffix = ".dbsync";
+// Seconds without any dbsync request before the slave trysync again
+const int kDBSyncIdleTimeout = 60;
+const int kDBSyncMaxRetry = 3;
 
 const std::string kBgsaveInfoFile = "info";
 
@@ -177,4 +226,9 @@ const std::string kBgsaveInfoFile = "info";
 #define THREADPOOL_SLOW 1
 #define THREADPOOL_NUM  2
 
+/*
+ * pipelined GET runs at least this long are served by one MultiGet
+ */
+#define PIKA_BATCH_GET_MIN 2
+
 #endif
@@ -22,6 +22,10 @@ class PikaDispatchThread {
 
   int64_t ThreadClientList(std::vector<ClientInfo> *clients);
 
+  // Accepted connections per second of each worker thread
+  void WorkerAcceptRates(std::vector<uint64_t> *rates);
+  void ResetLastSecAcceptnum(); /* Invoked in CronHandle */
+
   bool ClientKill(const std::string& ip_port);
   void ClientKillAll();
 
@@ -65,5 +69,10 @@ class PikaDispatchThread {
   ClientConnFactory conn_factory_;
   Handles handles_;
   pink::ServerThread* thread_rep_;
+
+  slash::Mutex accept_stat_mu_;
+  std::vector<uint64_t> last_accept_nums_;
+  std::vector<uint64_t> last_sec_accept_nums_;
+  uint64_t last_accept_time_us_;
 };
 #endif
@@ -33,12 +33,17 @@ class PikaMonitorThread : public pink::Thread {
   bool FindClient(const std::string& ip_port);
   pink::WriteStatus SendMessage(int32_t fd, std::string& message);
   void RemoveMonitorClient(const std::string& ip_port);
+  bool OutputBufferOverLimit();
 
   slash::Mutex monitor_mutex_protector_;
   slash::CondVar monitor_cond_;
 
   std::list<ClientInfo> monitor_clients_;
   std::deque<std::string> monitor_messages_;
+  // Bytes of monitor_messages_, they are the output buffer of all the
+  // monitor clients
+  uint64_t monitor_messages_len_;
+  time_t soft_limit_since_;
   std::queue<MonitorCronTask> cron_tasks_;
 
   virtual void* ThreadMain();
@@ -17,6 +17,7 @@
 #include "pika_binlog_receiver_thread.h"
 #include "pika_binlog_sender_thread.h"
 #include "pika_heartbeat_thread.h"
+#include "pika_dbsync_receiver_thread.h"
 #include "pika_slaveping_thread.h"
 #include "pika_trysync_thread.h"
 #include "pika_monitor_thread.h"
@@ -127,11 +128,14 @@ class PikaServer {
 	void DeleteSlave(int fd); // hb_fd
 	void DeleteSlave(const std::string& ip, int64_t port);
 	int64_t TryAddSlave(const std::string& ip, int64_t port);
+	// senders[i] ships binlog shard i
 	bool SetSlaveSender(const std::string& ip, int64_t port,
-			PikaBinlogSenderThread* s);
+			const std::vector<PikaBinlogSenderThread*>& senders);
 	int32_t GetSlaveListString(std::string& slave_list_str);
 	Status GetSmallestValidLog(uint32_t* max);
 	void MayUpdateSlavesMap(int64_t sid, int32_t hb_fd);
+	// A sender of the slave lost a batch, the slave must trysync again
+	bool SlaveNeedResync(int32_t hb_fd);
 	void BecomeMaster();
 
 	slash::Mutex slave_mutex_; // protect slaves_;
@@ -152,6 +156,14 @@ class PikaServer {
 	bool WaitingDBSync();
 	void NeedWaitDBSync();
 	void WaitDBSyncFinish();
+	// Something of the full sync came from the master
+	void TouchDBSync() {
+		db_sync_touch_time_ = time(NULL);
+	}
+	// No file of the full sync came for too long, the master is gone
+	bool DBSyncIdleTooLong() {
+		return time(NULL) - db_sync_touch_time_ > kDBSyncIdleTimeout;
+	}
 	void KillBinlogSenderConn();
 
 	void Start();
@@ -211,9 +223,44 @@ class PikaServer {
 	*/
 	void Schedule(pink::TaskFunc func, void* arg, int priority);
 
-	Binlog *logger_;
+	Binlog *logger_;  // binlog shard 0
+	/*
+	 * A write goes to the binlog shard its key hashes to, so the writes of
+	 * one key keep their order in one shard
+	 */
+	int binlog_shard_num() {
+		return static_cast<int>(loggers_.size());
+	}
+	Binlog* logger(int shard) {
+		return loggers_[shard];
+	}
+	int BinlogShard(uint32_t crc) {
+		return static_cast<int>(crc % loggers_.size());
+	}
+	/*
+	 * Keyless and multi-key writes touch keys of every shard, they go to
+	 * shard 0 behind a fence in every shard, see WriteCrossShardBinlog
+	 */
+	bool IsCrossShardItem(const PikaCmdArgsType& argv);
+	int BinlogShard(const PikaCmdArgsType& argv);
+	// Writes hold the shared side from Do to the binlog, a cross shard
+	// write holds the exclusive side, so the shards agree on its place.
+	// Internal writers take the shared side by BinlogFenceReadLock
+	void BinlogFenceLock(bool cross_shard);
+	void BinlogFenceUnlock(bool cross_shard);
+	// Under the exclusive side, write a fence to every shard then raw_args
+	// to shard 0
+	Status WriteCrossShardBinlog(const std::string& raw_args);
+	std::string BinlogShardPath(int shard);
+	// Apply binlog-compression to every binlog shard
+	void UpdateBinlogCompression();
+	void GetBinlogOffsets(std::vector<BinlogOffset>* offsets);
+	// Where every binlog shard has its first item at or after time
+	void SeekBinlog(uint32_t time, std::vector<BinlogOffset>* offsets,
+			std::vector<uint32_t>* item_times);
+	// offsets[i] is where the slave is in binlog shard i
 	Status AddBinlogSender(const std::string& ip, int64_t port,
-			uint32_t filenum, uint64_t con_offset);
+			const std::vector<BinlogOffset>& offsets);
 	/*
 	 * Write Binlog use
 	 */
@@ -230,12 +277,15 @@ class PikaServer {
 		std::string path;
 		uint32_t filenum;
 		uint64_t offset;
+		// Offsets of binlog shards 1 ~ n-1
+		std::vector<BinlogOffset> shard_offsets;
 		BGSaveInfo() : bgsaving(false), filenum(0), offset(0){}
 		void Clear() {
 			bgsaving = false;
 			path.clear();
 			filenum = 0;
 			offset = 0;
+			shard_offsets.clear();
 		}
 	};
 	BGSaveInfo bgsave_info() {
@@ -402,11 +452,17 @@ class PikaServer {
 	void ClientKillAll();
 	int ClientKill(const std::string &ip_port);
 	int64_t ClientList(std::vector<ClientInfo> *clients = nullptr);
+	// Hand client-output-buffer-limit and client-output-buffer-pause to pink
+	void ApplyClientOutputBufferLimit();
 
-	// rwlock_
+	// rwlock_, every command except the suspend ones holds the read side,
+	// which costs no shared cache line, see slash::QuiesceMutex
 	void RWLockWriter();
+	void RWUnlockWriter();
 	void RWLockReader();
-	void RWUnlock();
+	// False at once while a suspend command holds or waits for the lock
+	bool RWTryLockReader();
+	void RWUnlockReader();
 
 	/*
 	* PubSub used
@@ -460,11 +516,28 @@ class PikaServer {
 	/*
 	 * Binlog Receiver use
 	 */
+	/*
+	 * Items of the same key go to the same worker and apply in order,
+	 * other keys apply concurrently. The receiver has logged the item
+	 * already, in the order of the master
+	 */
 	void DispatchBinlogBG(const std::string &key,
-			PikaCmdArgsType* argv, const std::string& raw_args,
-			uint64_t cur_serial, bool readonly);
-	bool WaitTillBinlogBGSerial(uint64_t my_serial);
-	void SignalNextBinlogBGSerial();
+			PikaCmdArgsType* argv, bool readonly);
+	void PlusBinlogApplyNum(); /* Invoked by BinlogBGWorker after an item applied */
+	uint64_t BinlogApplyPending() {
+		return binlogbg_pending_;
+	}
+	uint64_t BinlogApplyQps();
+	/*
+	 * The receiver lost items it took from the master, the ping thread
+	 * drops the master so the slave trysyncs from its binlog
+	 */
+	void RequestBinlogResync() {
+		binlog_resync_ = true;
+	}
+	bool TakeBinlogResync() {
+		return binlog_resync_.exchange(false);
+	}
 
 	/*
 	 *for statistic
@@ -473,7 +546,10 @@ class PikaServer {
 	uint64_t ServerQueryNum();
 	uint64_t ServerCurrentQps();
 	uint32_t GetThreadPoolTasks(int type);
+	QueueAgeStats* GetPoolQueueStats(int type) { return &pool_queue_stats_[type]; }
+	CmdCostStats* GetCmdCostStats() { return &cmd_cost_stats_; }
 	void ResetLastSecQuerynum(); /* Invoked in PikaDispatchThread's CronHandle */
+	void WorkerAcceptRates(std::vector<uint64_t> *rates);
 	uint64_t accumulative_connections() {
 		return statistic_data_.accumulative_connections;
 	}
@@ -595,7 +671,7 @@ class PikaServer {
 	std::atomic<bool> binlog_io_error_;
 	std::string host_;
 	int port_;
-	pthread_rwlock_t rwlock_;
+	slash::QuiesceMutex rwlock_;
 	std::shared_ptr<blackwidow::BlackWidow> db_;
 
 	time_t start_time_s_;
@@ -606,9 +682,12 @@ class PikaServer {
 	int worker_num_;
 	PikaDispatchThread* pika_dispatch_thread_;
 	pink::ThreadPool* pika_thread_pools_[THREADPOOL_NUM];
+	QueueAgeStats pool_queue_stats_[THREADPOOL_NUM];
+	CmdCostStats cmd_cost_stats_;
 
 	PikaBinlogReceiverThread* pika_binlog_receiver_thread_;
 	PikaHeartbeatThread* pika_heartbeat_thread_;
+	PikaDBSyncReceiverThread* pika_dbsync_receiver_thread_;
 	PikaTrysyncThread* pika_trysync_thread_;
 
 	/*
@@ -627,6 +706,7 @@ class PikaServer {
 	int repl_state_;
 	int role_;
 	bool force_full_sync_;
+	std::atomic<time_t> db_sync_touch_time_;
 
 	/*
 	 * DBSync use
@@ -673,11 +753,12 @@ class PikaServer {
 	pink::BGThread purge_thread_;
 
 	static void DoPurgeLogs(void* arg);
-	bool GetBinlogFiles(std::map<uint32_t, std::string>& binlogs);
+	bool PurgeShardFiles(int shard, uint32_t to, bool manual, bool force);
+	bool GetBinlogFiles(int shard, std::map<uint32_t, std::string>& binlogs);
 	void AutoCompactRange();
 	void AutoPurge();
 	void AutoDeleteExpiredDump();
-	bool CouldPurge(uint32_t index);
+	bool CouldPurge(int shard, uint32_t index);
 
 	/*
 	 * Flushall use
@@ -705,13 +786,19 @@ class PikaServer {
 	*/
 	pink::PubSubThread * pika_pubsub_thread_;
 
+	/*
+	 * Binlog shards, loggers_[0] is logger_
+	 */
+	std::vector<Binlog*> loggers_;
+	slash::QuiesceMutex binlog_fence_mutex_;
+	std::atomic<uint64_t> binlog_fence_seq_;
+
 	/*
 	 * Binlog Receiver use
 	 */
-	bool binlogbg_exit_;
-	slash::Mutex binlogbg_mutex_;
-	slash::CondVar binlogbg_cond_;
-	uint64_t binlogbg_serial_;
+	// Items dispatched to binlogbg_workers_ and not applied yet
+	std::atomic<uint64_t> binlogbg_pending_;
+	std::atomic<bool> binlog_resync_;
 	std::vector<BinlogBGWorker*> binlogbg_workers_;
 	std::hash<std::string> str_hash;
 
@@ -729,6 +816,9 @@ class PikaServer {
 					thread_querynum(0),
 					last_thread_querynum(0),
 					last_sec_thread_querynum(0),
+					binlog_apply_num(0),
+					last_binlog_apply_num(0),
+					last_sec_binlog_apply_num(0),
 					last_time_us(0) {
 		}
 
@@ -737,6 +827,10 @@ class PikaServer {
 		std::atomic<uint64_t> thread_querynum;
 		std::atomic<uint64_t> last_thread_querynum;
 		std::atomic<uint64_t> last_sec_thread_querynum;
+		// Items from the master applied by binlogbg_workers_
+		std::atomic<uint64_t> binlog_apply_num;
+		std::atomic<uint64_t> last_binlog_apply_num;
+		std::atomic<uint64_t> last_sec_binlog_apply_num;
 		std::atomic<uint64_t> last_time_us;
 	};
 	StatisticData statistic_data_;
@@ -763,4 +857,25 @@ class PikaServer {
 	void operator =(const PikaServer &ps);
 };
 
+/*
+ * The shared side of the binlog fence, for the writers which change the db
+ * and log items of their own outside PikaClientConn::DoCmd
+ */
+class BinlogFenceReadLock {
+public:
+	explicit BinlogFenceReadLock(PikaServer* server)
+		: server_(server) {
+		server_->BinlogFenceLock(false);
+	}
+	~BinlogFenceReadLock() {
+		server_->BinlogFenceUnlock(false);
+	}
+
+private:
+	PikaServer* server_;
+
+	BinlogFenceReadLock(const BinlogFenceReadLock&);
+	void operator=(const BinlogFenceReadLock&);
+};
+
 #endif
@@ -66,6 +66,11 @@ void SlaveofCmd::DoInitial(const PikaCmdArgsType &argv, const CmdInfo* const ptr
         }
         g_pika_server->SetForceFullSync(true);
     } else if (cur_size == 2) {
+        // One offset could not tell where the slave is in every binlog shard
+        if (g_pika_server->binlog_shard_num() > 1) {
+            res_.SetRes(CmdRes::kErrOther, "slaveof with binlog offset needs binlog-shard-num 1");
+            return;
+        }
         have_offset_ = true;
         std::string str_filenum = *it++;
         if (!slash::string2l(str_filenum.data(), str_filenum.size(), &filenum_) || filenum_ < 0) {
@@ -90,9 +95,11 @@ void SlaveofCmd::Do() {
         return;
     }
 
-    // Stop rsync
-    LOG(INFO) << "start slaveof, stop rsync first";
-    slash::StopRsync(g_pika_conf->db_sync_path());
+    if (g_pika_conf->db_sync_rsync()) {
+        // Stop rsync
+        LOG(INFO) << "start slaveof, stop rsync first";
+        slash::StopRsync(g_pika_conf->db_sync_path());
+    }
     g_pika_server->RemoveMaster();
 
     if (is_noone_) {
@@ -143,26 +150,53 @@ void TrysyncCmd::DoInitial(const PikaCmdArgsType &argv, const CmdInfo* const ptr
         return;
     }
 
-    std::string str_filenum = *it++;
-    if (!slash::string2l(str_filenum.data(), str_filenum.size(), &filenum_) || filenum_ < 0) {
-        res_.SetRes(CmdRes::kInvalidInt);
+    // trysync ip port filenum offset [filenum offset ...], one pair for every binlog shard
+    if ((argv.end() - it) % 2 != 0) {
+        res_.SetRes(CmdRes::kWrongNum, kCmdNameTrysync);
         return;
     }
+    offsets_.clear();
+    while (it != argv.end()) {
+        int64_t filenum = 0, pro_offset = 0;
+        std::string str_filenum = *it++;
+        if (!slash::string2l(str_filenum.data(), str_filenum.size(), &filenum) || filenum < 0) {
+            res_.SetRes(CmdRes::kInvalidInt);
+            return;
+        }
 
-    std::string str_pro_offset = *it++;
-    if (!slash::string2l(str_pro_offset.data(), str_pro_offset.size(), &pro_offset_) || pro_offset_ < 0) {
-        res_.SetRes(CmdRes::kInvalidInt);
-        return;
+        std::string str_pro_offset = *it++;
+        if (!slash::string2l(str_pro_offset.data(), str_pro_offset.size(), &pro_offset) || pro_offset < 0) {
+            res_.SetRes(CmdRes::kInvalidInt);
+            return;
+        }
+        offsets_.push_back(BinlogOffset(filenum, pro_offset));
     }
+    filenum_ = offsets_[0].filenum;
+    pro_offset_ = offsets_[0].offset;
 }
 
 void TrysyncCmd::Do() {
     LOG(INFO) << "Trysync, Slave ip: " << slave_ip_ << " Slave port:" << slave_port_
-        << " filenum: " << filenum_ << " pro_offset: " << pro_offset_;
+        << " filenum: " << filenum_ << " pro_offset: " << pro_offset_
+        << " binlog shards: " << offsets_.size();
+    if (static_cast<int>(offsets_.size()) != g_pika_server->binlog_shard_num()) {
+        LOG(WARNING) << "binlog shard num mismatch, slave ip: " << slave_ip_
+            << " slave port: " << slave_port_ << " slave shards: " << offsets_.size()
+            << " my shards: " << g_pika_server->binlog_shard_num();
+        res_.SetRes(CmdRes::kErrOther, "BinlogShardNumMismatch");
+        return;
+    }
+    // The slave logs the records as they come, uncompressed ones would
+    // leave its offsets behind mine
+    if (g_pika_conf->binlog_compression() != "none" && !g_pika_conf->replicate_compressed_binlog()) {
+        LOG(WARNING) << "binlog-compression needs replicate-compressed-binlog yes, slave ip: "
+            << slave_ip_ << " slave port: " << slave_port_;
+        res_.SetRes(CmdRes::kErrOther, "BinlogCompressionMismatch");
+        return;
+    }
     int64_t sid = g_pika_server->TryAddSlave(slave_ip_, slave_port_);
     if (sid >= 0) {
-        Status status = g_pika_server->AddBinlogSender(slave_ip_, slave_port_,
-                filenum_, pro_offset_);
+        Status status = g_pika_server->AddBinlogSender(slave_ip_, slave_port_, offsets_);
         if (status.ok()) {
             res_.AppendInteger(sid);
             LOG(INFO) << "Send Sid to Slave: " << sid;
@@ -330,7 +364,7 @@ void FlushallCmd::Do() {
     } else {
         res_.SetRes(CmdRes::kErrOther, "There are some bgthread using db now, can not flushall");
     }
-    g_pika_server->RWUnlock();
+    g_pika_server->RWUnlockWriter();
 }
 
 void FlushallCmd::CacheDo() {
@@ -368,7 +402,7 @@ void ReadonlyCmd::Do() {
         g_pika_conf->SetReadonly(false);
     }
     res_.SetRes(CmdRes::kOk);
-    g_pika_server->RWUnlock();
+    g_pika_server->RWUnlockWriter();
 }
 
 void ClientCmd::DoInitial(const PikaCmdArgsType &argv, const CmdInfo* const ptr_info) {
@@ -399,7 +433,7 @@ void ClientCmd::Do() {
         std::string reply = "";
         char buf[128];
         while (iter != clients.end()) {
-            snprintf(buf, sizeof(buf), "addr=%s fd=%d idle=%ld\n", iter->ip_port.c_str(), iter->fd, iter->last_interaction == 0 ? 0 : now.tv_sec - iter->last_interaction);
+            snprintf(buf, sizeof(buf), "addr=%s fd=%d idle=%ld omem=%lu\n", iter->ip_port.c_str(), iter->fd, iter->last_interaction == 0 ? 0 : now.tv_sec - iter->last_interaction, iter->pending_reply_len);
             reply.append(buf);
             iter++;
         }
@@ -630,6 +664,14 @@ void InfoCmd::InfoClients(std::string &info) {
     std::stringstream tmp_stream;
     tmp_stream << "# Clients\r\n";
     tmp_stream << "connected_clients:" << g_pika_server->ClientList() << "\r\n";
+    tmp_stream << "reuse_port:" << (g_pika_conf->reuse_port() ? "yes" : "no") << "\r\n";
+    std::vector<uint64_t> accept_rates;
+    g_pika_server->WorkerAcceptRates(&accept_rates);
+    tmp_stream << "worker_accepts_per_sec:";
+    for (size_t i = 0; i < accept_rates.size(); ++i) {
+        tmp_stream << (i == 0 ? "" : ",") << accept_rates[i];
+    }
+    tmp_stream << "\r\n";
 
     info.append(tmp_stream.str());
 }
@@ -642,6 +684,11 @@ void InfoCmd::InfoStats(std::string &info) {
     tmp_stream << "instantaneous_ops_per_sec:" << g_pika_server->ServerCurrentQps() << "\r\n";
     tmp_stream << "fast_thread_pool_tasks:" << g_pika_server->GetThreadPoolTasks(THREADPOOL_FAST) << "\r\n";
     tmp_stream << "slow_thread_pool_tasks:" << g_pika_server->GetThreadPoolTasks(THREADPOOL_SLOW) << "\r\n";
+    tmp_stream << "fast_pool_queue_age_ms:" << g_pika_server->GetPoolQueueStats(THREADPOOL_FAST)->ToString() << "\r\n";
+    tmp_stream << "slow_pool_queue_age_ms:" << g_pika_server->GetPoolQueueStats(THREADPOOL_SLOW)->ToString() << "\r\n";
+    tmp_stream << "fast_pool_expired_reads:" << g_pika_server->GetPoolQueueStats(THREADPOOL_FAST)->shed() << "\r\n";
+    tmp_stream << "slow_pool_expired_reads:" << g_pika_server->GetPoolQueueStats(THREADPOOL_SLOW)->shed() << "\r\n";
+    tmp_stream << "adaptive_slow_routed:" << g_pika_server->GetCmdCostStats()->routed() << "\r\n";
     tmp_stream << "total_commands_processed:" << g_pika_server->ServerQueryNum() << "\r\n";
     PikaServer::BGSaveInfo bgsave_info = g_pika_server->bgsave_info();
     bool is_bgsaving = g_pika_server->bgsaving();
@@ -697,6 +744,8 @@ void InfoCmd::InfoReplication(std::string &info) {
             tmp_stream << "slave_priority:" << g_pika_conf->slave_priority() << "\r\n";
             tmp_stream << "slave_read_only:" << g_pika_conf->readonly() << "\r\n";
             tmp_stream << "repl_state: " << (g_pika_server->repl_state()) << "\r\n";
+            tmp_stream << "repl_apply_pending:" << g_pika_server->BinlogApplyPending() << "\r\n";
+            tmp_stream << "repl_apply_ops_per_sec:" << g_pika_server->BinlogApplyQps() << "\r\n";
             break;
         case PIKA_ROLE_MASTER | PIKA_ROLE_SLAVE :
             tmp_stream << "master_host:" << g_pika_server->master_ip() << "\r\n";
@@ -708,6 +757,8 @@ void InfoCmd::InfoReplication(std::string &info) {
             }
             tmp_stream << "slave_read_only:" << g_pika_conf->readonly() << "\r\n";
             tmp_stream << "repl_state: " << (g_pika_server->repl_state()) << "\r\n";
+            tmp_stream << "repl_apply_pending:" << g_pika_server->BinlogApplyPending() << "\r\n";
+            tmp_stream << "repl_apply_ops_per_sec:" << g_pika_server->BinlogApplyQps() << "\r\n";
         case PIKA_ROLE_SINGLE :
         case PIKA_ROLE_MASTER :
             tmp_stream << "connected_slaves:" << g_pika_server->GetSlaveListString(slaves_list_str) << "\r\n" << slaves_list_str;
@@ -764,6 +815,22 @@ void InfoCmd::InfoLog(std::string &info) {
     uint64_t offset;
     g_pika_server->logger_->GetProducerStatus(&filenum, &offset);
     tmp_stream << "binlog_offset:" << filenum << " " << offset << "\r\n";
+    for (int i = 1; i < g_pika_server->binlog_shard_num(); i++) {
+        g_pika_server->logger(i)->GetProducerStatus(&filenum, &offset);
+        tmp_stream << "binlog_offset_shard" << i << ":" << filenum << " " << offset << "\r\n";
+    }
+    uint64_t compress_in_bytes = 0, compress_out_bytes = 0, compress_micros = 0;
+    for (int i = 0; i < g_pika_server->binlog_shard_num(); i++) {
+        compress_in_bytes += g_pika_server->logger(i)->compress_in_bytes();
+        compress_out_bytes += g_pika_server->logger(i)->compress_out_bytes();
+        compress_micros += g_pika_server->logger(i)->compress_micros();
+    }
+    tmp_stream << "binlog_compression:" << g_pika_conf->binlog_compression() << "\r\n";
+    tmp_stream << "binlog_compress_in_bytes:" << compress_in_bytes << "\r\n";
+    tmp_stream << "binlog_compress_out_bytes:" << compress_out_bytes << "\r\n";
+    tmp_stream << "binlog_compress_ratio:" << std::fixed << std::setprecision(2)
+        << (compress_out_bytes == 0 ? 1.0 : 1.0 * compress_in_bytes / compress_out_bytes) << "\r\n";
+    tmp_stream << "binlog_compress_cpu_ms:" << compress_micros / 1000 << "\r\n";
 
     info.append(tmp_stream.str());
     return;
@@ -1025,6 +1092,12 @@ void ConfigCmd::ConfigGet(std::string &ret) {
         EncodeInt32(&config_body, g_pika_conf->thread_num());
     }
 
+    if (slash::stringmatch(pattern.data(), "reuse-port", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "reuse-port");
+        EncodeString(&config_body, g_pika_conf->reuse_port() ? "yes" : "no");
+    }
+
     if (slash::stringmatch(pattern.data(), "sync-thread-num", 1)) {
         elements += 2;
         EncodeString(&config_body, "sync-thread-num");
@@ -1079,6 +1152,18 @@ void ConfigCmd::ConfigGet(std::string &ret) {
         EncodeInt32(&config_body, g_pika_conf->db_sync_speed());
     }
 
+    if (slash::stringmatch(pattern.data(), "db-sync-parallel", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "db-sync-parallel");
+        EncodeInt32(&config_body, g_pika_conf->db_sync_parallel());
+    }
+
+    if (slash::stringmatch(pattern.data(), "db-sync-rsync", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "db-sync-rsync");
+        EncodeString(&config_body, g_pika_conf->db_sync_rsync() ? "yes" : "no");
+    }
+
     if (slash::stringmatch(pattern.data(), "compact-cron", 1)) {
         elements += 2;
         EncodeString(&config_body, "compact-cron");
@@ -1331,12 +1416,48 @@ void ConfigCmd::ConfigGet(std::string &ret) {
         EncodeInt32(&config_body, g_pika_conf->binlog_writer_num());
     }
 
+    if (slash::stringmatch(pattern.data(), "binlog-shard-num", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "binlog-shard-num");
+        EncodeInt32(&config_body, g_pika_conf->binlog_shard_num());
+    }
+
+    if (slash::stringmatch(pattern.data(), "binlog-compression", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "binlog-compression");
+        EncodeString(&config_body, g_pika_conf->binlog_compression());
+    }
+
+    if (slash::stringmatch(pattern.data(), "replicate-compressed-binlog", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "replicate-compressed-binlog");
+        EncodeString(&config_body, g_pika_conf->replicate_compressed_binlog() ? "yes" : "no");
+    }
+
+    if (slash::stringmatch(pattern.data(), "binlog-format", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "binlog-format");
+        EncodeString(&config_body, g_pika_conf->binlog_binary_format() ? "binary" : "resp");
+    }
+
     if (slash::stringmatch(pattern.data(), "root-connection-num", 1)) {
         elements += 2;
         EncodeString(&config_body, "root-connection-num");
         EncodeInt32(&config_body, g_pika_conf->root_connection_num());
     }
 
+    if (slash::stringmatch(pattern.data(), "client-output-buffer-limit", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "client-output-buffer-limit");
+        EncodeString(&config_body, g_pika_conf->client_output_buffer_limit());
+    }
+
+    if (slash::stringmatch(pattern.data(), "client-output-buffer-pause", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "client-output-buffer-pause");
+        EncodeInt64(&config_body, g_pika_conf->client_output_buffer_pause());
+    }
+
     if (slash::stringmatch(pattern.data(), "slowlog-log-slower-than", 1)) {
         elements += 2;
         EncodeString(&config_body, "slowlog-log-slower-than");
@@ -1463,6 +1584,12 @@ void ConfigCmd::ConfigGet(std::string &ret) {
         EncodeInt32(&config_body, g_pika_conf->cache_lfu_decay_time());
     }
 
+    if (slash::stringmatch(pattern.data(), "cache-read-inline", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "cache-read-inline");
+        EncodeString(&config_body, g_pika_conf->cache_read_inline() ? "yes" : "no");
+    }
+
     if (slash::stringmatch(pattern.data(), "min-blob-size", 1)) {
         elements += 2;
         EncodeString(&config_body, "min-blob-size");
@@ -1595,12 +1722,36 @@ void ConfigCmd::ConfigGet(std::string &ret) {
         EncodeInt32(&config_body, g_pika_conf->slow_thread_pool_size());
     }
 
+    if (slash::stringmatch(pattern.data(), "fast-pool-queue-deadline", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "fast-pool-queue-deadline");
+        EncodeInt32(&config_body, g_pika_conf->fast_pool_queue_deadline());
+    }
+
+    if (slash::stringmatch(pattern.data(), "slow-pool-queue-deadline", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "slow-pool-queue-deadline");
+        EncodeInt32(&config_body, g_pika_conf->slow_pool_queue_deadline());
+    }
+
     if (slash::stringmatch(pattern.data(), "slow-cmd-list", 1)) {
         elements += 2;
         EncodeString(&config_body, "slow-cmd-list");
         EncodeString(&config_body, g_pika_conf->slow_cmd_list());
     }
 
+    if (slash::stringmatch(pattern.data(), "adaptive-slow-threshold", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "adaptive-slow-threshold");
+        EncodeInt32(&config_body, g_pika_conf->adaptive_slow_threshold());
+    }
+
+    if (slash::stringmatch(pattern.data(), "fast-cmd-list", 1)) {
+        elements += 2;
+        EncodeString(&config_body, "fast-cmd-list");
+        EncodeString(&config_body, g_pika_conf->fast_cmd_list());
+    }
+
     std::stringstream resp;
     resp << "*" << std::to_string(elements) << "\r\n" << config_body;
     ret = resp.str();
@@ -1609,7 +1760,7 @@ void ConfigCmd::ConfigGet(std::string &ret) {
 void ConfigCmd::ConfigSet(std::string& ret) {
     std::string set_item = config_args_v_[1];
     if (set_item == "*") {
-        ret = "*64\r\n";
+        ret = "*75\r\n";
         EncodeString(&ret, "loglevel");
         EncodeString(&ret, "max-log-size");
         EncodeString(&ret, "timeout");
@@ -1626,12 +1777,16 @@ void ConfigCmd::ConfigSet(std::string& ret) {
         EncodeString(&ret, "expire-logs-nums");
         EncodeString(&ret, "write-binlog");
         EncodeString(&ret, "binlog-writer-queue-size");
+        EncodeString(&ret, "binlog-compression");
+        EncodeString(&ret, "replicate-compressed-binlog");
+        EncodeString(&ret, "binlog-format");
         EncodeString(&ret, "root-connection-num");
         EncodeString(&ret, "slowlog-log-slower-than");
         EncodeString(&ret, "slowlog-token-capacity");
         EncodeString(&ret, "slowlog-token-fill-every");
         EncodeString(&ret, "slave-read-only");
         EncodeString(&ret, "db-sync-speed");
+        EncodeString(&ret, "db-sync-parallel");
         EncodeString(&ret, "compact-cron");
         EncodeString(&ret, "compact-interval");
         EncodeString(&ret, "write-buffer-size");
@@ -1655,6 +1810,7 @@ void ConfigCmd::ConfigSet(std::string& ret) {
         EncodeString(&ret, "cache-maxmemory-policy");
         EncodeString(&ret, "cache-maxmemory-samples");
         EncodeString(&ret, "cache-lfu-decay-time");
+        EncodeString(&ret, "cache-read-inline");
         EncodeString(&ret, "rate-bytes-per-sec");
         EncodeString(&ret, "disable-wal");
         EncodeString(&ret, "min-system-free-mem");
@@ -1674,6 +1830,12 @@ void ConfigCmd::ConfigSet(std::string& ret) {
         EncodeString(&ret, "zset-compact-del-ratio ");
         EncodeString(&ret, "zset-compact-del-num");
         EncodeString(&ret, "slow-cmd-list");
+        EncodeString(&ret, "fast-pool-queue-deadline");
+        EncodeString(&ret, "slow-pool-queue-deadline");
+        EncodeString(&ret, "adaptive-slow-threshold");
+        EncodeString(&ret, "fast-cmd-list");
+        EncodeString(&ret, "client-output-buffer-limit");
+        EncodeString(&ret, "client-output-buffer-pause");
         return;
     }
     std::string value = config_args_v_[2];
@@ -1798,6 +1960,44 @@ void ConfigCmd::ConfigSet(std::string& ret) {
         }
         g_pika_conf->SetWriteBinlog(write_binlog);
         ret = "+OK\r\n";
+    } else if (set_item == "binlog-compression") {
+        slash::StringToLower(value);
+        if (value != "none" && value != "snappy") {
+            ret = "-ERR Invalid argument " + value + " for CONFIG SET 'binlog-compression'\r\n";
+            return;
+        }
+        if (value != "none" && !g_pika_conf->replicate_compressed_binlog()) {
+            ret = "-ERR binlog-compression needs replicate-compressed-binlog yes\r\n";
+            return;
+        }
+        g_pika_conf->SetBinlogCompression(value);
+        g_pika_server->UpdateBinlogCompression();
+        ret = "+OK\r\n";
+    } else if (set_item == "replicate-compressed-binlog") {
+        slash::StringToLower(value);
+        bool replicate_compressed_binlog;
+        if (value == "1" || value == "yes") {
+            replicate_compressed_binlog = true;
+        } else if (value == "0" || value == "no") {
+            replicate_compressed_binlog = false;
+        } else {
+            ret = "-ERR Invalid argument " + value + " for CONFIG SET 'replicate-compressed-binlog'\r\n";
+            return;
+        }
+        if (!replicate_compressed_binlog && g_pika_conf->binlog_compression() != "none") {
+            ret = "-ERR binlog-compression needs replicate-compressed-binlog yes\r\n";
+            return;
+        }
+        g_pika_conf->SetReplicateCompressedBinlog(replicate_compressed_binlog);
+        ret = "+OK\r\n";
+    } else if (set_item == "binlog-format") {
+        slash::StringToLower(value);
+        if (value != "resp" && value != "binary") {
+            ret = "-ERR Invalid argument " + value + " for CONFIG SET 'binlog-format'\r\n";
+            return;
+        }
+        g_pika_conf->SetBinlogBinaryFormat(value == "binary");
+        ret = "+OK\r\n";
     } else if (set_item == "binlog-writer-queue-size") {
         if (!slash::string2l(value.data(), value.size(), &ival) || ival <= 0) {
             ret = "-ERR Invalid argument " + value + " for CONFIG SET 'binlog-writer-queue-size'\r\n";
@@ -1816,6 +2016,23 @@ void ConfigCmd::ConfigSet(std::string& ret) {
         }
         g_pika_conf->SetRootConnectionNum(ival);
         ret = "+OK\r\n";
+    } else if (set_item == "client-output-buffer-limit") {
+        if (!g_pika_conf->SetClientOutputBufferLimit(value)) {
+            ret = "-ERR Invalid argument " + value + " for CONFIG SET 'client-output-buffer-limit'\r\n";
+            return;
+        }
+        g_pika_server->ApplyClientOutputBufferLimit();
+        ret = "+OK\r\n";
+    } else if (set_item == "client-output-buffer-pause") {
+        int memtoll_err = 0;
+        long long pause_len = slash::memtoll(value.c_str(), &memtoll_err);
+        if (memtoll_err || pause_len < 0) {
+            ret = "-ERR Invalid argument " + value + " for CONFIG SET 'client-output-buffer-pause'\r\n";
+            return;
+        }
+        g_pika_conf->SetClientOutputBufferPause(pause_len);
+        g_pika_server->ApplyClientOutputBufferLimit();
+        ret = "+OK\r\n";
     } else if (set_item == "slowlog-log-slower-than") {
         if (!slash::string2l(value.data(), value.size(), &ival) || ival <= 0) {
             ret = "-ERR Invalid argument " + value + " for CONFIG SET 'slowlog-log-slower-than'\r\n";
@@ -1873,6 +2090,13 @@ void ConfigCmd::ConfigSet(std::string& ret) {
         }
         g_pika_conf->SetDbSyncSpeed(ival);
         ret = "+OK\r\n";
+    } else if (set_item == "db-sync-parallel") {
+        if (!slash::string2l(value.data(), value.size(), &ival) || ival < 1 || ival > 16) {
+            ret = "-ERR Invalid argument " + value + " for CONFIG SET 'db-sync-parallel'\r\n";
+            return;
+        }
+        g_pika_conf->SetDbSyncParallel(ival);
+        ret = "+OK\r\n";
     } else if (set_item == "compact-cron") {
         bool invalid = false;
         if (value != "") {
@@ -2236,6 +2460,19 @@ void ConfigCmd::ConfigSet(std::string& ret) {
         g_pika_conf->SetCacheLFUDecayTime(cache_lfu_decay_time);
         g_pika_server->ResetCacheConfig();
         ret = "+OK\r\n";
+    } else if (set_item == "cache-read-inline") {
+        slash::StringToLower(value);
+        bool cache_read_inline;
+        if (value == "1" || value == "yes") {
+            cache_read_inline = true;
+        } else if (value == "0" || value == "no") {
+            cache_read_inline = false;
+        } else {
+            ret = "-ERR Invalid argument " + value + " for CONFIG SET 'cache-read-inline'\r\n";
+            return;
+        }
+        g_pika_conf->SetCacheReadInline(cache_read_inline);
+        ret = "+OK\r\n";
     } else if (set_item == "rate-bytes-per-sec") {
         long long ival = 0;
         if (!slash::string2ll(value.data(), value.size(), &ival) || ival < 0) {
@@ -2419,6 +2656,30 @@ void ConfigCmd::ConfigSet(std::string& ret) {
     } else if (set_item == "slow-cmd-list") {
         g_pika_conf->SetSlowCmdList(value);
         ret = "+OK\r\n";
+    } else if (set_item == "fast-pool-queue-deadline") {
+        if (!slash::string2l(value.data(), value.size(), &ival) || ival < 0) {
+            ret = "-ERR Invalid argument " + value + " for CONFIG SET 'fast-pool-queue-deadline'\r\n";
+            return;
+        }
+        g_pika_conf->SetFastPoolQueueDeadline(ival);
+        ret = "+OK\r\n";
+    } else if (set_item == "slow-pool-queue-deadline") {
+        if (!slash::string2l(value.data(), value.size(), &ival) || ival < 0) {
+            ret = "-ERR Invalid argument " + value + " for CONFIG SET 'slow-pool-queue-deadline'\r\n";
+            return;
+        }
+        g_pika_conf->SetSlowPoolQueueDeadline(ival);
+        ret = "+OK\r\n";
+    } else if (set_item == "adaptive-slow-threshold") {
+        if (!slash::string2l(value.data(), value.size(), &ival) || ival < 0) {
+            ret = "-ERR Invalid argument " + value + " for CONFIG SET 'adaptive-slow-threshold'\r\n";
+            return;
+        }
+        g_pika_conf->SetAdaptiveSlowThreshold(ival);
+        ret = "+OK\r\n";
+    } else if (set_item == "fast-cmd-list") {
+        g_pika_conf->SetFastCmdList(value);
+        ret = "+OK\r\n";
     } else {
         ret = "-ERR No such configure item\r\n";
     }
@@ -2804,8 +3065,17 @@ void PikaAdminCmd::DoInitial(const PikaCmdArgsType &argv, const CmdInfo* const p
         //nothing
     } else if (!strcasecmp(argv[1].data(), "cleandump") && argv.size() == 2) {
         //nothing
-    }else {
-        res_.SetRes(CmdRes::kErrOther, "Syntax error, try pikaadmin (recovery | recoverytest | cleandump)");
+    } else if (!strcasecmp(argv[1].data(), "binlog") && argv.size() == 4
+            && !strcasecmp(argv[2].data(), "seek")) {
+        long time = 0;
+        if (!slash::string2l(argv[3].data(), argv[3].size(), &time)
+                || time < 0 || time > UINT32_MAX) {
+            res_.SetRes(CmdRes::kInvalidInt);
+            return;
+        }
+        seek_time_ = static_cast<uint32_t>(time);
+    } else {
+        res_.SetRes(CmdRes::kErrOther, "Syntax error, try pikaadmin (recovery | recoverytest | cleandump | binlog seek <unix time>)");
         return;
     }
 
@@ -2819,7 +3089,7 @@ void PikaAdminCmd::Do() {
     if (operation_ == "recovery") {
         g_pika_server->RWLockWriter();
         rocksdb::Status s = g_pika_server->RecoveryDB();
-        g_pika_server->RWUnlock();
+        g_pika_server->RWUnlockWriter();
         if (s.ok()) {
             res_.SetRes(CmdRes::kOk);
         } else {
@@ -2828,7 +3098,7 @@ void PikaAdminCmd::Do() {
     } else if (operation_ == "recoverytest") {
         g_pika_server->RWLockWriter();
         rocksdb::Status s = g_pika_server->RecoveryTest();
-        g_pika_server->RWUnlock();
+        g_pika_server->RWUnlockWriter();
         if (s.ok()) {
             res_.SetRes(CmdRes::kOk);
         } else {
@@ -2837,6 +3107,19 @@ void PikaAdminCmd::Do() {
     } else if (operation_ == "cleandump") {
         g_pika_server->ForeDeleteDump();
         res_.SetRes(CmdRes::kOk);
+    } else if (operation_ == "binlog") {
+        // Every shard, the filenum and offset of its first item at or after
+        // the time and the time of the item, 0 if there is none yet
+        std::vector<BinlogOffset> offsets;
+        std::vector<uint32_t> item_times;
+        g_pika_server->SeekBinlog(seek_time_, &offsets, &item_times);
+        res_.AppendArrayLen(offsets.size());
+        for (size_t i = 0; i < offsets.size(); i++) {
+            res_.AppendArrayLen(3);
+            res_.AppendInteger(offsets[i].filenum);
+            res_.AppendInteger(offsets[i].offset);
+            res_.AppendInteger(item_times[i]);
+        }
     }
 
 
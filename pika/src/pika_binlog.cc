@@ -10,11 +10,17 @@
 #include <stdint.h>
 #include <signal.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 
+#include <algorithm>
+
 #include <glog/logging.h>
+#include <snappy.h>
 
+#include "slash/include/slash_coding.h"
 #include "slash/include/slash_mutex.h"
+#include "slash/include/slash_string.h"
 
 using slash::RWLock;
 
@@ -24,6 +30,163 @@ std::string NewFileName(const std::string name, const uint32_t current) {
   return std::string(buf);
 }
 
+static void EncodeIndexEntry(const BinlogIndexEntry& entry, std::string* dst) {
+  char buf[kBinlogIndexEntrySize];
+  slash::EncodeFixed64(buf, entry.offset);
+  slash::EncodeFixed64(buf + 8, entry.item);
+  slash::EncodeFixed32(buf + 16, entry.time);
+  dst->append(buf, kBinlogIndexEntrySize);
+}
+
+Status LoadBinlogIndex(const std::string& binlog_file,
+                       std::vector<BinlogIndexEntry>* entries) {
+  entries->clear();
+  const std::string index_file = binlog_file + kBinlogIndexSuffix;
+  if (!slash::FileExists(index_file)) {
+    return Status::NotFound(index_file);
+  }
+  slash::SequentialFile* file = NULL;
+  Status s = slash::NewSequentialFile(index_file, &file);
+  if (!s.ok()) {
+    return s;
+  }
+
+  char buf[kBinlogIndexEntrySize];
+  Slice result;
+  while (true) {
+    s = file->Read(kBinlogIndexEntrySize, &result, buf);
+    if (result.size() < kBinlogIndexEntrySize) {
+      break;
+    }
+    BinlogIndexEntry entry(slash::DecodeFixed64(result.data()),
+                           slash::DecodeFixed64(result.data() + 8),
+                           slash::DecodeFixed32(result.data() + 16));
+    // The mmap file is longer than what is written after a crash,
+    // the rest of it is zero
+    if (entry.time == 0
+        || (!entries->empty() && (entry.offset <= entries->back().offset
+                                  || entry.item <= entries->back().item))) {
+      break;
+    }
+    entries->push_back(entry);
+  }
+  delete file;
+  return Status::OK();
+}
+
+/*
+ * BinlogItemScanner
+ */
+BinlogItemScanner::BinlogItemScanner(const std::string& filename,
+                                     uint64_t offset, uint64_t limit)
+  : file_(NULL),
+    offset_(offset),
+    limit_(limit),
+    block_(new char[kBlockSize]),
+    block_start_(offset - offset % kBlockSize),
+    block_len_(0),
+    loaded_(false) {
+  status_ = slash::NewSequentialFile(filename, &file_);
+  if (status_.ok()) {
+    status_ = file_->Skip(block_start_);
+  }
+}
+
+BinlogItemScanner::~BinlogItemScanner() {
+  delete file_;
+  delete[] block_;
+}
+
+// Records never cross a block, so the file is read a block at a time
+Status BinlogItemScanner::Next(uint64_t* offset, uint32_t* time) {
+  if (!status_.ok()) {
+    return status_;
+  }
+
+  bool in_item = false;
+  uint64_t start = 0;
+  uint32_t start_time = 0;
+  while (true) {
+    if (offset_ >= limit_) {
+      status_ = Status::EndFile("binlog scan end");
+      return status_;
+    }
+    if (!loaded_ || offset_ - block_start_ >= kBlockSize) {
+      if (loaded_) {
+        block_start_ += kBlockSize;
+      }
+      Slice result;
+      Status s = file_->Read(kBlockSize, &result, block_);
+      if (!s.ok() && !s.IsEndFile()) {
+        status_ = s;
+        return status_;
+      }
+      block_len_ = result.size();
+      loaded_ = true;
+    }
+
+    const size_t in_block = offset_ - block_start_;
+    const size_t leftover = kBlockSize - in_block;
+    if (leftover < kHeaderSize) {
+      // Trailer of the block
+      offset_ += leftover;
+      continue;
+    }
+    if (in_block + kHeaderSize > block_len_) {
+      status_ = Status::EndFile("binlog scan end");
+      return status_;
+    }
+
+    const char* header = block_ + in_block;
+    const uint32_t length = (static_cast<uint32_t>(header[0]) & 0xff)
+      | ((static_cast<uint32_t>(header[1]) & 0xff) << 8)
+      | ((static_cast<uint32_t>(header[2]) & 0xff) << 16);
+    const uint32_t record_time = slash::DecodeFixed32(header + 3);
+    const unsigned int type = static_cast<unsigned char>(header[7]);
+    const unsigned int record_type = type & ~kRecordCompressed;
+    if (type == kZeroType) {
+      // What is after the last item of an mmap file
+      status_ = Status::EndFile("binlog scan end");
+      return status_;
+    }
+    if (record_type < kFullType || record_type > kLastType
+        || length > leftover - kHeaderSize) {
+      // Blank of AppendBlank, it fills whole blocks
+      offset_ += leftover;
+      in_item = false;
+      continue;
+    }
+
+    const uint64_t record = offset_;
+    offset_ += kHeaderSize + length;
+    if (record_type == kFullType) {
+      // The last blank of AppendBlank is a full record of spaces
+      if ((type & kRecordCompressed) == 0 && length > 0
+          && in_block + kHeaderSize < block_len_
+          && header[kHeaderSize] == ' ') {
+        continue;
+      }
+      start = record;
+      start_time = record_time;
+    } else if (record_type == kFirstType) {
+      in_item = true;
+      start = record;
+      start_time = record_time;
+      continue;
+    } else if (record_type == kMiddleType || !in_item) {
+      continue;
+    }
+
+    if (offset_ > limit_) {
+      status_ = Status::EndFile("binlog scan end");
+      return status_;
+    }
+    *offset = start;
+    *time = start_time;
+    return Status::OK();
+  }
+}
+
 /*
  * Version
  */
@@ -80,11 +243,19 @@ Binlog::Binlog(const std::string& binlog_path, const int file_size) :
     version_(NULL),
     queue_(NULL),
     versionfile_(NULL),
+    index_(NULL),
+    file_items_(0),
+    index_item_(0),
+    index_offset_(0),
     pro_num_(0),
     pool_(NULL),
     exit_all_consume_(false),
     binlog_path_(binlog_path),
-    file_size_(file_size) {
+    file_size_(file_size),
+    compression_(false),
+    compress_in_bytes_(0),
+    compress_out_bytes_(0),
+    compress_micros_(0) {
 
   // To intergrate with old version, we don't set mmap file size to 100M;
   //slash::SetMmapBoundSize(file_size);
@@ -97,8 +268,9 @@ Binlog::Binlog(const std::string& binlog_path, const int file_size) :
   filename = binlog_path_ + kBinlogPrefix;
   const std::string manifest = binlog_path_ + kManifest;
   std::string profile;
+  const bool exist = slash::FileExists(manifest);
 
-  if (!slash::FileExists(manifest)) {
+  if (!exist) {
     LOG(INFO) << "Binlog: Manifest file not exist, we create a new one.";
 
     profile = NewFileName(filename, pro_num_);
@@ -146,6 +318,11 @@ Binlog::Binlog(const std::string& binlog_path, const int file_size) :
   }
 
   InitLogFile();
+  if (exist) {
+    RecoverIndex();
+  } else {
+    NewIndex();
+  }
 }
 
 Binlog::~Binlog() {
@@ -153,6 +330,7 @@ Binlog::~Binlog() {
   delete versionfile_;
 
   delete queue_;
+  delete index_;
 }
 
 void Binlog::InitLogFile() {
@@ -175,102 +353,338 @@ Status Binlog::GetProducerStatus(uint32_t* filenum, uint64_t* pro_offset) {
 
 // Note: mutex lock should be held
 Status Binlog::Put(const std::string &item) {
-  Status s;
+  return Put(item.data(), item.size());
+}
 
-  /* Check to roll log file */
-  uint64_t filesize = queue_->Filesize();
-  if (filesize > file_size_) {
-    delete queue_;
-    queue_ = NULL;
+// Note: mutex lock should be held
+Status Binlog::Put(const char* item, int len) {
+  std::string packed;
+  Compress(Slice(item, len), &packed);
+  Record record = packed.empty() ? Record(Slice(item, len), false)
+                                 : Record(Slice(packed), true);
+  return Write(&record, 1);
+}
 
-    pro_num_++;
-    std::string profile = NewFileName(filename, pro_num_);
-    s = slash::NewWritableFile(profile, &queue_);
-    if (!s.ok()) {
-      LOG(INFO) << "Binlog: new " << profile << " " << s.ToString();
-      LOG(FATAL) << "Binlog: new " << profile << " " << s.ToString();
+void Binlog::Compress(const Slice &item, std::string* out) {
+  out->clear();
+  if (!compression_ || item.size() < kBinlogCompressMinLen) {
+    return;
+  }
+  uint64_t start_us = slash::NowMicros();
+  snappy::Compress(item.data(), item.size(), out);
+  compress_micros_ += slash::NowMicros() - start_us;
+  compress_in_bytes_ += item.size();
+  // Keep the item as it is unless compressing saves 1/8 of it
+  if (out->size() > item.size() - item.size() / 8) {
+    out->clear();
+    compress_out_bytes_ += item.size();
+  } else {
+    compress_out_bytes_ += out->size();
+  }
+}
+
+struct Binlog::Writer {
+  Writer(const std::string* i, const std::string* p, size_t n, slash::Mutex* mu)
+    : items(i),
+      packed(p),
+      num(n),
+      done(false),
+      cv(mu) {
+  }
+
+  const std::string* items;
+  // Compressed items, NULL or empty if not compressed
+  const std::string* packed;
+  size_t num;
+  Status status;
+  bool done;
+  slash::CondVar cv;
+};
+
+// The front writer takes the others while the group is smaller than it,
+// so it does not hold the lock too long
+static const size_t kMaxGroupBytes = 1024 * 1024;
+
+Status Binlog::GroupPut(const std::string &item) {
+  if (!compression_) {
+    return DoGroupPut(&item, NULL, 1);
+  }
+  std::string packed;
+  Compress(item, &packed);
+  return DoGroupPut(&item, &packed, 1);
+}
+
+Status Binlog::GroupPut(const std::vector<std::string> &items) {
+  if (items.empty()) {
+    return Status::OK();
+  }
+  if (!compression_) {
+    return DoGroupPut(items.data(), NULL, items.size());
+  }
+  // Compress before queueing, so the callers compress in parallel
+  std::vector<std::string> packed(items.size());
+  for (size_t i = 0; i < items.size(); i++) {
+    Compress(items[i], &packed[i]);
+  }
+  return DoGroupPut(items.data(), packed.data(), items.size());
+}
+
+Status Binlog::GroupPut(const std::vector<std::string> &items,
+                        const std::vector<std::string> &packed) {
+  if (items.empty()) {
+    return Status::OK();
+  }
+  return DoGroupPut(items.data(), packed.data(), items.size());
+}
+
+Status Binlog::DoGroupPut(const std::string* items, const std::string* packed, size_t num) {
+  Writer w(items, packed, num, &writers_mutex_);
+  writers_mutex_.Lock();
+  writers_.push_back(&w);
+  while (!w.done && &w != writers_.front()) {
+    w.cv.Wait();
+  }
+  if (w.done) {
+    writers_mutex_.Unlock();
+    return w.status;
+  }
+
+  // Take the writers queued so far, later ones wait for the next group
+  size_t group_num = 0;
+  size_t group_bytes = 0;
+  for (Writer* writer : writers_) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < writer->num; i++) {
+      bytes += writer->items[i].size();
+    }
+    if (group_num > 0 && group_bytes + bytes > kMaxGroupBytes) {
+      break;
     }
+    for (size_t i = 0; i < writer->num; i++) {
+      if (writer->packed != NULL && !writer->packed[i].empty()) {
+        group_items_.push_back(Record(Slice(writer->packed[i]), true));
+      } else {
+        group_items_.push_back(Record(Slice(writer->items[i]), false));
+      }
+    }
+    group_bytes += bytes;
+    group_num++;
+  }
+  writers_mutex_.Unlock();
 
-    {
-      slash::RWLock(&(version_->rwlock_), true);
-      version_->pro_offset_ = 0;
-      version_->pro_num_ = pro_num_;
-      //version_->set_pro_offset(0);
-      //version_->set_pro_num(pro_num_);
-      version_->StableSave();
-      //version_->debug();
+  Status s;
+  {
+    slash::MutexLock l(&mutex_);
+    s = Write(group_items_.data(), group_items_.size());
+  }
+  group_items_.clear();
+
+  writers_mutex_.Lock();
+  for (size_t i = 0; i < group_num; i++) {
+    Writer* ready = writers_.front();
+    writers_.pop_front();
+    if (ready != &w) {
+      ready->status = s;
+      ready->done = true;
+      ready->cv.Signal();
     }
-    InitLogFile();
   }
+  // Wake up the front writer of the next group
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+  writers_mutex_.Unlock();
+  return s;
+}
 
-  int pro_offset;
-  s = Produce(Slice(item.data(), item.size()), &pro_offset);
-  if (s.ok()) {
+void Binlog::RollFile() {
+  delete queue_;
+  queue_ = NULL;
+  FlushIndex();
+
+  pro_num_++;
+  std::string profile = NewFileName(filename, pro_num_);
+  Status s = slash::NewWritableFile(profile, &queue_);
+  if (!s.ok()) {
+    LOG(INFO) << "Binlog: new " << profile << " " << s.ToString();
+    LOG(FATAL) << "Binlog: new " << profile << " " << s.ToString();
+  }
+  NewIndex();
+
+  {
     slash::RWLock(&(version_->rwlock_), true);
-    //version_->plus_item_num();
-    version_->pro_offset_ = pro_offset;
-    //version_->set_pro_offset(pro_offset);
+    version_->pro_offset_ = 0;
+    version_->pro_num_ = pro_num_;
+    //version_->set_pro_offset(0);
+    //version_->set_pro_num(pro_num_);
     version_->StableSave();
+    //version_->debug();
   }
+  InitLogFile();
+}
 
-  return s;
+void Binlog::NewIndex() {
+  delete index_;
+  index_ = NULL;
+  index_buf_.clear();
+  file_items_ = 0;
+  index_item_ = 0;
+  index_offset_ = 0;
+
+  std::string index_file = NewFileName(filename, pro_num_) + kBinlogIndexSuffix;
+  Status s = slash::NewWritableFile(index_file, &index_);
+  if (!s.ok()) {
+    index_ = NULL;
+    LOG(WARNING) << "Binlog: new " << index_file << " " << s.ToString();
+  }
 }
 
-// Note: mutex lock should be held
-Status Binlog::Put(const char* item, int len) {
-  Status s;
+void Binlog::RecoverIndex() {
+  std::string profile = NewFileName(filename, pro_num_);
+  uint64_t pro_offset = version_->pro_offset_;
+  std::vector<BinlogIndexEntry> entries;
+  LoadBinlogIndex(profile, &entries);
+  // Entries of the items lost after the version save
+  while (!entries.empty() && entries.back().offset >= pro_offset) {
+    entries.pop_back();
+  }
 
-  /* Check to roll log file */
-  uint64_t filesize = queue_->Filesize();
-  if (filesize > file_size_) {
-    delete queue_;
-    queue_ = NULL;
+  NewIndex();
+  uint64_t start = 0;
+  if (!entries.empty()) {
+    for (const auto& entry : entries) {
+      EncodeIndexEntry(entry, &index_buf_);
+    }
+    start = entries.back().offset;
+    index_offset_ = start;
+    index_item_ = entries.back().item;
+    file_items_ = index_item_ + 1;
+  }
 
-    pro_num_++;
-    std::string profile = NewFileName(filename, pro_num_);
-    s = slash::NewWritableFile(profile, &queue_);
+  uint64_t offset = 0;
+  uint32_t time = 0;
+  uint64_t scanned = 0;
+  BinlogItemScanner scanner(profile, start, pro_offset);
+  while (scanner.Next(&offset, &time).ok()) {
+    // The item of the last entry is scanned again
+    if (!entries.empty() && offset == start) {
+      continue;
+    }
+    AddIndexEntry(offset, time);
+    scanned++;
+  }
+  FlushIndex();
+  LOG(INFO) << "Binlog: index of " << profile << " recovered, " << entries.size()
+    << " entries kept, " << scanned << " items scanned";
+}
+
+void Binlog::AddIndexEntry(uint64_t offset, uint32_t time) {
+  if (file_items_ == 0
+      || file_items_ - index_item_ >= kBinlogIndexInterval
+      || offset - index_offset_ >= kBinlogIndexBytes) {
+    EncodeIndexEntry(BinlogIndexEntry(offset, file_items_, time), &index_buf_);
+    index_item_ = file_items_;
+    index_offset_ = offset;
+  }
+  file_items_++;
+}
+
+// Drop the entries of a group whose append failed
+void Binlog::RestoreIndex(uint64_t file_items, uint64_t index_item,
+                          uint64_t index_offset, int block_offset) {
+  index_buf_.clear();
+  file_items_ = file_items;
+  index_item_ = index_item;
+  index_offset_ = index_offset;
+  block_offset_ = block_offset;
+}
+
+// The index is only a hint for Seek, which scans the file without it
+void Binlog::FlushIndex() {
+  if (index_buf_.empty()) {
+    return;
+  }
+  if (index_ != NULL) {
+    Status s = index_->Append(Slice(index_buf_.data(), index_buf_.size()));
+    if (s.ok()) {
+      s = index_->Flush();
+    }
     if (!s.ok()) {
-      LOG(INFO) << "Binlog: new " << profile << " " << s.ToString();
-      LOG(FATAL) << "Binlog: new " << profile << " " << s.ToString();
+      LOG(WARNING) << "Binlog: append index of " << pro_num_ << " " << s.ToString();
+      delete index_;
+      index_ = NULL;
     }
+  }
+  index_buf_.clear();
+}
 
+// Note: mutex lock should be held
+Status Binlog::Write(const Record* records, size_t num) {
+  Status s;
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+
+  uint64_t pro_offset = version_->pro_offset_;
+  // Where the file stood before this group, restored when an append fails
+  // so the next index entries keep the right item numbers and offsets
+  uint64_t file_items = file_items_;
+  uint64_t index_item = index_item_;
+  uint64_t index_offset = index_offset_;
+  int block_offset = block_offset_;
+  buf_.clear();
+  for (size_t i = 0; i < num; i++) {
+    /* Check to roll log file */
+    if (queue_->Filesize() + buf_.size() > file_size_) {
+      if (!buf_.empty()) {
+        s = queue_->Append(Slice(buf_.data(), buf_.size()));
+        buf_.clear();
+        if (!s.ok()) {
+          RestoreIndex(file_items, index_item, index_offset, block_offset);
+          return s;
+        }
+      }
+      RollFile();
+      pro_offset = 0;
+      file_items = file_items_;
+      index_item = index_item_;
+      index_offset = index_offset_;
+      block_offset = block_offset_;
+    }
+    size_t start = Produce(records[i], tv.tv_sec);
+    AddIndexEntry(pro_offset + start, tv.tv_sec);
+  }
+
+  s = queue_->Append(Slice(buf_.data(), buf_.size()));
+  if (s.ok()) {
+    s = queue_->Flush();
+  }
+  if (s.ok()) {
     {
       slash::RWLock(&(version_->rwlock_), true);
-      version_->pro_offset_ = 0;
-      version_->pro_num_ = pro_num_;
-      //version_->set_pro_offset(0);
-      //version_->set_pro_num(pro_num_);
+      //version_->plus_item_num();
+      version_->pro_offset_ = pro_offset + buf_.size();
+      //version_->set_pro_offset(pro_offset);
       version_->StableSave();
     }
-    //version_->debug();
-
-    InitLogFile();
+    // After the items, so an entry never points past the file
+    FlushIndex();
+  } else {
+    RestoreIndex(file_items, index_item, index_offset, block_offset);
   }
 
-  int pro_offset;
-  s = Produce(Slice(item, len), &pro_offset);
-  if (s.ok()) {
-    slash::RWLock(&(version_->rwlock_), true);
-    version_->pro_offset_ = pro_offset;
-    //version_->plus_item_num();
-    //version_->set_pro_offset(pro_offset);
-    version_->StableSave();
+  // Do not keep the buffer of a huge group
+  if (buf_.capacity() > 2 * kMaxGroupBytes) {
+    std::string().swap(buf_);
   }
-
   return s;
 }
  
-Status Binlog::EmitPhysicalRecord(RecordType t, const char *ptr, size_t n, int *temp_pro_offset) {
-    Status s;
+void Binlog::EmitPhysicalRecord(RecordType t, bool compressed, const char *ptr, size_t n, uint64_t now) {
     assert(n <= 0xffffff);
     assert(block_offset_ + kHeaderSize + n <= kBlockSize);
 
     char buf[kHeaderSize];
 
-    uint64_t now;
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    now = tv.tv_sec;
     buf[0] = static_cast<char>(n & 0xff);
     buf[1] = static_cast<char>((n & 0xff00) >> 8);
     buf[2] = static_cast<char>(n >> 16);
@@ -278,44 +692,32 @@ Status Binlog::EmitPhysicalRecord(RecordType t, const char *ptr, size_t n, int *
     buf[4] = static_cast<char>((now & 0xff00) >> 8);
     buf[5] = static_cast<char>((now & 0xff0000) >> 16);
     buf[6] = static_cast<char>((now & 0xff000000) >> 24);
-    buf[7] = static_cast<char>(t);
+    buf[7] = static_cast<char>(compressed ? (t | kRecordCompressed) : static_cast<unsigned int>(t));
 
-    s = queue_->Append(Slice(buf, kHeaderSize));
-    if (s.ok()) {
-        s = queue_->Append(Slice(ptr, n));
-        if (s.ok()) {
-            s = queue_->Flush();
-        }
-    }
+    buf_.append(buf, kHeaderSize);
+    buf_.append(ptr, n);
     block_offset_ += static_cast<int>(kHeaderSize + n);
     // log_info("block_offset %d", (kHeaderSize + n));
-
-    *temp_pro_offset += kHeaderSize + n;
-    //version_->rise_pro_offset((uint64_t)(kHeaderSize + n));
-    //version_->StableSave();
-    return s;
 }
 
-Status Binlog::Produce(const Slice &item, int *temp_pro_offset) {
-  Status s;
-  const char *ptr = item.data();
-  size_t left = item.size();
+size_t Binlog::Produce(const Record &record, uint64_t now) {
+  const char *ptr = record.data.data();
+  size_t left = record.data.size();
   bool begin = true;
+  size_t start = 0;
 
-  *temp_pro_offset = version_->pro_offset_;
   do {
     const int leftover = static_cast<int>(kBlockSize) - block_offset_;
     assert(leftover >= 0);
     if (static_cast<size_t>(leftover) < kHeaderSize) {
       if (leftover > 0) {
-        s = queue_->Append(Slice("\x00\x00\x00\x00\x00\x00\x00", leftover));
-        if (!s.ok()) {
-          return s;
-        }
-        *temp_pro_offset += leftover;
+        buf_.append("\x00\x00\x00\x00\x00\x00\x00", leftover);
       }
       block_offset_ = 0;
     }
+    if (begin) {
+      start = buf_.size();
+    }
 
     const size_t avail = kBlockSize - block_offset_ - kHeaderSize;
     const size_t fragment_length = (left < avail) ? left : avail;
@@ -331,13 +733,12 @@ Status Binlog::Produce(const Slice &item, int *temp_pro_offset) {
       type = kMiddleType;
     }
 
-    s = EmitPhysicalRecord(type, ptr, fragment_length, temp_pro_offset);
+    EmitPhysicalRecord(type, record.compressed, ptr, fragment_length, now);
     ptr += fragment_length;
     left -= fragment_length;
     begin = false;
-  } while (s.ok() && left > 0);
-
-  return s;
+  } while (left > 0);
+  return start;
 }
  
 Status Binlog::AppendBlank(slash::WritableFile *file, uint64_t len) {
@@ -399,6 +800,9 @@ Status Binlog::SetProducerStatus(uint32_t pro_num, uint64_t pro_offset) {
   if (slash::FileExists(init_profile)) {
     slash::DeleteFile(init_profile);
   }
+  if (slash::FileExists(init_profile + kBinlogIndexSuffix)) {
+    slash::DeleteFile(init_profile + kBinlogIndexSuffix);
+  }
 
   std::string profile = NewFileName(filename, pro_num);
   if (slash::FileExists(profile)) {
@@ -414,6 +818,7 @@ Status Binlog::SetProducerStatus(uint32_t pro_num, uint64_t pro_offset) {
   Binlog::AppendBlank(queue_, pro_offset);
 
   pro_num_ = pro_num;
+  NewIndex();
 
   {
     slash::RWLock(&(version_->rwlock_), true);
@@ -427,3 +832,102 @@ Status Binlog::SetProducerStatus(uint32_t pro_num, uint64_t pro_offset) {
   InitLogFile();
   return Status::OK();
 }
+
+// First item at or after time in the file, NotFound if none
+static Status SeekFile(const std::string& file, uint64_t limit, uint32_t time,
+                       uint64_t* offset, uint32_t* item_time) {
+  std::vector<BinlogIndexEntry> entries;
+  LoadBinlogIndex(file, &entries);
+  while (!entries.empty() && entries.back().offset >= limit) {
+    entries.pop_back();
+  }
+
+  // Scan from the last entry older than time
+  uint64_t start = 0;
+  auto it = std::lower_bound(entries.begin(), entries.end(), time,
+      [](const BinlogIndexEntry& entry, uint32_t t) { return entry.time < t; });
+  if (it != entries.begin()) {
+    start = (it - 1)->offset;
+  } else if (it != entries.end()) {
+    *offset = it->offset;
+    *item_time = it->time;
+    return Status::OK();
+  }
+
+  BinlogItemScanner scanner(file, start, limit);
+  while (scanner.Next(offset, item_time).ok()) {
+    if (*item_time >= time) {
+      return Status::OK();
+    }
+  }
+  return Status::NotFound("no item at or after the time");
+}
+
+Status Binlog::Seek(uint32_t time, uint32_t* filenum, uint64_t* offset, uint32_t* item_time) {
+  uint32_t pro_num = 0;
+  uint64_t pro_offset = 0;
+  GetProducerStatus(&pro_num, &pro_offset);
+
+  std::vector<std::string> children;
+  if (slash::GetChildren(binlog_path_, children) != 0) {
+    return Status::IOError("list " + binlog_path_);
+  }
+  std::vector<uint32_t> nums;
+  for (const auto& child : children) {
+    long num = 0;
+    if (child.compare(0, kBinlogPrefixLen, kBinlogPrefix) == 0
+        && slash::string2l(child.data() + kBinlogPrefixLen,
+                           child.size() - kBinlogPrefixLen, &num) == 1
+        && static_cast<uint32_t>(num) <= pro_num) {
+      nums.push_back(num);
+    }
+  }
+  std::sort(nums.begin(), nums.end());
+
+  auto limit = [&](uint32_t num) -> uint64_t {
+    if (num == pro_num) {
+      return pro_offset;
+    }
+    struct stat st;
+    if (stat(NewFileName(filename, num).c_str(), &st) != 0) {
+      return 0;
+    }
+    return st.st_size;
+  };
+  // The first item of the file, an empty file is taken as newer than time
+  auto first_item = [&](uint32_t num, uint64_t* o, uint32_t* t) {
+    return SeekFile(NewFileName(filename, num), limit(num), 0, o, t);
+  };
+
+  // The first file whose first item is not older than time, every item
+  // before it is older, so it is in the file before or it is that item
+  size_t lo = 0, hi = nums.size();
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    uint64_t o = 0;
+    uint32_t t = 0;
+    if (first_item(nums[mid], &o, &t).ok() && t < time) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if (lo > 0) {
+    uint32_t num = nums[lo - 1];
+    if (SeekFile(NewFileName(filename, num), limit(num), time, offset, item_time).ok()) {
+      *filenum = num;
+      return Status::OK();
+    }
+  }
+  for (size_t i = lo; i < nums.size(); i++) {
+    if (first_item(nums[i], offset, item_time).ok()) {
+      *filenum = nums[i];
+      return Status::OK();
+    }
+  }
+  *filenum = pro_num;
+  *offset = pro_offset;
+  *item_time = 0;
+  return Status::OK();
+}
@@ -6,27 +6,46 @@
 #include "pika_binlog_bgworker.h"
 #include "pika_server.h"
 #include "pika_conf.h"
-#include "pika_commonfunc.h"
+#include "slash/include/slash_recordlock.h"
 #include "slash/include/slash_string.h"
 
 extern PikaServer* g_pika_server;
 extern PikaConf* g_pika_conf;
 
+// Keys of the item whose cache it changes. The master takes del and mset
+// with one key in cache mode, but a master without cache logs more, the
+// PostDo of them updates the first key only, the others are dropped
+static void CacheKeys(const std::string& opt, const PikaCmdArgsType& argv,
+                      std::vector<std::string>* keys,
+                      std::vector<std::string>* dropped) {
+  if (argv.size() < 2) {
+    return;
+  }
+  keys->push_back(argv[1]);
+  if (opt == kCmdNameDel) {
+    dropped->assign(argv.begin() + 2, argv.end());
+  } else if (opt == kCmdNameMset) {
+    for (size_t i = 3; i < argv.size(); i += 2) {
+      dropped->push_back(argv[i]);
+    }
+  }
+  keys->insert(keys->end(), dropped->begin(), dropped->end());
+}
+
 void BinlogBGWorker::DoBinlogBG(void* arg) {
   BinlogBGArg *bgarg = static_cast<BinlogBGArg*>(arg);
   PikaCmdArgsType argv = *(bgarg->argv);
-  uint64_t my_serial = bgarg->serial;
   bool is_readonly = bgarg->readonly;
   BinlogBGWorker *self = bgarg->myself;
   std::string opt = argv[0];
   slash::StringToLower(opt);
-  std::string key = argv[0];
 
   // Get command info
   const CmdInfo* const cinfo_ptr = GetCmdInfo(opt);
   Cmd* c_ptr = self->GetCmd(opt);
   if (!cinfo_ptr || !c_ptr) {
     LOG(WARNING) << "Error operation from binlog: " << opt;
+    g_pika_server->PlusBinlogApplyNum();
     delete bgarg->argv;
     delete bgarg;
     return;
@@ -49,7 +68,6 @@ void BinlogBGWorker::DoBinlogBG(void* arg) {
   // That is to say binlog with same key will be dispatched to same thread and execute sequencly
   if (!is_readonly && argv.size() >= 2) {
     g_pika_server->mutex_record_.Lock(argv[1]);
-    key = argv[1];
   }
 
   // Add read lock for no suspend command
@@ -57,33 +75,34 @@ void BinlogBGWorker::DoBinlogBG(void* arg) {
     g_pika_server->RWLockReader();
   }
 
-  // Force the binlog write option to serialize
-  // Unlock, clean env, and exit when error happend
-  bool error_happend = false;
-  if (!is_readonly) {
-    error_happend = !g_pika_server->WaitTillBinlogBGSerial(my_serial);
-    if (!error_happend) {
-      //g_pika_server->logger_->Lock();
-      //g_pika_server->logger_->Put(bgarg->raw_args);
-      //g_pika_server->logger_->Unlock();
-      uint32_t crc = PikaCommonFunc::CRC32Update(0, key.data(), (int)key.size());
-      int thread_index =  (int)(crc % g_pika_conf->binlog_writer_num());
-      g_pika_server->binlog_write_thread_[thread_index]->WriteBinlog(bgarg->raw_args, true);
-      g_pika_server->SignalNextBinlogBGSerial();
+  // The cache of a slave is kept by the items as clients keep it on the
+  // master, under the locks reads take to fill it. Do() instead of
+  // CacheDo(), so items the master took without cache are applied too
+  if (cinfo_ptr->need_cache_do()
+      && PIKA_CACHE_NONE != g_pika_conf->cache_model()
+      && PIKA_CACHE_STATUS_OK == g_pika_server->Cache()->CacheStatus()) {
+    std::vector<std::string> keys, dropped;
+    CacheKeys(opt, argv, &keys, &dropped);
+    slash::MultiScopeRecordLock l(g_pika_server->LockMgr(), keys);
+    c_ptr->Do();
+    if (c_ptr->CmdStatus().ok() && cinfo_ptr->need_write_cache()) {
+      c_ptr->PostDo();
     }
-  }
-
-  if (!error_happend) {
+    for (auto& key : dropped) {
+      g_pika_server->Cache()->Del(key);
+    }
+  } else {
     c_ptr->Do();
   }
 
   if (!cinfo_ptr->is_suspend()) {
-    g_pika_server->RWUnlock();
+    g_pika_server->RWUnlockReader();
   }
 
   if (!is_readonly && argv.size() >= 2) {
     g_pika_server->mutex_record_.Unlock(argv[1]);
   }
+  g_pika_server->PlusBinlogApplyNum();
   if (g_pika_conf->slowlog_slower_than() >= 0) {
     int64_t duration = slash::NowMicros() - start_us;
     g_pika_server->GetCmdStats()->IncrOpStatsByCmd(cinfo_ptr->name(), duration, !(c_ptr->res().ok()));
@@ -4,8 +4,10 @@
 // of patent rights can be found in the PATENTS file in the same directory.
 
 #include <glog/logging.h>
+#include <snappy.h>
 
 #include "pika_binlog_receiver_conn.h"
+#include "pika_binlog_item.h"
 #include "pika_server.h"
 #include "pika_commonfunc.h"
 #include "pika_conf.h"
@@ -21,16 +23,35 @@ PikaBinlogReceiverConn::PikaBinlogReceiverConn(int fd,
       rbuf_len_(0),
       msg_peak_(0),
       last_read_pos_(-1),
-      bulk_len_(-1) {
+      bulk_len_(-1),
+      fenced_(false),
+      fence_shard_(0),
+      fence_seq_(0) {
   binlog_receiver_ = reinterpret_cast<PikaBinlogReceiverThread*>(worker_specific_data);
   raw_args_.reserve(RAW_ARGS_LEN);
   pink::RedisParserSettings settings;
   settings.DealMessage = &(PikaBinlogReceiverConn::ParserDealMessageCb);
   redis_parser_.RedisParserInit(REDIS_PARSER_REQUEST, settings);
   redis_parser_.data = this;
+  unpacked_parser_.RedisParserInit(REDIS_PARSER_REQUEST, settings);
+  unpacked_parser_.data = this;
+  pending_binlogs_.resize(g_pika_server->binlog_shard_num());
+  pending_packed_.resize(g_pika_server->binlog_shard_num());
 }
 
 PikaBinlogReceiverConn::~PikaBinlogReceiverConn() {
+  ApplyPendingBinlog();
+  if (fenced_) {
+    // The master sent the fence and the items held, they are not in the
+    // binlog, trysync from where it is
+    LOG(WARNING) << "Binlog conn closed at a fence, " << held_.size()
+      << " items held, resync: " << ip_port();
+    binlog_receiver_->LeaveFence(this);
+    for (auto& item : held_) {
+      delete item.argv;
+    }
+    g_pika_server->RequestBinlogResync();
+  }
   free(rbuf_);
 }
 
@@ -118,6 +139,7 @@ pink::ReadStatus PikaBinlogReceiverConn::GetRequest() {
   int processed_len = 0;
   pink::RedisParserStatus ret = redis_parser_.ProcessInputBuffer(
       rbuf_ + next_read_pos, nread, &processed_len);
+  ApplyPendingBinlog();
   pink::ReadStatus read_status = ParseRedisParserStatus(ret);
   if (read_status == pink::kReadAll || read_status == pink::kReadHalf) {
     last_read_pos_ = -1;
@@ -134,11 +156,58 @@ pink::WriteStatus PikaBinlogReceiverConn::SendReply() {
 bool PikaBinlogReceiverConn::ProcessBinlogData(const pink::RedisCmdArgsType& argv) {
   //no reply
   //eq set_is_reply(false);
+  if (!argv.empty() && argv[0] == kBinlogCompressedCmd) {
+    return ProcessCompressedBinlog(argv);
+  }
+  if (!argv.empty() && argv[0] == kBinlogBinaryCmd) {
+    return argv.size() == 2 && ProcessBinaryBinlog(argv[1]);
+  }
   g_pika_server->PlusThreadQuerynum();
   if (argv.empty()) {
     return false;
   }
+  RestoreArgs(argv);
+  return HandleBinlogItem(new PikaCmdArgsType(argv), raw_args_, packed_);
+}
+
+bool PikaBinlogReceiverConn::ProcessBinaryBinlog(const std::string& item) {
+  g_pika_server->PlusThreadQuerynum();
+  PikaCmdArgsType* v = new PikaCmdArgsType();
+  uint64_t time_ms = 0;
+  if (!DecodeBinlogItem(item.data(), item.size(), v, &time_ms) || v->empty()) {
+    LOG(WARNING) << "Bad binary binlog from master: " << ip_port();
+    delete v;
+    return false;
+  }
+  return HandleBinlogItem(v, item, packed_);
+}
+
+/*
+ * Take the command v of the master, whose binlog item is raw_args, it is
+ * logged as it is so the binlog agrees with the master's
+ */
+bool PikaBinlogReceiverConn::HandleBinlogItem(PikaCmdArgsType* v,
+                                              const std::string& raw_args,
+                                              const std::string& packed) {
+  if (fenced_) {
+    held_.push_back(HeldItem{v, raw_args, packed});
+    // The write behind the fences came
+    if (fence_shard_ == 0 && held_.size() == 1) {
+      binlog_receiver_->CompleteFences();
+    }
+    return true;
+  }
+  if ((*v)[0] == kBinlogFenceCmd) {
+    return ArriveFence(v, raw_args);
+  }
+  ApplyBinlogItem(v, raw_args, packed);
+  return true;
+}
 
+void PikaBinlogReceiverConn::ApplyBinlogItem(PikaCmdArgsType* v,
+                                             const std::string& raw_args,
+                                             const std::string& packed) {
+  const PikaCmdArgsType& argv = *v;
   // Monitor related
   std::string monitor_message;
   bool is_monitoring = g_pika_server->HasMonitorClients();
@@ -149,37 +218,110 @@ bool PikaBinlogReceiverConn::ProcessBinlogData(const pink::RedisCmdArgsType& arg
     }
     g_pika_server->AddMonitorMessage(monitor_message);
   }
-  RestoreArgs(argv);
 
-  bool is_readonly = g_pika_conf->readonly();
+  // Here, the binlog receiver, instead of the binlog bgthread takes on the task to write binlog
+  std::string cmd = argv[0];
+  if (slash::StringToLower(cmd) != "slaveof") {
+    int shard = g_pika_server->BinlogShard(argv);
+    pending_binlogs_[shard].push_back(raw_args);
+    pending_packed_[shard].push_back(packed);
+  }
+  pending_cmds_.push_back(v);
+}
 
-  // Here, the binlog dispatch thread, instead of the binlog bgthread takes on the task to write binlog
-  // Only when the server is readonly
-  uint64_t serial = binlog_receiver_->GetnPlusSerial();
-  std::string cmd = argv.size() >= 1 ? argv[0] : "";
-  if (is_readonly) {
-    if (!g_pika_server->WaitTillBinlogBGSerial(serial)) {
-      return false;
-    }
-    //g_pika_server->logger_->Lock();
-    //g_pika_server->logger_->Put(raw_args_);
-    //g_pika_server->logger_->Unlock();
-    if (slash::StringToLower(cmd) != "slaveof") {
-      std::string key = argv.size() >= 2 ? argv[1] : argv[0];
-      uint32_t crc = PikaCommonFunc::CRC32Update(0, key.data(), (int)key.size());
-      int thread_index =  (int)(crc % g_pika_conf->binlog_writer_num());
-      g_pika_server->binlog_write_thread_[thread_index]->WriteBinlog(raw_args_, true);
+// Items before the fence go on, the ones after wait for the other shards
+bool PikaBinlogReceiverConn::ArriveFence(PikaCmdArgsType* v,
+                                         const std::string& raw_args) {
+  const PikaCmdArgsType& argv = *v;
+  long shard = 0, seq = 0;
+  if (argv.size() != 3
+      || !slash::string2l(argv[1].data(), argv[1].size(), &shard)
+      || !slash::string2l(argv[2].data(), argv[2].size(), &seq)
+      || shard < 0 || shard >= g_pika_server->binlog_shard_num()) {
+    LOG(WARNING) << "Bad binlog fence from master: " << ip_port();
+    delete v;
+    return false;
+  }
+  delete v;
+  ApplyPendingBinlog();
+  fenced_ = true;
+  fence_shard_ = static_cast<int>(shard);
+  fence_seq_ = static_cast<uint64_t>(seq);
+  fence_raw_ = raw_args;
+  binlog_receiver_->ArriveFence(this);
+  return true;
+}
+
+void PikaBinlogReceiverConn::LogFence() {
+  int thread_index = fence_shard_ % g_pika_conf->binlog_writer_num();
+  g_pika_server->binlog_write_thread_[thread_index]->WriteBinlog(
+      std::vector<std::string>(1, fence_raw_), std::vector<std::string>(1), fence_shard_);
+}
+
+void PikaBinlogReceiverConn::ApplyFirstHeld() {
+  HeldItem item = held_.front();
+  held_.pop_front();
+  ApplyBinlogItem(item.argv, item.raw_args, item.packed);
+  ApplyPendingBinlog();
+}
+
+void PikaBinlogReceiverConn::PassFence() {
+  fenced_ = false;
+  std::deque<HeldItem> held;
+  held.swap(held_);
+  for (auto& item : held) {
+    HandleBinlogItem(item.argv, item.raw_args, item.packed);
+  }
+  ApplyPendingBinlog();
+}
+
+/*
+ * The binlog of a shard keeps the order of the master, so the offsets of
+ * both agree. Items are applied after being logged, by the bgworker of
+ * their key, so items of different keys apply concurrently while the
+ * items of a key apply in order. When not readonly, clients write too,
+ * the bgworker applies the item under the lock of its key then
+ */
+void PikaBinlogReceiverConn::ApplyPendingBinlog() {
+  for (size_t shard = 0; shard < pending_binlogs_.size(); shard++) {
+    std::vector<std::string>& items = pending_binlogs_[shard];
+    if (items.empty()) {
+      continue;
     }
-    g_pika_server->SignalNextBinlogBGSerial();
+    int thread_index = (int)(shard % g_pika_conf->binlog_writer_num());
+    g_pika_server->binlog_write_thread_[thread_index]->WriteBinlog(items,
+        pending_packed_[shard], shard);
+    items.clear();
+    pending_packed_[shard].clear();
   }
 
-  PikaCmdArgsType *v = new PikaCmdArgsType(argv);
-  std::string dispatch_key = argv.size() >= 2 ? argv[1] : argv[0];
-  g_pika_server->DispatchBinlogBG(dispatch_key, v, raw_args_,
-      serial, is_readonly);
-  //  memcpy(wbuf_ + wbuf_len_, res.data(), res.size());
-  //  wbuf_len_ += res.size();
-  return true;
+  bool is_readonly = g_pika_conf->readonly();
+  for (PikaCmdArgsType* v : pending_cmds_) {
+    std::string dispatch_key = v->size() >= 2 ? (*v)[1] : (*v)[0];
+    g_pika_server->DispatchBinlogBG(dispatch_key, v, is_readonly);
+  }
+  pending_cmds_.clear();
+}
+
+bool PikaBinlogReceiverConn::ProcessCompressedBinlog(const pink::RedisCmdArgsType& argv) {
+  if (argv.size() != 2
+      || !snappy::Uncompress(argv[1].data(), argv[1].size(), &unpacked_)) {
+    LOG(WARNING) << "Bad compressed binlog from master: " << ip_port();
+    return false;
+  }
+  // Logged as it came, not compressed again by binlog-compression here
+  packed_ = argv[1];
+  bool ret = false;
+  if (IsBinaryBinlogItem(unpacked_)) {
+    ret = ProcessBinaryBinlog(unpacked_);
+  } else {
+    // The command of the item comes back to ProcessBinlogData
+    int processed_len = 0;
+    ret = unpacked_parser_.ProcessInputBuffer(unpacked_.data(), unpacked_.size(),
+        &processed_len) == pink::kRedisParserDone;
+  }
+  packed_.clear();
+  return ret;
 }
 
 int PikaBinlogReceiverConn::ParserDealMessageCb(pink::RedisParser* parser,
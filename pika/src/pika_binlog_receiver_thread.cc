@@ -4,6 +4,10 @@
 // of patent rights can be found in the PATENTS file in the same directory.
 
 #include <glog/logging.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
 #include "pink/include/pink_conn.h"
 #include "pika_binlog_receiver_thread.h"
 #include "pika_server.h"
@@ -15,7 +19,7 @@ PikaBinlogReceiverThread::PikaBinlogReceiverThread(const std::set<std::string> &
                                                    int cron_interval)
       : conn_factory_(this),
         handles_(this),
-        serial_(0) {
+        completing_(false) {
   thread_rep_ = pink::NewHolyThread(ips, port, &conn_factory_,
                                     cron_interval, &handles_);
   thread_rep_->set_thread_name("BinlogReceiver");
@@ -49,3 +53,84 @@ void PikaBinlogReceiverThread::KillBinlogSender() {
   // FIXME (gaodq) do in crontask ?
   g_pika_server->MinusMasterConnection();
 }
+
+void PikaBinlogReceiverThread::ArriveFence(PikaBinlogReceiverConn* conn) {
+  fenced_conns_.insert(conn);
+  CompleteFences();
+}
+
+void PikaBinlogReceiverThread::LeaveFence(PikaBinlogReceiverConn* conn) {
+  fenced_conns_.erase(conn);
+}
+
+/*
+ * A shard is at fence seq when its conn is held at it, or at a later one
+ * as the shard passed it before a trysync. Shard 0 has to have the write
+ * behind the fence too
+ */
+bool PikaBinlogReceiverThread::FenceReady(uint64_t* seq) {
+  if (fenced_conns_.empty()) {
+    return false;
+  }
+  uint64_t active = UINT64_MAX;
+  for (auto conn : fenced_conns_) {
+    active = std::min(active, conn->fence_seq());
+  }
+  std::vector<bool> arrived(g_pika_server->binlog_shard_num(), false);
+  for (auto conn : fenced_conns_) {
+    if (conn->fence_seq() == active && conn->fence_shard() == 0
+        && conn->FirstHeld() == nullptr) {
+      return false;
+    }
+    arrived[conn->fence_shard()] = true;
+  }
+  if (std::find(arrived.begin(), arrived.end(), false) != arrived.end()) {
+    return false;
+  }
+  *seq = active;
+  return true;
+}
+
+void PikaBinlogReceiverThread::WaitBinlogApplied() {
+  while (g_pika_server->BinlogApplyPending() > 0) {
+    usleep(100);
+  }
+}
+
+// Conns passing a fence may come to the next one, the loop takes it
+void PikaBinlogReceiverThread::CompleteFences() {
+  if (completing_) {
+    return;
+  }
+  completing_ = true;
+  uint64_t seq = 0;
+  while (FenceReady(&seq)) {
+    std::vector<PikaBinlogReceiverConn*> conns;
+    PikaBinlogReceiverConn* first = nullptr;
+    for (auto conn : fenced_conns_) {
+      if (conn->fence_seq() == seq) {
+        conns.push_back(conn);
+        if (conn->fence_shard() == 0) {
+          first = conn;
+        }
+      }
+    }
+
+    // What came before the fences is applied and logged, then the fences
+    WaitBinlogApplied();
+    for (auto conn : conns) {
+      fenced_conns_.erase(conn);
+      conn->LogFence();
+    }
+    // The write, alone
+    const PikaCmdArgsType* item = first ? first->FirstHeld() : nullptr;
+    if (item != nullptr && (*item)[0] != kBinlogFenceCmd) {
+      first->ApplyFirstHeld();
+      WaitBinlogApplied();
+    }
+    for (auto conn : conns) {
+      conn->PassFence();
+    }
+  }
+  completing_ = false;
+}
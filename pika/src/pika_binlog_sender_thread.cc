@@ -7,25 +7,39 @@
 
 #include <glog/logging.h>
 #include <poll.h>
+#include <snappy.h>
 
 #include "pika_server.h"
+#include "pika_conf.h"
 #include "pika_define.h"
+#include "pika_binlog_item.h"
 #include "pika_binlog_sender_thread.h"
 #include "pink/include/redis_cli.h"
 
 extern PikaServer* g_pika_server;
+extern PikaConf* g_pika_conf;
 
 PikaBinlogSenderThread::PikaBinlogSenderThread(const std::string &ip, int port,
+                                               Binlog *logger,
                                                slash::SequentialFile *queue,
                                                uint32_t filenum,
                                                uint64_t con_offset)
-    : con_offset_(con_offset),
+    : logger_(logger),
+      con_offset_(con_offset),
       filenum_(filenum),
       initial_offset_(0),
       end_of_buffer_offset_(kBlockSize),
       queue_(queue),
       backing_store_(new char[kBlockSize]),
       buffer_(),
+      ship_compressed_(g_pika_conf->replicate_compressed_binlog()),
+      warned_unpack_(false),
+      send_num_(0),
+      send_records_(0),
+      send_bytes_per_sec_(0),
+      need_resync_(false),
+      rate_start_us_(slash::NowMicros()),
+      rate_bytes_(0),
       ip_(ip),
       port_(port),
       timeout_ms_(35000) {
@@ -83,7 +97,7 @@ uint64_t PikaBinlogSenderThread::get_next(bool &is_error) {
     const uint32_t a = static_cast<uint32_t>(header[0]) & 0xff;
     const uint32_t b = static_cast<uint32_t>(header[1]) & 0xff;
     const uint32_t c = static_cast<uint32_t>(header[2]) & 0xff;
-    const unsigned int type = header[7];
+    const unsigned int type = static_cast<unsigned char>(header[7]) & ~kRecordCompressed;
     const uint32_t length = a | (b << 8) | (c << 16);
 
     if (type == kFullType) {
@@ -127,7 +141,7 @@ unsigned int PikaBinlogSenderThread::ReadPhysicalRecord(slash::Slice *result) {
   const uint32_t a = static_cast<uint32_t>(header[0]) & 0xff;
   const uint32_t b = static_cast<uint32_t>(header[1]) & 0xff;
   const uint32_t c = static_cast<uint32_t>(header[2]) & 0xff;
-  unsigned int type = header[7];
+  unsigned int type = static_cast<unsigned char>(header[7]);
   uint32_t length = a | (b << 8) | (c << 16);
   if (type == kZeroType || length == 0) {
     buffer_.clear();
@@ -158,12 +172,18 @@ Status PikaBinlogSenderThread::Consume(std::string &scratch) {
   }
 
   slash::Slice fragment;
+  bool compressed = false;
+  // An item starting at the last kHeaderSize bytes of a block has an empty
+  // first record, which ReadPhysicalRecord skips, the item begins with its
+  // middle or last record then
+  scratch.clear();
   while (true) {
     const unsigned int record_type = ReadPhysicalRecord(&fragment);
+    compressed = (record_type & kRecordCompressed) != 0;
 
-    switch (record_type) {
+    switch (record_type & ~kRecordCompressed) {
       case kFullType:
-        scratch = std::string(fragment.data(), fragment.size());
+        scratch.assign(fragment.data(), fragment.size());
         s = Status::OK();
         break;
       case kFirstType:
@@ -193,9 +213,48 @@ Status PikaBinlogSenderThread::Consume(std::string &scratch) {
     }
   }
   //DLOG(INFO) << "Binlog Sender consumer a msg: " << scratch;
+  if (compressed) {
+    return UnpackItem(scratch);
+  }
+  if (IsBinaryBinlogItem(scratch)) {
+    WrapItem(kBinlogBinaryCmd, scratch);
+  }
+  return Status::OK();
+}
+
+// Ship the compressed item as it is if the slave could read it, the slave
+// logs it as it is. Uncompressed otherwise, the offsets of the slave do
+// not agree with mine from here
+Status PikaBinlogSenderThread::UnpackItem(std::string &scratch) {
+  if (ship_compressed_) {
+    WrapItem(kBinlogCompressedCmd, scratch);
+    return Status::OK();
+  }
+  if (!warned_unpack_) {
+    LOG(WARNING) << "Compressed binlog shipped uncompressed to slave " << ip_ << ":" << port_
+      << ", its binlog offsets no longer agree with mine, set replicate-compressed-binlog yes";
+    warned_unpack_ = true;
+  }
+  if (!snappy::Uncompress(scratch.data(), scratch.size(), &unpacked_)) {
+    return Status::IOError("Data Corruption");
+  }
+  scratch.swap(unpacked_);
+  if (IsBinaryBinlogItem(scratch)) {
+    WrapItem(kBinlogBinaryCmd, scratch);
+  }
   return Status::OK();
 }
 
+// "<cmd> <item>", for the items which are not a command themselves
+void PikaBinlogSenderThread::WrapItem(const std::string &cmd, std::string &scratch) {
+  pink::RedisCmdArgsType argv;
+  argv.push_back(cmd);
+  argv.push_back(std::move(scratch));
+  unpacked_.clear();
+  pink::SerializeRedisCommand(std::move(argv), &unpacked_);
+  scratch.swap(unpacked_);
+}
+
 // Get a whole message; 
 // the status will be OK, IOError or Corruption;
 Status PikaBinlogSenderThread::Parse(std::string &scratch) {
@@ -204,11 +263,17 @@ Status PikaBinlogSenderThread::Parse(std::string &scratch) {
   uint32_t pro_num;
   uint64_t pro_offset;
 
-  Binlog* logger = g_pika_server->logger_;
+  if (!pending_.ok()) {
+    s = pending_;
+    pending_ = Status::OK();
+    return s;
+  }
+
   while (!should_stop()) {
-    logger->GetProducerStatus(&pro_num, &pro_offset);
+    logger_->GetProducerStatus(&pro_num, &pro_offset);
     if (filenum_ == pro_num && con_offset_ == pro_offset) {
       //DLOG(INFO) << "BinlogSender Parse no new msg, filenum_" << filenum_ << ", con_offset " << con_offset_;
+      UpdateSendStat(0, 0);
       usleep(10000);
       continue;
     }
@@ -218,7 +283,7 @@ Status PikaBinlogSenderThread::Parse(std::string &scratch) {
 
     //DLOG(INFO) << "BinlogSender after Parse a msg return " << s.ToString() << " filenum_" << filenum_ << ", con_offset " << con_offset_;
     if (s.IsEndFile()) {
-      std::string confile = NewFileName(g_pika_server->logger_->filename, filenum_ + 1);
+      std::string confile = NewFileName(logger_->filename, filenum_ + 1);
 
       // Roll to next File
       if (slash::FileExists(confile)) {
@@ -247,6 +312,46 @@ Status PikaBinlogSenderThread::Parse(std::string &scratch) {
   return s;
 }
 
+// Append the items already written after the parsed one, so a burst of
+// writes goes out in a few sends. It never waits for new items, the
+// end of file is left to Parse. Return the number of items appended
+int PikaBinlogSenderThread::AppendAvailable(std::string &batch) {
+  int num = 0;
+  uint32_t pro_num;
+  uint64_t pro_offset;
+
+  while (batch.size() < kBinlogSendBatchSize && !should_stop()) {
+    logger_->GetProducerStatus(&pro_num, &pro_offset);
+    if (filenum_ == pro_num && con_offset_ == pro_offset) {
+      break;
+    }
+    Status s = Consume(item_);
+    if (s.IsEndFile()) {
+      break;
+    } else if (!s.ok()) {
+      pending_ = s;
+      break;
+    }
+    batch.append(item_);
+    num++;
+  }
+  return num;
+}
+
+void PikaBinlogSenderThread::UpdateSendStat(int records, size_t bytes) {
+  if (records > 0) {
+    send_num_++;
+    send_records_ += records;
+    rate_bytes_ += bytes;
+  }
+  uint64_t now = slash::NowMicros();
+  if (now - rate_start_us_ >= 1000000) {
+    send_bytes_per_sec_ = rate_bytes_ * 1000000 / (now - rate_start_us_);
+    rate_start_us_ = now;
+    rate_bytes_ = 0;
+  }
+}
+
 std::string PikaBinlogSenderThread::SerializeSlaveCmd() {
   pink::RedisCmdArgsType argv;
   std::string wbuf_str;
@@ -262,8 +367,9 @@ std::string PikaBinlogSenderThread::SerializeSlaveCmd() {
 void* PikaBinlogSenderThread::ThreadMain() {
   Status s, result;
   bool last_send_flag = true;
+  int records = 0;
   std::string scratch;
-  scratch.reserve(1024 * 1024);
+  scratch.reserve(kBinlogSendBatchSize + 1024 * 1024);
 
   while (!should_stop()) {
 
@@ -294,6 +400,7 @@ void* PikaBinlogSenderThread::ThreadMain() {
             }
             break;
           }
+          records = 1 + AppendAvailable(scratch);
         }
 
         // 3. After successful parse, we send msg;
@@ -301,6 +408,15 @@ void* PikaBinlogSenderThread::ThreadMain() {
         result = cli_->Send(&scratch);
         if (result.ok()) {
           last_send_flag = true;
+          UpdateSendStat(records, scratch.size());
+        } else if (records > 1) {
+          // The slave applies the items it got whole and drops the broken
+          // one, sending the batch again would apply some of them twice
+          need_resync_ = true;
+          LOG(WARNING) << "BinlogSender send a batch of " << records << " items to slave("
+            << ip_ << ":" << port_ << ") failed, " << result.ToString()
+            << ", wait for the slave to trysync";
+          break;
         } else {
           last_send_flag = false;
           LOG(WARNING) << "BinlogSender send slave(" << ip_ << ":" << port_ << ") failed,  " << result.ToString();
@@ -310,6 +426,15 @@ void* PikaBinlogSenderThread::ThreadMain() {
       }
     }
 
+    if (need_resync_) {
+      // Deleted with the slave when it trysyncs
+      cli_->Close();
+      while (!should_stop()) {
+        usleep(10000);
+      }
+      break;
+    }
+
     // error
     cli_->Close();
     sleep(1);
@@ -5,6 +5,7 @@
 
 #include <string>
 #include <utility>
+#include <vector>
 #include <sys/time.h>
 
 #include "pink/include/pink_define.h"
@@ -18,6 +19,7 @@ PikaBinlogWriterThread::PikaBinlogWriterThread(int max_deque_size = 1000)
   : pink::Thread(),
     binlog_read_cond_(&binlog_mutex_protector_),
     binlog_write_cond_(&binlog_mutex_protector_),
+    binlog_idle_cond_(&binlog_mutex_protector_),
     binlog_io_error_(false),
     is_binlog_writer_idle_(false),
     max_cmds_deque_size_(max_deque_size) {
@@ -31,18 +33,21 @@ PikaBinlogWriterThread::~PikaBinlogWriterThread() {
     binlog_read_cond_.Signal();
     StopThread();
   }
+  {
+    slash::MutexLock lm(&binlog_mutex_protector_);
+    binlog_idle_cond_.SignalAll();
+  }
 
   LOG(INFO) << " PikaBinlogWriterThread " << pthread_self() << " exit!!!";
 }
 
-Status PikaBinlogWriterThread::WriteBinlog(const std::string &raw_args, bool is_sync) {
+Status PikaBinlogWriterThread::WriteBinlog(const std::string &raw_args, bool is_sync, int shard) {
   if (!BinlogIoError()) {
     slash::Status s;
 
     if (is_sync) {
-      g_pika_server->logger_->Lock();
-      s = g_pika_server->logger_->Put(raw_args);
-      g_pika_server->logger_->Unlock();
+      // 与其他线程的binlog一起写
+      s = g_pika_server->logger(shard)->GroupPut(raw_args);
       if (!s.ok()) {
         LOG(WARNING) << "Write binlog IOError: " << raw_args;
         SetBinlogIoError(true);
@@ -60,7 +65,7 @@ Status PikaBinlogWriterThread::WriteBinlog(const std::string &raw_args, bool is_
       	binlog_write_cond_.Wait();
       }
 
-      cmds_deque_.push_back(raw_args);
+      cmds_deque_.push_back(std::make_pair(shard, raw_args));
       binlog_read_cond_.Signal();
       
       s = Status::OK();
@@ -71,6 +76,19 @@ Status PikaBinlogWriterThread::WriteBinlog(const std::string &raw_args, bool is_
   return Status::IOError("BinlogIoError");
 }
 
+Status PikaBinlogWriterThread::WriteBinlog(const std::vector<std::string> &raw_args,
+                                           const std::vector<std::string> &packed, int shard) {
+  if (BinlogIoError()) {
+    return Status::IOError("BinlogIoError");
+  }
+  slash::Status s = g_pika_server->logger(shard)->GroupPut(raw_args, packed);
+  if (!s.ok()) {
+    LOG(WARNING) << "Write binlog IOError: " << raw_args.size() << " cmds, the first: " << raw_args.front();
+    SetBinlogIoError(true);
+  }
+  return s;
+}
+
 bool PikaBinlogWriterThread::BinlogIoError() {
   return binlog_io_error_;
 }
@@ -79,9 +97,18 @@ void PikaBinlogWriterThread::SetBinlogIoError(bool error) {
   binlog_io_error_ = error;
 }
 
+// Idle stays set until the thread wakes for a push, the deque tells that
 bool PikaBinlogWriterThread::IsBinlogWriterIdle() {
   slash::MutexLock lm(&binlog_mutex_protector_);
-  return is_binlog_writer_idle_;
+  return is_binlog_writer_idle_ && cmds_deque_.empty();
+}
+
+void PikaBinlogWriterThread::WaitBinlogWriterIdle() {
+  slash::MutexLock lm(&binlog_mutex_protector_);
+  while (!(is_binlog_writer_idle_ && cmds_deque_.empty())
+         && is_running() && !should_stop()) {
+    binlog_idle_cond_.Wait();
+  }
 }
 
 void PikaBinlogWriterThread::SetMaxCmdsQueueSize(size_t max_size) {
@@ -101,42 +128,46 @@ bool PikaBinlogWriterThread::IsCmdsDequeEmpty() {
 }*/
 
 void* PikaBinlogWriterThread::ThreadMain() {
-  std::string cmd;
+  // 按binlog分片分组，每个分片一组
+  std::vector<std::vector<std::string> > cmds(g_pika_server->binlog_shard_num());
   while (!(should_stop() && IsCmdsDequeEmpty())) {
     {
       slash::MutexLock lm(&binlog_mutex_protector_);
       while (cmds_deque_.empty() && !should_stop()) {
         is_binlog_writer_idle_ = true;
+        binlog_idle_cond_.SignalAll();
         binlog_read_cond_.Wait();
       }
       is_binlog_writer_idle_ = false;
-    }
 
-    while (!IsCmdsDequeEmpty()) {
-      cmd = "";
-      {
-        slash::MutexLock lm(&binlog_mutex_protector_);
-        cmd = cmds_deque_.front();
-        cmds_deque_.pop_front();
-        // 如果所有的工作线程因缓冲区写满而阻塞，即使写binlog线程执行SignalALL,也只有一个工作线程可以正常操作缓冲区
-        binlog_write_cond_.Signal();
+      // 一次取走缓冲区里所有的命令，作为一组写入binlog；缓冲区空了，唤醒所有等待的工作线程
+      for (auto& cmd : cmds_deque_) {
+        if (!cmd.second.empty()) {
+          cmds[cmd.first].push_back(std::move(cmd.second));
+        }
       }
+      cmds_deque_.clear();
+      binlog_write_cond_.SignalAll();
+    }
 
-      if ("" == cmd) {
+    for (size_t shard = 0; shard < cmds.size(); shard++) {
+      std::vector<std::string>& shard_cmds = cmds[shard];
+      if (shard_cmds.empty()) {
         continue;
       }
 
       if (BinlogIoError()) {
-        LOG(WARNING) << "Write binlog IOError: " << cmd;
+        for (const auto& cmd : shard_cmds) {
+          LOG(WARNING) << "Write binlog IOError: " << cmd;
+        }
       } else {
-        g_pika_server->logger_->Lock();
-        slash::Status s = g_pika_server->logger_->Put(cmd);
-        g_pika_server->logger_->Unlock();
+        slash::Status s = g_pika_server->logger(shard)->GroupPut(shard_cmds);
         if (!s.ok()) {
-          LOG(WARNING) << "Write binlog IOError: " << cmd;
+          LOG(WARNING) << "Write binlog IOError: " << shard_cmds.size() << " cmds, the first: " << shard_cmds.front();
           SetBinlogIoError(true);
         }
       }
+      shard_cmds.clear();
     }
   }
   return NULL;
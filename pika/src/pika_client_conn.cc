@@ -6,6 +6,7 @@
 #include <sstream>
 #include <vector>
 #include <algorithm>
+#include <iterator>
 
 #include <glog/logging.h>
 #include <time.h>
@@ -17,6 +18,7 @@
 #include "pika_client_conn.h"
 #include "pika_dispatch_thread.h"
 #include "pika_define.h"
+#include "pika_binlog_item.h"
 #include "pika_commonfunc.h"
 #include "pika_cmd_table_manager.h"
 
@@ -27,6 +29,14 @@ extern PikaCmdTableManager* g_pika_cmd_table_manager;
 std::atomic<uint64_t> PikaClientConn::slowlog_count_(0);
 slash::Mutex PikaClientConn::slowlog_mutex_;
 
+static const std::string kNoKey;
+
+// 回复先写到本线程的缓冲区再拷贝进连接的response_，两边都保留内存，小的回复不再分配
+static std::string* ReplyArena() {
+	static thread_local std::string arena;
+	return &arena;
+}
+
 static std::string ConstructPubSubResp(
                                 const std::string& cmd,
                                 const std::vector<std::pair<std::string, int>>& result) {
@@ -67,24 +77,30 @@ std::string PikaClientConn::RestoreArgs(const PikaCmdArgsType& argv) {
 	return res;
 }
 
-std::string PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
-								  const std::string& opt,
-								  uint64_t recv_cmd_time_us,
-								  uint32_t queue_size) {
+void PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
+						   uint64_t recv_cmd_time_us,
+						   uint32_t queue_size,
+						   bool cache_missed,
+						   std::string* reply) {
 
 	uint64_t before_pre_do_time_us = slash::NowMicros();
 	uint64_t queue_time = before_pre_do_time_us - recv_cmd_time_us; // 命令排队时间
 
-	// Get command info
-	const CmdInfo* const cinfo_ptr = GetCmdInfo(opt);
-	Cmd* c_ptr = g_pika_cmd_table_manager->GetCmd(opt);
+	// Get command info, argv[0] is matched ignoring case
+	const CmdInfo* cinfo_ptr = NULL;
+	Cmd* c_ptr = g_pika_cmd_table_manager->GetCmd(argv[0], &cinfo_ptr);
+	// The name in the table, pttl has the CmdInfo of ttl
+	std::string opt = argv[0];
+	slash::StringToLower(opt);
 	if (!cinfo_ptr || !c_ptr) {
-		return "-Err unknown or unsupported command \'" + opt + "\'\r\n";
+		reply->append("-Err unknown or unsupported command \'" + opt + "\'\r\n");
+		return;
 	}
 
 	// Check authed
 	if (!auth_stat_.IsAuthed(cinfo_ptr)) {
-		return "-ERR NOAUTH Authentication required.\r\n";
+		reply->append("-ERR NOAUTH Authentication required.\r\n");
+		return;
 	}
 
 	// For now, only shutdown need check local
@@ -92,7 +108,8 @@ std::string PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
 		if (ip_port().find("127.0.0.1") == std::string::npos
 				&& ip_port().find(g_pika_server->host()) == std::string::npos) {
 			LOG(WARNING) << "\'shutdown\' should be localhost";
-			return "-ERR \'shutdown\' should be localhost\r\n";
+			reply->append("-ERR \'shutdown\' should be localhost\r\n");
+			return;
 		}
 	}
 
@@ -111,7 +128,8 @@ std::string PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
 	c_ptr->Initial(argv, cinfo_ptr);
 	if (!c_ptr->res().ok()) {
 		g_pika_server->GetCmdStats()->IncrOpStatsByCmd(cinfo_ptr->name(), slash::NowMicros() - recv_cmd_time_us, true);
-		return c_ptr->res().message();
+		c_ptr->res().AppendMessageTo(reply);
+		return;
 	}
 
 	// PubSub connection
@@ -121,7 +139,8 @@ std::string PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
 			opt != kCmdNamePing &&
 			opt != kCmdNamePSubscribe &&
 			opt != kCmdNamePUnSubscribe) {
-			return "-ERR only (P)SUBSCRIBE / (P)UNSUBSCRIBE / PING / QUIT allowed in this context\r\n";
+			reply->append("-ERR only (P)SUBSCRIBE / (P)UNSUBSCRIBE / PING / QUIT allowed in this context\r\n");
+			return;
 		}
 	}
 
@@ -129,12 +148,13 @@ std::string PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
 		std::shared_ptr<PinkConn> conn= server_thread_->MoveConnOut(fd());
         if (!conn) {
             LOG(WARNING) << "monitor: empty conn: " << fd() << ", " << ip_port();
-            return "-ERR conn empty\r\n";
+            reply->append("-ERR conn empty\r\n");
+            return;
         }
 		assert(conn.get() == this);
 		g_pika_server->AddMonitorClient(std::dynamic_pointer_cast<PikaClientConn>(conn));
 		g_pika_server->AddMonitorMessage("OK");
-		return ""; // Monitor thread will return "OK"
+		return; // Monitor thread will return "OK"
 	}
 
 	// PubSub
@@ -144,7 +164,8 @@ std::string PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
 			conn = server_thread_->MoveConnOut(fd());
             if (!conn) {
                 LOG(WARNING) << "subscribe: empty conn: " << fd() << ", " << ip_port();
-                return "-ERR conn empty\r\n";
+                reply->append("-ERR conn empty\r\n");
+                return;
             } 
 		}
 		std::vector<std::string > channels;
@@ -155,7 +176,8 @@ std::string PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
 		this->SetIsPubSub(true);
 		this->SetHandleType(pink::HandleType::kSynchronous);
 		g_pika_server->Subscribe(conn, channels, opt == kCmdNamePSubscribe, &result);
-		return ConstructPubSubResp(opt, result);
+		reply->append(ConstructPubSubResp(opt, result));
+		return;
 	} else if (opt == kCmdNamePUnSubscribe || opt == kCmdNameUnSubscribe) {  // PUnSubscribe or UnSubscribe
 		std::vector<std::string > channels;
 		for (size_t i = 1; i < argv.size(); i++) {
@@ -172,21 +194,28 @@ std::string PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
 			server_thread_->HandleNewConn(fd(), ip_port());
 			this->SetIsPubSub(false);
 		}
-		return ConstructPubSubResp(opt, result);
+		reply->append(ConstructPubSubResp(opt, result));
+		return;
 	}
 
+	bool cross_shard = false;
 	if (cinfo_ptr->is_write()) {
 		if (g_pika_server->BinlogIoError()) {
 			g_pika_server->GetCmdStats()->IncrOpStatsByCmd(cinfo_ptr->name(), slash::NowMicros() - recv_cmd_time_us, true);
-			return "-ERR Writing binlog failed, maybe no space left on device\r\n";
+			reply->append("-ERR Writing binlog failed, maybe no space left on device\r\n");
+			return;
 		}
 		if (g_pika_conf->readonly()) {
 			g_pika_server->GetCmdStats()->IncrOpStatsByCmd(cinfo_ptr->name(), slash::NowMicros() - recv_cmd_time_us, true);
-			return "-ERR Server in read-only\r\n";
+			reply->append("-ERR Server in read-only\r\n");
+			return;
 		}
 		if (argv.size() >= 2) {
 			g_pika_server->LockMgr()->TryLock(argv[1]);
 		}
+		// 跨binlog分片的写命令独占，保证各分片上它前后的命令与本地执行顺序一致
+		cross_shard = g_pika_server->IsCrossShardItem(argv);
+		g_pika_server->BinlogFenceLock(cross_shard);
 	}
 
 	// Add read lock for no suspend command
@@ -209,17 +238,20 @@ std::string PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
 	* 1. 该命令需要操作缓存
 	* 2. 缓存模式不为NONE
 	* 3. 缓存状态为OK
-	* 4. 当前不是slave状态
+	* slave的缓存由BinlogBGWorker应用binlog时同步更新
 	*/
 	if (cinfo_ptr->need_cache_do() 
 		&& PIKA_CACHE_NONE != g_pika_conf->cache_model()
-		&& PIKA_CACHE_STATUS_OK == g_pika_server->Cache()->CacheStatus()
-		&& !g_pika_server->is_slave()) {
+		&& PIKA_CACHE_STATUS_OK == g_pika_server->Cache()->CacheStatus()) {
 
 		// 是否需要读缓存
 		if (cinfo_ptr->need_read_cache()) {
 			// LOG(INFO) << "PikaClientConn::DoCmd " << argv[0] << " PreDo";
-			c_ptr->PreDo();
+			if (cache_missed) {
+				c_ptr->res().SetRes(CmdRes::kCacheMiss);
+			} else {
+				c_ptr->PreDo();
+			}
 			after_cache_time_us = slash::NowMicros();
 			cache_time = after_cache_time_us - before_do_time_us;
 		}
@@ -262,6 +294,8 @@ std::string PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
 			std::string raw_args;
 			if (cinfo_ptr->name() == kCmdNameExpire || cinfo_ptr->name() == kCmdNamePexpire) {
 				raw_args = c_ptr->ToBinlog();
+			} else if (g_pika_conf->binlog_binary_format()) {
+				EncodeBinlogItem(argv, after_rocksdb_time_us / 1000, &raw_args);
 			} else {
 				raw_args = RestoreArgs(argv);
 			}
@@ -273,7 +307,13 @@ std::string PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
 			uint32_t crc = PikaCommonFunc::CRC32Update(0, key.data(), (int)key.size());
 			int binlog_writer_num = g_pika_conf->binlog_writer_num();
     		int thread_index =  (int)(crc % binlog_writer_num);
-			slash::Status s = g_pika_server->binlog_write_thread_[thread_index]->WriteBinlog(raw_args, "sync" == g_pika_conf->binlog_writer_method());
+			slash::Status s;
+			if (cross_shard) {
+				s = g_pika_server->WriteCrossShardBinlog(raw_args);
+			} else {
+				s = g_pika_server->binlog_write_thread_[thread_index]->WriteBinlog(raw_args, "sync" == g_pika_conf->binlog_writer_method(),
+						g_pika_server->BinlogShard(crc));
+			}
 			if (!s.ok()) {
 				LOG(WARNING) << "Writing binlog failed, maybe no space left on device";
 				//g_pika_server->SetBinlogIoError(true);
@@ -284,29 +324,39 @@ std::string PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
 				}
 
 				if (!cinfo_ptr->is_suspend()) {
-					g_pika_server->RWUnlock();
+					g_pika_server->RWUnlockReader();
 				}
+				g_pika_server->BinlogFenceUnlock(cross_shard);
 				if (argv.size() >= 2) {
 					g_pika_server->LockMgr()->UnLock(argv[1]);
 				}
 				
 				g_pika_server->GetCmdStats()->IncrOpStatsByCmd(cinfo_ptr->name(), slash::NowMicros() - recv_cmd_time_us, true);
-				return "-ERR Writing binlog failed, maybe no space left on device\r\n";
+				reply->append("-ERR Writing binlog failed, maybe no space left on device\r\n");
+				return;
 			}
 		}
 		binlog_time = slash::NowMicros() - after_rocksdb_time_us;
 	}
 
 	if (!cinfo_ptr->is_suspend()) {
-		g_pika_server->RWUnlock();
+		g_pika_server->RWUnlockReader();
 	}
 
 	if (cinfo_ptr->is_write()) {
+		g_pika_server->BinlogFenceUnlock(cross_shard);
 		if (argv.size() >= 2) {
 			g_pika_server->LockMgr()->UnLock(argv[1]);
 		}
 	}
 
+	// 记录命令在这个key上的执行耗时，快慢线程池的自动分流依据它
+	int adaptive_slow_threshold = g_pika_conf->adaptive_slow_threshold();
+	if (adaptive_slow_threshold > 0) {
+		g_pika_server->GetCmdCostStats()->Record(GetCmdIndex(opt), argv.size() >= 2 ? argv[1] : kNoKey,
+												 cache_time + rocksdb_time, adaptive_slow_threshold);
+	}
+
 	if (g_pika_conf->slowlog_slower_than() >= 0) {
 		int64_t total_time = queue_time + cache_time + rocksdb_time + binlog_time;
 		g_pika_server->GetCmdStats()->IncrOpStatsByCmd(cinfo_ptr->name(), total_time, !(c_ptr->res().ok()));
@@ -346,7 +396,7 @@ std::string PikaClientConn::DoCmd(const PikaCmdArgsType& argv,
 //      LOG(WARNING) << "(" << ip_port() << ")Wrong Password";
 		}
 	}
-	return c_ptr->res().message();
+	c_ptr->res().AppendMessageTo(reply);
 }
 
 void PikaClientConn::SyncProcessRedisCmd(const pink::RedisCmdArgsType& argv, std::string* response) {
@@ -359,7 +409,7 @@ void PikaClientConn::SyncProcessRedisCmd(const pink::RedisCmdArgsType& argv, std
 		success = false;
 	}
 
-	if (!response->empty()) {
+	if (!ReplyEmpty()) {
 		set_is_reply(true);
         if (!already_subscibed) {
             NotifyEpoll(success);
@@ -367,75 +417,328 @@ void PikaClientConn::SyncProcessRedisCmd(const pink::RedisCmdArgsType& argv, std
 	}
 }
 
-void PikaClientConn::AsynProcessRedisCmds(const std::vector<pink::RedisCmdArgsType>& argvs, std::string* response) {
-	if (argvs.empty() || argvs[0].empty()) {
+void PikaClientConn::AsynProcessRedisCmds(std::vector<pink::RedisCmdArgsType>* argvs, std::string* response) {
+	if (argvs->empty() || (*argvs)[0].empty()) {
+		return;
+	}
+
+	/*
+	* 缓存命中的读命令直接在网络线程中执行，从第一个不能命中缓存的命令开始，
+	* 剩余的命令交给线程池执行，保证pipeline中回复的顺序。
+	*/
+	size_t inline_num = 0;
+	bool cache_missed = false;
+	if (CanInlineCacheRead()) {
+		while (inline_num < argvs->size()
+			&& InlineCacheRead((*argvs)[inline_num], &cache_missed)) {
+			inline_num++;
+		}
+	}
+	if (inline_num == argvs->size()) {
+		// 全部在网络线程中回复，由网络线程直接发送，不必再通知自己
+		set_is_reply(true);
+		SetRepliedInPlace();
 		return;
 	}
 
 	BgTaskArg* arg = new BgTaskArg();
-	arg->redis_cmds = argvs;
+	// 解析器不再使用这些参数，直接移走，避免再拷贝一次
+	arg->redis_cmds.assign(std::make_move_iterator(argvs->begin() + inline_num),
+						   std::make_move_iterator(argvs->end()));
 	arg->response = response;
 	arg->pcc = std::dynamic_pointer_cast<PikaClientConn>(shared_from_this());
 	arg->recv_cmd_time_us = slash::NowMicros();
+	// 第一个命令已经在网络线程中读过缓存且未命中，线程池中直接读rocksdb
+	arg->cache_missed = cache_missed;
 
 	/* 
 	* pipeline时，通过第一个命令判断这批命令是快命令还是慢命令，因为proxy端
 	* 做了命令的快慢分离，同一个连接上，要么都是快命令，要么都是慢命令。
+	* 此外，如果这批命令中有最近执行很慢的命令（比如大key上的hgetall），
+	* 也交给慢线程池，同一批命令只能在一个线程池中执行，保证回复的顺序。
 	*/
-	std::string opt = argvs[0][0];
+	std::string opt = arg->redis_cmds[0][0];
 	slash::StringToLower(opt);
 	int priority = g_pika_conf->is_slow_cmd(opt) ? THREADPOOL_SLOW : THREADPOOL_FAST;
+	if (priority == THREADPOOL_FAST && IsCostlyBatch(arg->redis_cmds)) {
+		priority = THREADPOOL_SLOW;
+		g_pika_server->GetCmdCostStats()->AddRouted(1);
+	}
 	arg->queue_size = g_pika_server->GetThreadPoolTasks(priority);
+	arg->priority = priority;
 	g_pika_server->Schedule(&DoBackgroundTask, arg, priority);
 }
 
+bool PikaClientConn::IsCostlyBatch(const std::vector<pink::RedisCmdArgsType>& argvs) {
+	int threshold = g_pika_conf->adaptive_slow_threshold();
+	if (threshold <= 0) {
+		return false;
+	}
+	CmdCostStats* cost_stats = g_pika_server->GetCmdCostStats();
+	for (const auto& argv : argvs) {
+		if (argv.empty()) {
+			continue;
+		}
+		int index = GetCmdIndex(argv[0]);
+		if (index < 0
+			|| !cost_stats->IsCostly(index, argv.size() >= 2 ? argv[1] : kNoKey, threshold)) {
+			continue;
+		}
+		if (!g_pika_conf->is_fast_cmd(GetCmdInfoByIndex(index)->name())) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool PikaClientConn::CanInlineCacheRead() {
+	return g_pika_conf->cache_read_inline()
+		&& PIKA_CACHE_NONE != g_pika_conf->cache_model()
+		&& PIKA_CACHE_STATUS_OK == g_pika_server->Cache()->CacheStatus()
+		&& !g_pika_server->HasMonitorClients()
+		&& !is_pubsub_;
+}
+
+bool PikaClientConn::InlineCacheRead(const PikaCmdArgsType& argv, bool* cache_missed) {
+	*cache_missed = false;
+	if (argv.size() < 2) {
+		return false;
+	}
+	uint64_t start_us = slash::NowMicros();
+	const CmdInfo* cinfo_ptr = NULL;
+	Cmd* c_ptr = g_pika_cmd_table_manager->GetCmd(argv[0], &cinfo_ptr);
+	if (!c_ptr
+		|| !cinfo_ptr->is_read()
+		|| !cinfo_ptr->need_cache_do()
+		|| !cinfo_ptr->need_read_cache()
+		|| cinfo_ptr->is_suspend()
+		|| !auth_stat_.IsAuthed(cinfo_ptr)) {
+		return false;
+	}
+
+	// Errors and cache misses are left to the thread pool
+	c_ptr->Initial(argv, cinfo_ptr);
+	if (!c_ptr->res().ok()) {
+		return false;
+	}
+	// Never wait for a suspend command here, it would stall every conn
+	// of this network thread
+	if (!g_pika_server->RWTryLockReader()) {
+		return false;
+	}
+	c_ptr->PreDo();
+	g_pika_server->RWUnlockReader();
+	if (!c_ptr->res().ok()) {
+		*cache_missed = c_ptr->res().CacheMiss();
+		return false;
+	}
+
+	// 和DoCmd一样记录耗时和慢日志，这里只有读缓存的时间
+	uint64_t cache_time = slash::NowMicros() - start_us;
+	g_pika_server->PlusThreadQuerynum();
+	int adaptive_slow_threshold = g_pika_conf->adaptive_slow_threshold();
+	if (adaptive_slow_threshold > 0) {
+		g_pika_server->GetCmdCostStats()->Record(GetCmdIndex(argv[0]), argv[1],
+												 cache_time, adaptive_slow_threshold);
+	}
+	if (g_pika_conf->slowlog_slower_than() >= 0) {
+		g_pika_server->GetCmdStats()->IncrOpStatsByCmd(cinfo_ptr->name(), cache_time, false);
+		if (cache_time > static_cast<uint64_t>(g_pika_conf->slowlog_slower_than())) {
+			uint64_t slowlog_id = ++slowlog_count_;
+			if (0 == slowlog_mutex_.Trylock()) {
+				g_pika_server->SlowlogPushEntry(argv, slowlog_id, start_us / 1000000, cache_time);
+				if (g_pika_server->RequestToken()) {
+					LOG(ERROR) << "id:" << slowlog_id
+							   << ", ip_port: " << ip_port()
+							   << ", inline cache read: " << slash::ToRead(argv[0])
+							   << " " << slash::ToRead(argv[1])
+							   << ", total_time: " << cache_time;
+				}
+				slowlog_mutex_.Unlock();
+			}
+		}
+	}
+	std::string* reply = ReplyArena();
+	c_ptr->res().AppendMessageTo(reply);
+	AppendReply(reply);
+	return true;
+}
+
 void PikaClientConn::BatchExecRedisCmd(const std::vector<pink::RedisCmdArgsType>& argvs,
 									   std::string* response,
 									   uint64_t recv_cmd_time_us,
-									   uint32_t queue_size) {
+									   uint32_t queue_size,
+									   int priority,
+									   bool cache_missed) {
+	QueueAgeStats* queue_stats = g_pika_server->GetPoolQueueStats(priority);
+	uint64_t queue_time = slash::NowMicros() - recv_cmd_time_us;
+	queue_stats->Add(queue_time);
+	int deadline_ms = priority == THREADPOOL_SLOW
+		? g_pika_conf->slow_pool_queue_deadline()
+		: g_pika_conf->fast_pool_queue_deadline();
+	bool expired = deadline_ms > 0 && queue_time > static_cast<uint64_t>(deadline_ms) * 1000;
+
 	bool success = true;
-	for (const auto& argv : argvs) {
-		if (ExecRedisCmd(argv, response, recv_cmd_time_us, queue_size) != 0) {
+	size_t i = 0;
+	while (i < argvs.size()) {
+		// 排队超时的读命令直接返回错误，客户端已经放弃等待；写命令和管理命令照常执行
+		if (expired) {
+			const CmdInfo* cinfo_ptr = GetCmdInfo(argvs[i][0]);
+			if (cinfo_ptr && cinfo_ptr->is_read() && !cinfo_ptr->is_admin()) {
+				g_pika_server->PlusThreadQuerynum();
+				queue_stats->AddShed(1);
+				std::string resp = "-ERR request expired in thread pool queue\r\n";
+				AppendReply(&resp);
+				i++;
+				continue;
+			}
+		}
+		// 连续的GET合并成一次MultiGet
+		size_t get_num = BatchGetNum(argvs, i);
+		if (get_num >= PIKA_BATCH_GET_MIN) {
+			BatchGet(argvs, i, get_num, recv_cmd_time_us, cache_missed && i == 0);
+			i += get_num;
+			continue;
+		}
+		if (ExecRedisCmd(argvs[i], response, recv_cmd_time_us, queue_size,
+						 cache_missed && i == 0) != 0) {
 			success = false;
 			break;
 		}
+		i++;
 	}
     
-    if (!response->empty()) {
+    if (!ReplyEmpty()) {
         set_is_reply(true);
         NotifyEpoll(success);
     }
 }
 
+size_t PikaClientConn::BatchGetNum(const std::vector<pink::RedisCmdArgsType>& argvs, size_t begin) {
+	if (is_pubsub_ || g_pika_server->HasMonitorClients()) {
+		return 0;
+	}
+	const CmdInfo* get_info = GetCmdInfo(kCmdNameGet);
+	if (!get_info || !auth_stat_.IsAuthed(get_info)) {
+		return 0;
+	}
+	size_t end = begin;
+	while (end < argvs.size()
+		&& argvs[end].size() == 2
+		&& GetCmdInfo(argvs[end][0]) == get_info) {
+		end++;
+	}
+	return end - begin;
+}
+
+void PikaClientConn::BatchGet(const std::vector<pink::RedisCmdArgsType>& argvs,
+							  size_t begin, size_t num,
+							  uint64_t recv_cmd_time_us,
+							  bool first_cache_missed) {
+	uint64_t start_us = slash::NowMicros();
+	const CmdInfo* const cinfo_ptr = GetCmdInfo(kCmdNameGet);
+	std::vector<std::string> keys;
+	keys.reserve(num);
+	for (size_t i = begin; i < begin + num; i++) {
+		keys.push_back(argvs[i][1]);
+	}
+	std::vector<CmdRes> results(num);
+
+	g_pika_server->RWLockReader();
+	// 和DoCmd中GET的缓存逻辑一致：先读缓存，未命中的key一起读rocksdb，再回填缓存
+	bool cache_do = cinfo_ptr->need_cache_do()
+		&& PIKA_CACHE_NONE != g_pika_conf->cache_model()
+		&& PIKA_CACHE_STATUS_OK == g_pika_server->Cache()->CacheStatus();
+	std::vector<std::string> miss_keys;
+	std::vector<size_t> miss_pos;
+	for (size_t i = 0; i < num; i++) {
+		std::string value;
+		if (cache_do && !(i == 0 && first_cache_missed)
+			&& g_pika_server->Cache()->Get(keys[i], &value).ok()) {
+			results[i].AppendStringLen(value.size());
+			results[i].AppendContent(value);
+		} else {
+			miss_keys.push_back(keys[i]);
+			miss_pos.push_back(i);
+		}
+	}
+	if (!miss_keys.empty()) {
+		std::vector<blackwidow::ValueStatus> vss;
+		rocksdb::Status s;
+		if (cache_do) {
+			std::vector<int64_t> ttls;
+			slash::MultiScopeRecordLock l(g_pika_server->LockMgr(), miss_keys);
+			s = g_pika_server->db()->MGetWithTTL(miss_keys, &vss, &ttls);
+			for (size_t j = 0; s.ok() && j < vss.size(); j++) {
+				if (vss[j].status.ok()) {
+					g_pika_server->Cache()->WriteKvToCache(miss_keys[j], vss[j].value, ttls[j]);
+				}
+			}
+		} else {
+			s = g_pika_server->db()->MGet(miss_keys, &vss);
+		}
+		for (size_t j = 0; j < miss_pos.size(); j++) {
+			CmdRes& res = results[miss_pos[j]];
+			if (!s.ok()) {
+				res.SetRes(CmdRes::kErrOther, s.ToString());
+			} else if (vss[j].status.ok()) {
+				res.AppendStringLen(vss[j].value.size());
+				res.AppendContent(vss[j].value);
+			} else if (vss[j].status.IsNotFound()) {
+				res.AppendStringLen(-1);
+			} else {
+				res.SetRes(CmdRes::kErrOther, vss[j].status.ToString());
+			}
+		}
+	}
+	g_pika_server->RWUnlockReader();
+
+	uint64_t total_time = slash::NowMicros() - recv_cmd_time_us;
+	uint64_t queue_time = start_us - recv_cmd_time_us;
+	for (size_t i = 0; i < num; i++) {
+		g_pika_server->PlusThreadQuerynum();
+		if (g_pika_conf->slowlog_slower_than() >= 0) {
+			g_pika_server->GetCmdStats()->IncrOpStatsByCmd(cinfo_ptr->name(), total_time, !results[i].ok());
+			if (total_time > static_cast<uint64_t>(g_pika_conf->slowlog_slower_than())) {
+				uint64_t slowlog_id = ++slowlog_count_;
+				if (0 == slowlog_mutex_.Trylock()) {
+					g_pika_server->SlowlogPushEntry(argvs[begin + i], slowlog_id, recv_cmd_time_us / 1000000, total_time);
+					slowlog_mutex_.Unlock();
+				}
+			}
+		}
+		std::string* reply = ReplyArena();
+		results[i].AppendMessageTo(reply);
+		AppendReply(reply);
+	}
+	if (g_pika_conf->slowlog_slower_than() >= 0
+		&& total_time > static_cast<uint64_t>(g_pika_conf->slowlog_slower_than())
+		&& g_pika_server->RequestToken()) {
+		LOG(ERROR) << "ip_port: " << ip_port()
+				   << ", batch get: " << num << " keys"
+				   << ", [ " << queue_time << " " << total_time - queue_time << " ]"
+				   << ", total_time: " << total_time;
+	}
+}
+
 int PikaClientConn::ExecRedisCmd(const pink::RedisCmdArgsType& argv,
                 				 std::string* response,
                 				 uint64_t recv_cmd_time_us,
-                				 uint32_t queue_size) {
+                				 uint32_t queue_size,
+                				 bool cache_missed) {
 	g_pika_server->PlusThreadQuerynum();
 	
 	if (argv.empty()) return -2;
-	std::string opt = argv[0];
-	slash::StringToLower(opt);
-    std::string resp = DoCmd(argv, opt, recv_cmd_time_us, queue_size);
-	if (response->empty()) {
-		// Avoid memory copy
-        if (is_pubsub_) {
-            RespLock();
-            *response = std::move(resp);
-            RespUnlock();
-        } else {
-            *response = std::move(resp);
-        }
-	} else {
-		// Maybe pipeline
-        if (is_pubsub_) {
-            RespLock();
-            response->append(resp);
-            RespUnlock();
-        } else {
-            response->append(resp);
-        }
-	}
+	std::string* reply = ReplyArena();
+	DoCmd(argv, recv_cmd_time_us, queue_size, cache_missed, reply);
+	// response就是本连接的response_，小的回复拷贝进去，大的回复单独成块，避免拷贝
+    if (is_pubsub_) {
+        RespLock();
+        AppendReply(reply);
+        RespUnlock();
+    } else {
+        AppendReply(reply);
+    }
 	return 0;
 }
 
@@ -458,7 +761,8 @@ int PikaClientConn::DealMessage(const PikaCmdArgsType& argv, std::string* respon
 
 void PikaClientConn::DoBackgroundTask(void* arg) {
 	BgTaskArg* bg_arg = reinterpret_cast<BgTaskArg*>(arg);
-	bg_arg->pcc->BatchExecRedisCmd(bg_arg->redis_cmds, bg_arg->response, bg_arg->recv_cmd_time_us, bg_arg->queue_size);
+	bg_arg->pcc->BatchExecRedisCmd(bg_arg->redis_cmds, bg_arg->response, bg_arg->recv_cmd_time_us,
+								   bg_arg->queue_size, bg_arg->priority, bg_arg->cache_missed);
 	delete bg_arg;
 }
 
@@ -475,7 +779,7 @@ void PikaClientConn::AuthStat::Init() {
 
 // Check permission for current command
 bool PikaClientConn::AuthStat::IsAuthed(const CmdInfo* const cinfo_ptr) {
-	std::string opt = cinfo_ptr->name();
+	const std::string& opt = cinfo_ptr->name();
 	if (opt == kCmdNameAuth) {
 		return true;
 	}
@@ -5,53 +5,54 @@
 
 #include "pika_cmd_table_manager.h"
 
+thread_local PikaCmdTableManager::IndexedCmdTable*
+  PikaCmdTableManager::thread_cmd_table_ = nullptr;
+
 PikaCmdTableManager::PikaCmdTableManager() {
-  pthread_rwlock_init(&map_protector_, NULL);
 }
 
 PikaCmdTableManager::~PikaCmdTableManager() {
-  pthread_rwlock_destroy(&map_protector_);
-  for (const auto& item : thread_table_map_) {
-    CmdTable* cmd_table = item.second;
-    CmdTable::const_iterator it = cmd_table->begin();
-    for (; it != cmd_table->end(); ++it) {
-      delete it->second;
+  for (IndexedCmdTable* cmd_table : tables_) {
+    for (Cmd* cmd : *cmd_table) {
+      delete cmd;
     }
     delete cmd_table;
   }
 }
 
-Cmd* PikaCmdTableManager::GetCmd(const std::string& opt) {
-  pid_t tid = gettid();
-  CmdTable* cmd_table = nullptr;
-  if (!CheckCurrentThreadCmdTableExist(tid)) {
-    InsertCurrentThreadCmdTable();
+Cmd* PikaCmdTableManager::GetCmd(const std::string& opt, const CmdInfo** info) {
+  int index = GetCmdIndex(opt);
+  if (index < 0) {
+    return NULL;
   }
-
-  slash::RWLock l(&map_protector_, false);
-  cmd_table = thread_table_map_[tid];
-  CmdTable::const_iterator iter = cmd_table->find(opt);
-  if (iter != cmd_table->end()) {
-    return iter->second;
+  IndexedCmdTable* cmd_table = thread_cmd_table_;
+  if (cmd_table == nullptr) {
+    cmd_table = InsertCurrentThreadCmdTable();
   }
-  return NULL;
-}
-
-bool PikaCmdTableManager::CheckCurrentThreadCmdTableExist(const pid_t& tid) {
-  slash::RWLock l(&map_protector_, false);
-  if (thread_table_map_.find(tid) == thread_table_map_.end()) {
-    return false;
+  if (info != NULL) {
+    *info = GetCmdInfoByIndex(index);
   }
-  return true;
+  return (*cmd_table)[index];
 }
 
-void PikaCmdTableManager::InsertCurrentThreadCmdTable() {
-  pid_t tid = gettid();
-  CmdTable* cmds = new CmdTable();
-  cmds->reserve(300);
-  InitCmdTable(cmds);
-  slash::RWLock l(&map_protector_, true);
-  if (thread_table_map_.find(tid) == thread_table_map_.end()) {
-    thread_table_map_.insert(make_pair(tid, cmds));
+PikaCmdTableManager::IndexedCmdTable*
+PikaCmdTableManager::InsertCurrentThreadCmdTable() {
+  CmdTable cmds;
+  cmds.reserve(300);
+  InitCmdTable(&cmds);
+  IndexedCmdTable* cmd_table = new IndexedCmdTable(GetCmdNum(), NULL);
+  for (const auto& item : cmds) {
+    int index = GetCmdIndex(item.first);
+    if (index < 0) {
+      // No CmdInfo for it, never reachable
+      delete item.second;
+    } else {
+      (*cmd_table)[index] = item.second;
+    }
   }
+
+  slash::MutexLock l(&tables_mutex_);
+  tables_.push_back(cmd_table);
+  thread_cmd_table_ = cmd_table;
+  return cmd_table;
 }
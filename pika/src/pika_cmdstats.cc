@@ -1,4 +1,6 @@
 #include <glog/logging.h>
+#include <algorithm>
+#include <functional>
 
 #include "pika_cmdstats.h"
 #include "slash/include/slash_string.h"
@@ -461,6 +463,120 @@ std::string CmdStats::GetCmdStatsByInterval(int32_t interval){
 	return json;
 }
 
+static const uint64_t QueueAgeBucketBoundMs[QueueAgeBucketNum - 1] =
+	{1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+
+void QueueAgeStats::Add(uint64_t age_us) {
+	int32_t i = 0;
+	while (i < QueueAgeBucketNum - 1 && age_us >= QueueAgeBucketBoundMs[i] * 1000) {
+		i++;
+	}
+	buckets_[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string QueueAgeStats::ToString() const {
+	std::string result;
+	for (int32_t i = 0; i < QueueAgeBucketNum; i++) {
+		if (i > 0) {
+			result += ",";
+		}
+		result += (i < QueueAgeBucketNum - 1) ? std::to_string(QueueAgeBucketBoundMs[i]) : "inf";
+		result += "=" + std::to_string(buckets_[i].load(std::memory_order_relaxed));
+	}
+	return result;
+}
+
+void QueueAgeStats::Reset() {
+	for (int32_t i = 0; i < QueueAgeBucketNum; i++) {
+		buckets_[i].store(0);
+	}
+	shed_.store(0);
+}
+
+CmdCostStats::CmdCostStats(int cmd_num)
+	: cmd_num_(cmd_num),
+	  avg_us_(new std::atomic<uint64_t>[cmd_num > 0 ? cmd_num : 1]),
+	  routed_(0) {
+	Reset();
+}
+
+CmdCostStats::~CmdCostStats() {
+	delete[] avg_us_;
+}
+
+uint64_t CmdCostStats::KeyHash(int cmd_index, const std::string& key) {
+	uint64_t h = std::hash<std::string>()(key) ^ (static_cast<uint64_t>(cmd_index + 1) * 0x9e3779b97f4a7c15ULL);
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+void CmdCostStats::Record(int cmd_index, const std::string& key, uint64_t cost_us, uint64_t threshold_us) {
+	if (cmd_index < 0 || cmd_index >= cmd_num_) {
+		return;
+	}
+	// 单个样本最多按两倍阈值计入，偶尔一次大key上的慢请求只影响这个key，
+	// 多数请求都慢时命令本身才算慢；并发更新时丢掉个别样本没有关系，不需要CAS
+	uint64_t sample = std::min(cost_us, 2 * threshold_us);
+	uint64_t avg = avg_us_[cmd_index].load(std::memory_order_relaxed);
+	avg = avg - avg / 32 + sample / 32;
+	avg_us_[cmd_index].store(avg, std::memory_order_relaxed);
+
+	if (key.empty()) {
+		return;
+	}
+	uint64_t h = KeyHash(cmd_index, key);
+	uint64_t tag = (h >> 32) << 32;
+	std::atomic<uint64_t>& slot = costly_keys_[h & (CostKeySlotNum - 1)];
+	if (cost_us > threshold_us) {
+		uint64_t now_sec = slash::NowMicros() / 1000000;
+		slot.store(tag | (now_sec & 0xffffffff), std::memory_order_relaxed);
+	} else {
+		// key变小了，下一次就回到快线程池
+		uint64_t old = slot.load(std::memory_order_relaxed);
+		if (old != 0 && (old & 0xffffffff00000000ULL) == tag) {
+			slot.compare_exchange_strong(old, 0, std::memory_order_relaxed);
+		}
+	}
+}
+
+bool CmdCostStats::IsCostly(int cmd_index, const std::string& key, uint64_t threshold_us) const {
+	if (cmd_index < 0 || cmd_index >= cmd_num_) {
+		return false;
+	}
+	if (avg_us_[cmd_index].load(std::memory_order_relaxed) > threshold_us) {
+		return true;
+	}
+	if (key.empty()) {
+		return false;
+	}
+	uint64_t h = KeyHash(cmd_index, key);
+	uint64_t value = costly_keys_[h & (CostKeySlotNum - 1)].load(std::memory_order_relaxed);
+	if (value == 0 || (value & 0xffffffff00000000ULL) != ((h >> 32) << 32)) {
+		return false;
+	}
+	uint32_t now_sec = static_cast<uint32_t>(slash::NowMicros() / 1000000);
+	return static_cast<uint32_t>(now_sec - static_cast<uint32_t>(value)) < static_cast<uint32_t>(CostKeyTtlSec);
+}
+
+uint64_t CmdCostStats::AvgCost(int cmd_index) const {
+	if (cmd_index < 0 || cmd_index >= cmd_num_) {
+		return 0;
+	}
+	return avg_us_[cmd_index].load(std::memory_order_relaxed);
+}
+
+void CmdCostStats::Reset() {
+	for (int i = 0; i < cmd_num_; i++) {
+		avg_us_[i].store(0);
+	}
+	for (int32_t i = 0; i < CostKeySlotNum; i++) {
+		costly_keys_[i].store(0);
+	}
+	routed_.store(0);
+}
+
 std::string CmdStats::GetOpStats(int32_t index){
 	std::string json = "";
 
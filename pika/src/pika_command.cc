@@ -16,8 +16,140 @@
 #include "pika_pubsub.h"
 #include "pika_ehash.h"
 
+#include <glog/logging.h>
+#include <strings.h>
+#include <algorithm>
+
 static std::unordered_map<std::string, CmdInfo*> cmd_infos(300);    /* Table for CmdInfo */
 
+/*
+ * Perfect hash of the command names, built once by InitCmdInfoTable.
+ * A name goes to bucket (h >> 32) % bucket num, and to slot
+ * Fmix32(h ^ disp[bucket]) & slot mask, disp of every bucket is searched
+ * so that no two names share a slot. A lookup costs one hash of the name,
+ * and one compare with the name in its slot. The names are those of the
+ * table, not of the CmdInfos, pttl has the CmdInfo of ttl
+ */
+static std::vector<std::string> cmd_index_names;      /* Index -> name */
+static std::vector<const CmdInfo*> cmd_index_infos;   /* Index -> CmdInfo */
+static std::vector<uint32_t> cmd_hash_disps;
+static std::vector<int16_t> cmd_hash_slots;           /* Slot -> index, -1 if empty */
+static uint32_t cmd_hash_slot_mask = 0;
+
+static inline uint64_t CmdNameHash(const char* name, size_t len) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = name[i];
+    if (c >= 'A' && c <= 'Z') {
+      c += 'a' - 'A';
+    }
+    h = (h ^ c) * 1099511628211ULL;
+  }
+  return h;
+}
+
+static inline uint32_t Fmix32(uint32_t h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+static inline uint32_t CmdHashSlot(uint64_t h, uint32_t disp) {
+  return Fmix32(static_cast<uint32_t>(h) ^ disp) & cmd_hash_slot_mask;
+}
+
+static void BuildCmdIndex() {
+  cmd_index_names.clear();
+  cmd_index_infos.clear();
+  for (const auto& item : cmd_infos) {
+    cmd_index_names.push_back(item.first);
+    cmd_index_infos.push_back(item.second);
+  }
+  size_t num = cmd_index_infos.size();
+  size_t slot_num = 2;
+  while (slot_num < 2 * num) {
+    slot_num <<= 1;
+  }
+  size_t bucket_num = std::max(num, static_cast<size_t>(1));
+  cmd_hash_slot_mask = static_cast<uint32_t>(slot_num - 1);
+  cmd_hash_slots.assign(slot_num, -1);
+  cmd_hash_disps.assign(bucket_num, 0);
+
+  std::vector<uint64_t> hashes(num);
+  std::vector<std::vector<int> > buckets(bucket_num);
+  for (size_t i = 0; i < num; i++) {
+    const std::string& name = cmd_index_names[i];
+    hashes[i] = CmdNameHash(name.data(), name.size());
+    buckets[(hashes[i] >> 32) % bucket_num].push_back(i);
+  }
+  std::vector<size_t> order(bucket_num);
+  for (size_t i = 0; i < bucket_num; i++) {
+    order[i] = i;
+  }
+  // Place the crowded buckets first, while most slots are free
+  std::sort(order.begin(), order.end(), [&buckets](size_t a, size_t b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+
+  std::vector<uint32_t> slots;
+  for (size_t b : order) {
+    const std::vector<int>& keys = buckets[b];
+    uint32_t disp = 0;
+    for (; disp < (1U << 24); disp++) {
+      slots.clear();
+      bool ok = true;
+      for (int k : keys) {
+        uint32_t slot = CmdHashSlot(hashes[k], disp);
+        if (cmd_hash_slots[slot] != -1
+            || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+          ok = false;
+          break;
+        }
+        slots.push_back(slot);
+      }
+      if (ok) {
+        break;
+      }
+    }
+    if (disp == (1U << 24)) {
+      LOG(FATAL) << "Can not build the command index";
+    }
+    cmd_hash_disps[b] = disp;
+    for (size_t i = 0; i < keys.size(); i++) {
+      cmd_hash_slots[slots[i]] = static_cast<int16_t>(keys[i]);
+    }
+  }
+}
+
+int GetCmdIndex(const std::string& opt) {
+  if (cmd_hash_disps.empty()) {
+    return -1;
+  }
+  uint64_t h = CmdNameHash(opt.data(), opt.size());
+  uint32_t disp = cmd_hash_disps[(h >> 32) % cmd_hash_disps.size()];
+  int index = cmd_hash_slots[CmdHashSlot(h, disp)];
+  if (index < 0) {
+    return -1;
+  }
+  const std::string& name = cmd_index_names[index];
+  if (name.size() != opt.size()
+      || strncasecmp(name.data(), opt.data(), opt.size()) != 0) {
+    return -1;
+  }
+  return index;
+}
+
+int GetCmdNum() {
+  return static_cast<int>(cmd_index_infos.size());
+}
+
+const CmdInfo* GetCmdInfoByIndex(int index) {
+  return cmd_index_infos[index];
+}
+
 //Remember the first arg is the command name
 void InitCmdInfoTable() {
   //Admin
@@ -25,7 +157,7 @@ void InitCmdInfoTable() {
   CmdInfo* slaveofptr = new CmdInfo(kCmdNameSlaveof, -3, kCmdFlagsRead | kCmdFlagsAdmin);
   cmd_infos.insert(std::pair<std::string, CmdInfo*>(kCmdNameSlaveof, slaveofptr));
   ////Trysync
-  CmdInfo* trysyncptr = new CmdInfo(kCmdNameTrysync, 5, kCmdFlagsRead | kCmdFlagsAdmin | kCmdFlagsSuspend); //del kCmdFlagsAdminRequire for dashbaod config slave masterauth
+  CmdInfo* trysyncptr = new CmdInfo(kCmdNameTrysync, -5, kCmdFlagsRead | kCmdFlagsAdmin | kCmdFlagsSuspend); //del kCmdFlagsAdminRequire for dashbaod config slave masterauth
   cmd_infos.insert(std::pair<std::string, CmdInfo*>(kCmdNameTrysync, trysyncptr));
   CmdInfo* authptr = new CmdInfo(kCmdNameAuth, 2, kCmdFlagsRead | kCmdFlagsAdmin);
   cmd_infos.insert(std::pair<std::string, CmdInfo*>(kCmdNameAuth, authptr));
@@ -75,7 +207,7 @@ void InitCmdInfoTable() {
   cmd_infos.insert(std::pair<std::string, CmdInfo*>(kCmdNameZsetAutoDel, zsetautodelptr));
   CmdInfo* zsetautodeloffptr = new CmdInfo(kCmdNameZsetAutoDelOff, 1, kCmdFlagsRead | kCmdFlagsAdmin);
   cmd_infos.insert(std::pair<std::string, CmdInfo*>(kCmdNameZsetAutoDelOff, zsetautodeloffptr));
-  CmdInfo* pikaadminptr = new CmdInfo(kCmdNamePikaAdmin, 2,  kCmdFlagsSuspend | kCmdFlagsAdmin);
+  CmdInfo* pikaadminptr = new CmdInfo(kCmdNamePikaAdmin, -2,  kCmdFlagsSuspend | kCmdFlagsAdmin);
   cmd_infos.insert(std::pair<std::string, CmdInfo*>(kCmdNamePikaAdmin, pikaadminptr));
 
   //migrate slot
@@ -527,21 +659,25 @@ void InitCmdInfoTable() {
   ////Ehscan
   CmdInfo* ehscanptr = new CmdInfo(kCmdNameEhscan, -3, kCmdFlagsRead | kCmdFlagsEhash);
   cmd_infos.insert(std::pair<std::string, CmdInfo*>(kCmdNameEhscan, ehscanptr));
+
+  BuildCmdIndex();
 }
 
 void DestoryCmdInfoTable() {
+  cmd_hash_disps.clear();
+  cmd_hash_slots.clear();
+  cmd_index_names.clear();
+  cmd_index_infos.clear();
   std::unordered_map<std::string, CmdInfo*>::const_iterator it = cmd_infos.begin();
   for (; it != cmd_infos.end(); ++it) {
     delete it->second;
   }
+  cmd_infos.clear();
 }
 
 const CmdInfo* GetCmdInfo(const std::string& opt) {
-  std::unordered_map<std::string, CmdInfo*>::const_iterator it = cmd_infos.find(opt);
-  if (it != cmd_infos.end()) {
-    return it->second;
-  }
-  return NULL;
+  int index = GetCmdIndex(opt);
+  return index < 0 ? NULL : cmd_index_infos[index];
 }
 
 void InitCmdTable(std::unordered_map<std::string, Cmd*> *cmd_table) {
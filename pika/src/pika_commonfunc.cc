@@ -11,9 +11,11 @@
 
 #include "pink/include/redis_conn.h"
 #include "pink/include/redis_cli.h"
+#include "slash/include/env.h"
 #include "slash/include/slash_mutex.h"
 #include "slash/include/slash_status.h"
 #include "slash/include/slash_string.h"
+#include "util/crc32c.h"
 
 extern PikaServer *g_pika_server;
 extern PikaConf *g_pika_conf;
@@ -104,7 +106,8 @@ PikaCommonFunc::BinlogPut(const std::string &key, const std::string &raw_args) {
     uint32_t crc = CRC32Update(0, key.data(), (int)key.size());
     int binlog_writer_num = g_pika_conf->binlog_writer_num();
     int thread_index = (int)(crc % binlog_writer_num);
-    slash::Status s = g_pika_server->binlog_write_thread_[thread_index]->WriteBinlog(raw_args, "sync" == g_pika_conf->binlog_writer_method());
+    slash::Status s = g_pika_server->binlog_write_thread_[thread_index]->WriteBinlog(raw_args, "sync" == g_pika_conf->binlog_writer_method(),
+            g_pika_server->BinlogShard(crc));
     if (!s.ok()) {
         LOG(ERROR) << "Writing binlog failed, maybe no space left on device";
         for (int i = 0; i < binlog_writer_num; i++) {
@@ -132,3 +135,42 @@ PikaCommonFunc::AppendSubDirectory(const std::string& db_path, const std::string
         return db_path + "/" + sub_path;
     }
 }
+
+bool
+PikaCommonFunc::IsImmutableDBFile(const std::string& path) {
+    static const std::string kSuffixes[] = {".sst", ".blob"};
+    for (const auto& suffix : kSuffixes) {
+        if (path.size() > suffix.size()
+            && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+PikaCommonFunc::FileChecksum(const std::string& path, uint32_t* checksum) {
+    slash::SequentialFile* reader = NULL;
+    slash::Status s = slash::NewSequentialFile(path, &reader);
+    if (!s.ok()) {
+        return false;
+    }
+    const size_t kBufSize = 1024 * 1024;
+    char* scratch = new char[kBufSize];
+    slash::Slice data;
+    uint32_t crc = 0;
+    while (true) {
+        s = reader->Read(kBufSize, &data, scratch);
+        if (!s.ok() || data.size() == 0) {
+            break;
+        }
+        crc = rocksdb::crc32c::Extend(crc, data.data(), data.size());
+    }
+    delete[] scratch;
+    delete reader;
+    if (!s.ok()) {
+        return false;
+    }
+    *checksum = crc;
+    return true;
+}
@@ -3,6 +3,7 @@
 // LICENSE file in the root directory of this source tree. An additional grant
 // of patent rights can be found in the PATENTS file in the same directory.
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -65,6 +66,21 @@ int PikaConf::Load()
     GetConfInt("root-connection-num", &root_connection_num);
     root_connection_num_ = (root_connection_num < 0) ? 2 : root_connection_num;
 
+    SetClientOutputBufferLimit("normal 0 0 0 pubsub 32mb 8mb 60 monitor 32mb 8mb 60");
+    std::string client_output_buffer_limit;
+    GetConfStr("client-output-buffer-limit", &client_output_buffer_limit);
+    if (!client_output_buffer_limit.empty()
+        && !SetClientOutputBufferLimit(client_output_buffer_limit)) {
+        fprintf(stderr, "Invalid client-output-buffer-limit value in conf file\n");
+        exit(-1);
+    }
+
+    std::string client_output_buffer_pause = "64mb";
+    GetConfStr("client-output-buffer-pause", &client_output_buffer_pause);
+    int memtoll_err = 0;
+    long long pause_len = slash::memtoll(client_output_buffer_pause.c_str(), &memtoll_err);
+    client_output_buffer_pause_ = (memtoll_err || pause_len < 0) ? 64 << 20 : pause_len;
+
     int slowlog_log_slower_than = 100000;
     GetConfInt("slowlog-log-slower-than", &slowlog_log_slower_than);
     slowlog_log_slower_than_ = (slowlog_log_slower_than < 0) ? 100000 : slowlog_log_slower_than;
@@ -126,6 +142,30 @@ int PikaConf::Load()
         binlog_writer_num_ = binlog_writer_num;
     }
 
+    int binlog_shard_num = 1;
+    GetConfInt("binlog-shard-num", &binlog_shard_num);
+    if (binlog_shard_num <= 0 || binlog_shard_num > kBinlogMaxShardNum) {
+        binlog_shard_num_ = 1;
+    } else {
+        binlog_shard_num_ = binlog_shard_num;
+    }
+
+    binlog_compression_ = "none";
+    GetConfStr("binlog-compression", &binlog_compression_);
+    slash::StringToLower(binlog_compression_);
+    if (binlog_compression_ != "none" && binlog_compression_ != "snappy") {
+        binlog_compression_ = "none";
+    }
+
+    std::string replicate_compressed_binlog = "no";
+    GetConfStr("replicate-compressed-binlog", &replicate_compressed_binlog);
+    replicate_compressed_binlog_ = (replicate_compressed_binlog == "yes") ? true : false;
+
+    std::string binlog_format = "resp";
+    GetConfStr("binlog-format", &binlog_format);
+    slash::StringToLower(binlog_format);
+    binlog_binary_format_ = (binlog_format == "binary") ? true : false;
+
     GetConfStr("compression", &compression_);
 
     bool readonly = 0 ;
@@ -173,6 +213,10 @@ int PikaConf::Load()
         thread_num_ = thread_num;
     }
 
+    std::string reuse_port = "no";
+    GetConfStr("reuse-port", &reuse_port);
+    reuse_port_ = (reuse_port == "yes") ? true : false;
+
     int sync_thread_num = 6;
     GetConfInt("sync-thread-num", &sync_thread_num);
     if (sync_thread_num <= 0) {
@@ -376,6 +420,14 @@ int PikaConf::Load()
     GetConfInt("db-sync-speed", &db_sync_speed);
     db_sync_speed_ = (db_sync_speed < 0 || db_sync_speed > 125) ? 125 : db_sync_speed;
 
+    int db_sync_parallel = 4;
+    GetConfInt("db-sync-parallel", &db_sync_parallel);
+    db_sync_parallel_ = (db_sync_parallel < 1 || db_sync_parallel > 16) ? 4 : db_sync_parallel;
+
+    std::string db_sync_rsync = "no";
+    GetConfStr("db-sync-rsync", &db_sync_rsync);
+    db_sync_rsync_ = (db_sync_rsync == "yes") ? true : false;
+
     // network interface
     network_interface_ = "";
     GetConfStr("network-interface", &network_interface_);
@@ -426,6 +478,10 @@ int PikaConf::Load()
     GetConfInt("cache-lfu-decay-time", &cache_lfu_decay_time);
     cache_lfu_decay_time_ = (0 > cache_lfu_decay_time) ? 1 : cache_lfu_decay_time;
 
+    std::string cache_read_inline = "yes";
+    GetConfStr("cache-read-inline", &cache_read_inline);
+    cache_read_inline_ = (cache_read_inline == "no") ? false : true;
+
     int64_t min_blob_size = 65536;
     GetConfInt64("min-blob-size", &min_blob_size);
     min_blob_size_ = (256 > min_blob_size) ? 256 : min_blob_size;
@@ -538,10 +594,26 @@ int PikaConf::Load()
         slow_thread_pool_size_ = slow_thread_pool_size;
     }
 
+    int fast_pool_queue_deadline = 0;
+    GetConfInt("fast-pool-queue-deadline", &fast_pool_queue_deadline);
+    fast_pool_queue_deadline_ = (0 > fast_pool_queue_deadline) ? 0 : fast_pool_queue_deadline;
+
+    int slow_pool_queue_deadline = 0;
+    GetConfInt("slow-pool-queue-deadline", &slow_pool_queue_deadline);
+    slow_pool_queue_deadline_ = (0 > slow_pool_queue_deadline) ? 0 : slow_pool_queue_deadline;
+
     std::string slow_cmd_list;
     GetConfStr("slow-cmd-list", &slow_cmd_list);
     SetSlowCmdList(std::string(slow_cmd_list));
 
+    int adaptive_slow_threshold = 0;
+    GetConfInt("adaptive-slow-threshold", &adaptive_slow_threshold);
+    adaptive_slow_threshold_ = (0 > adaptive_slow_threshold) ? 0 : adaptive_slow_threshold;
+
+    std::string fast_cmd_list;
+    GetConfStr("fast-cmd-list", &fast_cmd_list);
+    SetFastCmdList(fast_cmd_list);
+
     return ret;
 }
 
@@ -550,6 +622,7 @@ int PikaConf::ConfigRewrite() {
     slash::MutexLock l(&config_mutex_);
     SetConfInt("port", port_);
     SetConfInt("thread-num", thread_num_);
+    SetConfStr("reuse-port", reuse_port_ ? "yes" : "no");
     SetConfInt("sync-thread-num", sync_thread_num_);
     SetConfInt("sync-buffer-size", sync_buffer_size_);
     SetConfStr("log-path", log_path_);
@@ -558,6 +631,8 @@ int PikaConf::ConfigRewrite() {
     SetConfStr("db-path", db_path_);
     SetConfStr("db-sync-path", db_sync_path_);
     SetConfInt("db-sync-speed", db_sync_speed_);
+    SetConfInt("db-sync-parallel", db_sync_parallel_);
+    SetConfStr("db-sync-rsync", db_sync_rsync_ ? "yes" : "no");
     SetConfInt64("write-buffer-size", write_buffer_size_);
     SetConfInt("max-write-buffer-number", max_write_buffer_number_);
     SetConfInt("timeout", timeout_);
@@ -582,7 +657,15 @@ int PikaConf::ConfigRewrite() {
     SetConfInt("binlog-writer-queue-size", binlog_writer_queue_size_);
     SetConfStr("binlog-writer-method", binlog_writer_method_);
     SetConfInt("binlog-writer-num", binlog_writer_num_);
+    SetConfInt("binlog-shard-num", binlog_shard_num_);
+    SetConfStr("binlog-compression", binlog_compression_);
+    SetConfStr("replicate-compressed-binlog", replicate_compressed_binlog_ ? "yes" : "no");
+    SetConfStr("binlog-format", binlog_binary_format_ ? "binary" : "resp");
     SetConfInt("root-connection-num", root_connection_num_);
+    std::string client_output_buffer_limit = this->client_output_buffer_limit();
+    std::replace(client_output_buffer_limit.begin(), client_output_buffer_limit.end(), ' ', ',');
+    SetConfStr("client-output-buffer-limit", client_output_buffer_limit);
+    SetConfInt64("client-output-buffer-pause", client_output_buffer_pause_);
     SetConfInt("slowlog-log-slower-than", slowlog_log_slower_than_);
     SetConfInt("slowlog-max-len", slowlog_max_len_);
     SetConfInt64("slowlog-token-capacity", slowlog_token_capacity_);
@@ -616,6 +699,7 @@ int PikaConf::ConfigRewrite() {
     SetConfStr("cache-type", scache_type());
     SetConfInt("cache-start-direction", cache_start_pos_);
     SetConfInt("cache-items-per-key", cache_items_per_key_);
+    SetConfStr("cache-read-inline", cache_read_inline_ ? "yes" : "no");
 
     SetConfInt64("rate-bytes-per-sec", rate_bytes_per_sec_);
     SetConfStr("disable-wal", disable_wal_ ? "yes" : "no");
@@ -640,7 +724,11 @@ int PikaConf::ConfigRewrite() {
     SetConfStr("use-thread-pool", use_thread_pool_ ? "yes" : "no");
     SetConfInt("fast-thread-pool-size", fast_thread_pool_size_);
     SetConfInt("slow-thread-pool-size", slow_thread_pool_size_);
+    SetConfInt("fast-pool-queue-deadline", fast_pool_queue_deadline_);
+    SetConfInt("slow-pool-queue-deadline", slow_pool_queue_deadline_);
     SetConfStr("slow-cmd-list", slow_cmd_list());
+    SetConfInt("adaptive-slow-threshold", adaptive_slow_threshold_);
+    SetConfStr("fast-cmd-list", fast_cmd_list());
 
     ret = WriteBack();
     return ret;
@@ -672,3 +760,61 @@ void PikaConf::SetCacheType(const std::string &value) {
         }
     }
 }
+
+static const char* kClientClassNames[pink::kOutputBufferClassNum] = {"normal", "pubsub", "monitor"};
+
+std::string PikaConf::client_output_buffer_limit() {
+    RWLock l(&rwlock_, false);
+    std::string result;
+    for (int i = 0; i < pink::kOutputBufferClassNum; i++) {
+        if (i > 0) {
+            result += " ";
+        }
+        result += std::string(kClientClassNames[i])
+            + " " + std::to_string(client_output_buffer_limit_[i].hard_limit)
+            + " " + std::to_string(client_output_buffer_limit_[i].soft_limit)
+            + " " + std::to_string(client_output_buffer_limit_[i].soft_seconds);
+    }
+    return result;
+}
+
+bool PikaConf::SetClientOutputBufferLimit(const std::string &value) {
+    // The conf file drops the spaces of a value, it separates the fields
+    // by commas
+    std::string lower_value = value;
+    slash::StringToLower(lower_value);
+    std::replace(lower_value.begin(), lower_value.end(), ',', ' ');
+    std::vector<std::string> items;
+    slash::StringSplit(lower_value, ' ', items);
+    if (items.empty() || items.size() % 4 != 0) {
+        return false;
+    }
+    // Check all of them before changing any
+    std::vector<std::pair<int, pink::OutputBufferLimit> > limits;
+    for (size_t i = 0; i < items.size(); i += 4) {
+        int type = 0;
+        while (type < pink::kOutputBufferClassNum && items[i] != kClientClassNames[type]) {
+            type++;
+        }
+        int hard_err = 0, soft_err = 0;
+        long long hard = slash::memtoll(items[i + 1].c_str(), &hard_err);
+        long long soft = slash::memtoll(items[i + 2].c_str(), &soft_err);
+        long seconds = 0;
+        if (type == pink::kOutputBufferClassNum
+            || hard_err || soft_err || hard < 0 || soft < 0
+            || !slash::string2l(items[i + 3].data(), items[i + 3].size(), &seconds)
+            || seconds < 0) {
+            return false;
+        }
+        pink::OutputBufferLimit limit;
+        limit.hard_limit = hard;
+        limit.soft_limit = soft;
+        limit.soft_seconds = seconds;
+        limits.push_back(std::make_pair(type, limit));
+    }
+    RWLock l(&rwlock_, true);
+    for (const auto& item : limits) {
+        client_output_buffer_limit_[item.first] = item.second;
+    }
+    return true;
+}
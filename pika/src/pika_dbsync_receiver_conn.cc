@@ -0,0 +1,319 @@
+// Copyright (c) 2018-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+#include "pika_dbsync_receiver_conn.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <set>
+
+#include <glog/logging.h>
+
+#include "slash/include/slash_string.h"
+#include "pika_commonfunc.h"
+#include "pika_conf.h"
+#include "pika_define.h"
+#include "pika_server.h"
+
+extern PikaServer* g_pika_server;
+extern PikaConf* g_pika_conf;
+
+static bool FileSize(const std::string& path, uint64_t* size) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    return false;
+  }
+  *size = st.st_size;
+  return true;
+}
+
+// Relative and inside db-sync-path
+static bool IsSafePath(const std::string& path) {
+  return !path.empty() && path[0] != '/' && path.find("..") == std::string::npos;
+}
+
+// Delete the files under dir not in keep, which are relative to the root
+static void ClearDir(const std::string& dir, const std::string& prefix,
+                     const std::set<std::string>& keep) {
+  std::vector<std::string> children;
+  if (slash::GetChildren(dir, children) != 0) {
+    return;
+  }
+  for (const auto& child : children) {
+    std::string path = dir + child;
+    std::string name = prefix + child;
+    if (slash::IsDir(path) == 0) {
+      ClearDir(path + "/", name + "/", keep);
+    } else if (keep.find(name) == keep.end()) {
+      slash::DeleteFile(path);
+    }
+  }
+}
+
+PikaDBSyncReceiverConn::PikaDBSyncReceiverConn(int fd, const std::string& ip_port)
+    : RedisConn(fd, ip_port, NULL),
+      size_(0),
+      offset_(0),
+      checksum_(0),
+      broken_(false),
+      file_(NULL) {
+}
+
+PikaDBSyncReceiverConn::~PikaDBSyncReceiverConn() {
+  CloseFile();
+}
+
+void PikaDBSyncReceiverConn::SyncProcessRedisCmd(const pink::RedisCmdArgsType& argv,
+                                                 std::string* response) {
+  g_pika_server->TouchDBSync();
+  if (argv[0] == "dbsyncdata") {
+    DataCmd(argv);
+  } else if (argv[0] == "dbsyncfile") {
+    FileCmd(argv, response);
+  } else if (argv[0] == "dbsyncdone") {
+    DoneCmd(argv, response);
+  } else if (argv[0] == "dbsynclink") {
+    LinkCmd(argv, response);
+  } else if (argv[0] == "dbsyncmanifest") {
+    ManifestCmd(argv, response);
+  } else if (argv[0] == "dbsyncclear") {
+    ClearCmd(argv, response);
+  } else {
+    response->append("-ERR unknown command '" + argv[0] + "'\r\n");
+  }
+}
+
+// Only data from the current master is received, and only while waiting
+// for it, the master retries the ones that come before the trysync reply
+bool PikaDBSyncReceiverConn::CheckModule(const std::string& module) {
+  if (!g_pika_server->WaitingDBSync()) {
+    return false;
+  }
+  std::string ip_port = slash::IpPortString(g_pika_server->master_ip(),
+                                            g_pika_server->master_port());
+  return module == kDBSyncModule + "_" + ip_port;
+}
+
+void PikaDBSyncReceiverConn::CloseFile() {
+  if (file_ != NULL) {
+    file_->Close();
+    delete file_;
+    file_ = NULL;
+  }
+  path_.clear();
+}
+
+/*
+ * dbsyncfile <module> <path> <size>, reply the offset to send from.
+ * Sst and blob files never change once written, so the part of them
+ * received already is kept and the master skips it. Other files are
+ * always received from the start
+ */
+void PikaDBSyncReceiverConn::FileCmd(const pink::RedisCmdArgsType& argv,
+                                     std::string* response) {
+  CloseFile();
+  int64_t size = 0;
+  if (argv.size() != 4 || !CheckModule(argv[1]) || !IsSafePath(argv[2])
+      || !slash::string2l(argv[3].data(), argv[3].size(), &size) || size < 0) {
+    LOG(WARNING) << "DBSync deny file from " << ip_port() << ", " << (argv.size() > 2 ? argv[2] : "");
+    response->append("-ERR invalid dbsyncfile\r\n");
+    return;
+  }
+
+  std::string path = g_pika_conf->db_sync_path() + argv[2];
+  std::string tmp_path = path + kDBSyncTmpSuffix;
+  // The last chunk may be torn, receive it again
+  uint64_t offset = 0;
+  if (PikaCommonFunc::IsImmutableDBFile(path) && FileSize(tmp_path, &offset)) {
+    offset -= offset % kDBSyncChunkSize;
+    if (offset > static_cast<uint64_t>(size)) {
+      offset = 0;
+    }
+  }
+  slash::DeleteFile(path);
+  slash::CreatePath(path.substr(0, path.rfind('/')));
+  // The prefix may be left by a sync from another master or bgsave, the
+  // checksum of dbsyncdone covers it
+  uint32_t checksum = 0;
+  if ((truncate(tmp_path.c_str(), offset) != 0 && errno != ENOENT)
+      || (offset > 0 && !PikaCommonFunc::FileChecksum(tmp_path, &checksum))) {
+    offset = 0;
+    checksum = 0;
+    slash::DeleteFile(tmp_path);
+  }
+  slash::Status s = slash::NewRandomRWFile(tmp_path, &file_);
+  if (!s.ok()) {
+    LOG(WARNING) << "DBSync create " << tmp_path << " failed, " << s.ToString();
+    file_ = NULL;
+    response->append("-ERR " + s.ToString() + "\r\n");
+    return;
+  }
+  path_ = path;
+  size_ = size;
+  offset_ = offset;
+  checksum_ = checksum;
+  broken_ = false;
+  response->append(":" + std::to_string(offset) + "\r\n");
+}
+
+// dbsyncdata <offset> <crc32> <data>, not replied, a bad chunk breaks the file
+void PikaDBSyncReceiverConn::DataCmd(const pink::RedisCmdArgsType& argv) {
+  if (file_ == NULL || broken_) {
+    return;
+  }
+  int64_t offset = 0, crc = 0;
+  if (argv.size() != 4
+      || !slash::string2l(argv[1].data(), argv[1].size(), &offset)
+      || !slash::string2l(argv[2].data(), argv[2].size(), &crc)
+      || static_cast<uint64_t>(offset) != offset_
+      || offset_ + argv[3].size() > size_
+      || PikaCommonFunc::CRC32Update(0, argv[3].data(), argv[3].size()) != static_cast<uint32_t>(crc)) {
+    LOG(WARNING) << "DBSync bad chunk of " << path_ << " at " << offset_;
+    broken_ = true;
+    return;
+  }
+  slash::Status s = file_->Write(offset_, slash::Slice(argv[3]));
+  if (!s.ok()) {
+    LOG(WARNING) << "DBSync write " << path_ << " failed, " << s.ToString();
+    broken_ = true;
+    return;
+  }
+  offset_ += argv[3].size();
+  checksum_ = PikaCommonFunc::CRC32Update(checksum_, argv[3].data(), argv[3].size());
+}
+
+// dbsyncdone <checksum>, the file is taken if all of it arrived good and
+// the checksum of the whole file agrees
+void PikaDBSyncReceiverConn::DoneCmd(const pink::RedisCmdArgsType& argv,
+                                     std::string* response) {
+  int64_t checksum = 0;
+  if (file_ == NULL) {
+    response->append("-ERR no file\r\n");
+    return;
+  }
+  if (argv.size() != 2
+      || !slash::string2l(argv[1].data(), argv[1].size(), &checksum)) {
+    CloseFile();
+    response->append("-ERR invalid dbsyncdone\r\n");
+    return;
+  }
+
+  std::string tmp_path = path_ + kDBSyncTmpSuffix;
+  slash::Status s;
+  if (broken_ || offset_ != size_) {
+    s = slash::Status::Corruption("broken");
+  } else if (checksum_ != static_cast<uint32_t>(checksum)) {
+    s = slash::Status::Corruption("checksum mismatch");
+  } else {
+    s = file_->Sync();
+  }
+  std::string path = path_;
+  CloseFile();
+  if (s.ok() && slash::RenameFile(tmp_path, path) != 0) {
+    s = slash::Status::IOError("rename", strerror(errno));
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << "DBSync receive " << path << " failed, " << s.ToString();
+    slash::DeleteFile(tmp_path);
+    response->append("-ERR " + s.ToString() + "\r\n");
+    return;
+  }
+  response->append("+OK\r\n");
+}
+
+/*
+ * dbsyncmanifest <module> [<path> <size>]..., the sst and blob files of the
+ * bgsave. Reply those the slave has a file of the same size for, in
+ * db-sync-path from an earlier sync or in its own db, the master then
+ * offers them to dbsynclink instead of sending them
+ */
+void PikaDBSyncReceiverConn::ManifestCmd(const pink::RedisCmdArgsType& argv,
+                                         std::string* response) {
+  if (argv.size() < 2 || argv.size() % 2 != 0 || !CheckModule(argv[1])) {
+    response->append("-ERR invalid dbsyncmanifest\r\n");
+    return;
+  }
+  std::string sync_path = g_pika_conf->db_sync_path();
+  std::string db_path = PikaCommonFunc::AppendSubDirectory(g_pika_conf->db_path(), "");
+  std::vector<const std::string*> found;
+  for (size_t i = 2; i < argv.size(); i += 2) {
+    const std::string& path = argv[i];
+    int64_t size = 0;
+    uint64_t mine = 0;
+    if (!IsSafePath(path)
+        || !slash::string2l(argv[i + 1].data(), argv[i + 1].size(), &size)) {
+      continue;
+    }
+    if ((FileSize(sync_path + path, &mine) && mine == static_cast<uint64_t>(size))
+        || (FileSize(db_path + path, &mine) && mine == static_cast<uint64_t>(size))) {
+      found.push_back(&path);
+    }
+  }
+  pink::AppendRedisLen(response, found.size(), '*');
+  for (auto path : found) {
+    pink::AppendRedisLen(response, path->size(), '$');
+    response->append(*path);
+    response->append("\r\n");
+  }
+  LOG(INFO) << "DBSync manifest of " << (argv.size() - 2) / 2 << " files, "
+    << found.size() << " may be reused";
+}
+
+/*
+ * dbsynclink <module> <path> <size> <checksum>, take the file in
+ * db-sync-path if it is the same, or hard link it from the db.
+ * Reply -ERR if neither is, the master sends it then
+ */
+void PikaDBSyncReceiverConn::LinkCmd(const pink::RedisCmdArgsType& argv,
+                                     std::string* response) {
+  CloseFile();
+  int64_t size = 0, checksum = 0;
+  if (argv.size() != 5 || !CheckModule(argv[1]) || !IsSafePath(argv[2])
+      || !PikaCommonFunc::IsImmutableDBFile(argv[2])
+      || !slash::string2l(argv[3].data(), argv[3].size(), &size)
+      || !slash::string2l(argv[4].data(), argv[4].size(), &checksum)) {
+    response->append("-ERR invalid dbsynclink\r\n");
+    return;
+  }
+
+  std::string path = g_pika_conf->db_sync_path() + argv[2];
+  uint64_t mine = 0;
+  uint32_t crc = 0;
+  if (FileSize(path, &mine) && mine == static_cast<uint64_t>(size)
+      && PikaCommonFunc::FileChecksum(path, &crc) && crc == static_cast<uint32_t>(checksum)) {
+    response->append("+OK\r\n");
+    return;
+  }
+  slash::DeleteFile(path);
+
+  // The db may compact the file away any time, the link keeps it
+  std::string src = PikaCommonFunc::AppendSubDirectory(g_pika_conf->db_path(), argv[2]);
+  slash::CreatePath(path.substr(0, path.rfind('/')));
+  if (link(src.c_str(), path.c_str()) != 0) {
+    response->append("-ERR link " + std::string(strerror(errno)) + "\r\n");
+    return;
+  }
+  if (!FileSize(path, &mine) || mine != static_cast<uint64_t>(size)
+      || !PikaCommonFunc::FileChecksum(path, &crc) || crc != static_cast<uint32_t>(checksum)) {
+    slash::DeleteFile(path);
+    response->append("-ERR differ\r\n");
+    return;
+  }
+  response->append("+OK\r\n");
+}
+
+// dbsyncclear <module> <path>..., delete what the master does not have
+void PikaDBSyncReceiverConn::ClearCmd(const pink::RedisCmdArgsType& argv,
+                                      std::string* response) {
+  if (argv.size() < 2 || !CheckModule(argv[1])) {
+    response->append("-ERR invalid dbsyncclear\r\n");
+    return;
+  }
+  std::set<std::string> keep(argv.begin() + 2, argv.end());
+  ClearDir(g_pika_conf->db_sync_path(), "", keep);
+  response->append("+OK\r\n");
+}
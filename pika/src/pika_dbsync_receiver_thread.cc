@@ -0,0 +1,41 @@
+// Copyright (c) 2018-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+#include <glog/logging.h>
+
+#include "pika_dbsync_receiver_thread.h"
+#include "pika_server.h"
+
+extern PikaServer* g_pika_server;
+
+PikaDBSyncReceiverThread::PikaDBSyncReceiverThread(const std::set<std::string> &ips,
+                                                   int port, int work_num) {
+  thread_rep_ = pink::NewDispatchThread(ips, port, work_num, &conn_factory_,
+                                        1000, 1000, &handles_);
+  thread_rep_->set_thread_name("DBSyncReceiver");
+  thread_rep_->set_keepalive_timeout(kDBSyncIdleTimeout * 2);
+}
+
+PikaDBSyncReceiverThread::~PikaDBSyncReceiverThread() {
+  thread_rep_->StopThread();
+  LOG(INFO) << "DBSyncReceiver thread " << thread_rep_->thread_id() << " exit!!!";
+  delete thread_rep_;
+}
+
+int PikaDBSyncReceiverThread::StartThread() {
+  return thread_rep_->StartThread();
+}
+
+// Only the master, the module in the commands tells which master it is
+bool PikaDBSyncReceiverThread::Handles::AccessHandle(std::string& ip) const {
+  if (ip == "127.0.0.1") {
+    ip = g_pika_server->host();
+  }
+  if (ip != g_pika_server->master_ip()) {
+    LOG(WARNING) << "DBSyncReceiver deny connection: " << ip;
+    return false;
+  }
+  return true;
+}
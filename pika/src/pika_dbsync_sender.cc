@@ -0,0 +1,405 @@
+// Copyright (c) 2018-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+#include "pika_dbsync_sender.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <set>
+
+#include <glog/logging.h>
+
+#include "slash/include/env.h"
+#include "slash/include/slash_string.h"
+#include "pink/include/redis_cli.h"
+#include "pika_commonfunc.h"
+#include "pika_conf.h"
+#include "pika_define.h"
+
+extern PikaConf* g_pika_conf;
+
+PikaDBSyncSender::PikaDBSyncSender(const std::string& ip, int port,
+                                   const std::string& bg_path,
+                                   const std::string& module)
+    : ip_(ip),
+      port_(port),
+      bg_path_(bg_path),
+      module_(module),
+      next_file_(0),
+      failed_(false),
+      reused_num_(0),
+      reused_bytes_(0),
+      tokens_(0),
+      last_refill_us_(slash::NowMicros()) {
+}
+
+PikaDBSyncSender::~PikaDBSyncSender() {
+}
+
+bool PikaDBSyncSender::ListFiles(const std::string& dir, const std::string& prefix) {
+  std::vector<std::string> children;
+  int ret = slash::GetChildren(dir, children);
+  if (ret != 0) {
+    LOG(WARNING) << "Get children of " << dir << " failed, error: " << strerror(ret);
+    return false;
+  }
+  for (const auto& child : children) {
+    std::string path = dir + "/" + child;
+    std::string name = prefix + child;
+    if (slash::IsDir(path) == 0) {
+      if (!ListFiles(path, name + "/")) {
+        return false;
+      }
+      continue;
+    }
+    if (name == kBgsaveInfoFile) {
+      continue;
+    }
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+      LOG(WARNING) << "Stat " << path << " failed, error: " << strerror(errno);
+      return false;
+    }
+    files_.push_back(File(name, st.st_size));
+  }
+  return true;
+}
+
+int PikaDBSyncSender::Send() {
+  LOG(INFO) << "Start Send files in " << bg_path_ << " to " << ip_ << ":" << port_;
+  if (!ListFiles(bg_path_, "")) {
+    return -1;
+  }
+  std::sort(files_.begin(), files_.end(), [](const File& a, const File& b) {
+    return a.size > b.size;
+  });
+  ExchangeManifest();
+
+  int worker_num = std::min(static_cast<int>(files_.size()),
+                            g_pika_conf->db_sync_parallel());
+  std::vector<Worker*> workers;
+  for (int i = 0; i < worker_num; i++) {
+    workers.push_back(new Worker(this));
+    workers.back()->StartThread();
+  }
+  for (auto worker : workers) {
+    worker->JoinThread();
+    delete worker;
+  }
+  if (failed_) {
+    return -1;
+  }
+  LOG(INFO) << "db sync reused " << reused_num_ << " of " << files_.size()
+    << " files, " << reused_bytes_ << " bytes, on " << ip_ << ":" << port_;
+
+  // Clear what is not in the bgsave, then send the info file at last,
+  // the slave takes the db once it gets the info file
+  Worker last(this);
+  pink::RedisCmdArgsType argv;
+  std::string reply;
+  argv.push_back("dbsyncclear");
+  argv.push_back(module_);
+  for (const auto& file : files_) {
+    argv.push_back(file.path);
+  }
+  Status s = last.Connect();
+  if (s.ok()) {
+    s = last.Request(argv, &reply);
+  }
+  if (s.ok() && slash::StringToLower(reply) != kInnerReplOk) {
+    s = Status::Corruption("dbsyncclear: " + reply);
+  }
+  if (s.ok()) {
+    struct stat st;
+    std::string info_path = bg_path_ + "/" + kBgsaveInfoFile;
+    if (stat(info_path.c_str(), &st) != 0) {
+      s = Status::IOError("stat info file", strerror(errno));
+    } else {
+      s = last.SendFile(kBgsaveInfoFile, st.st_size);
+    }
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << "send info file failed, " << s.ToString();
+    return -1;
+  }
+  return 0;
+}
+
+// Mark the files the slave may have, without them all files are sent.
+// The slave refuses until it gets the trysync reply, so try some times
+void PikaDBSyncSender::ExchangeManifest() {
+  pink::RedisCmdArgsType manifest;
+  manifest.push_back("dbsyncmanifest");
+  manifest.push_back(module_);
+  for (const auto& file : files_) {
+    if (PikaCommonFunc::IsImmutableDBFile(file.path)) {
+      manifest.push_back(file.path);
+      manifest.push_back(std::to_string(file.size));
+    }
+  }
+
+  Worker first(this);
+  pink::RedisCmdArgsType argv;
+  std::string reply;
+  Status s;
+  for (int i = 0; i < kDBSyncMaxRetry; i++) {
+    if (i > 0) {
+      sleep(1);
+    }
+    argv = manifest;
+    s = first.Connect();
+    if (s.ok()) {
+      s = first.Request(argv, &reply);
+    }
+    if (s.ok() && reply.compare(0, 4, "ERR ") == 0) {
+      s = Status::Corruption("dbsyncmanifest: " + reply);
+    }
+    if (s.ok()) {
+      break;
+    }
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << "db sync manifest failed, send all files, " << s.ToString();
+    return;
+  }
+  std::set<std::string> found(argv.begin(), argv.end());
+  for (auto& file : files_) {
+    file.reusable = found.find(file.path) != found.end();
+  }
+}
+
+bool PikaDBSyncSender::NextFile(File* file) {
+  slash::MutexLock l(&files_mutex_);
+  if (failed_ || next_file_ >= files_.size()) {
+    return false;
+  }
+  *file = files_[next_file_++];
+  return true;
+}
+
+void PikaDBSyncSender::FileFailed(const File& file) {
+  slash::MutexLock l(&files_mutex_);
+  LOG(WARNING) << "db sync send file failed! From: " << bg_path_ << "/" << file.path
+    << ", At: " << ip_ << ":" << port_;
+  failed_ = true;
+}
+
+void PikaDBSyncSender::FileReused(const File& file) {
+  slash::MutexLock l(&files_mutex_);
+  reused_num_++;
+  reused_bytes_ += file.size;
+}
+
+/*
+ * Token bucket of db-sync-speed(MB) shared by all workers, it may go into
+ * debt by one chunk, the worker sleeps the debt off. 0 is no limit
+ */
+void PikaDBSyncSender::Throttle(size_t bytes) {
+  int64_t speed = static_cast<int64_t>(g_pika_conf->db_sync_speed()) * 1024 * 1024;
+  if (speed <= 0) {
+    return;
+  }
+  uint64_t wait_us = 0;
+  {
+    slash::MutexLock l(&bucket_mutex_);
+    uint64_t now = slash::NowMicros();
+    tokens_ += speed * static_cast<int64_t>(now - last_refill_us_) / 1000000;
+    if (tokens_ > speed) {
+      tokens_ = speed;
+    }
+    last_refill_us_ = now;
+    tokens_ -= bytes;
+    if (tokens_ < 0) {
+      wait_us = -tokens_ * 1000000 / speed;
+    }
+  }
+  if (wait_us > 0) {
+    usleep(wait_us);
+  }
+}
+
+PikaDBSyncSender::Worker::Worker(PikaDBSyncSender* sender)
+    : sender_(sender),
+      cli_(pink::NewRedisCli()),
+      scratch_(new char[kDBSyncChunkSize]) {
+  set_thread_name("DBSyncSender");
+}
+
+PikaDBSyncSender::Worker::~Worker() {
+  delete cli_;
+  delete[] scratch_;
+}
+
+Status PikaDBSyncSender::Worker::Connect() {
+  cli_->Close();
+  Status s = cli_->Connect(sender_->ip_, sender_->port_, "");
+  if (s.ok()) {
+    cli_->set_send_timeout(kDBSyncIdleTimeout * 1000);
+    cli_->set_recv_timeout(kDBSyncIdleTimeout * 1000);
+  }
+  return s;
+}
+
+Status PikaDBSyncSender::Worker::Request(pink::RedisCmdArgsType& argv,
+                                         std::string* reply) {
+  wbuf_.clear();
+  pink::SerializeRedisCommand(argv, &wbuf_);
+  Status s = cli_->Send(&wbuf_);
+  if (!s.ok()) {
+    return s;
+  }
+  argv.clear();
+  s = cli_->Recv(&argv);
+  if (!s.ok()) {
+    return s;
+  }
+  // An empty array leaves argv empty
+  reply->assign(argv.empty() ? "" : argv[0]);
+  return s;
+}
+
+Status PikaDBSyncSender::Worker::SendFile(const std::string& path, uint64_t size) {
+  pink::RedisCmdArgsType argv;
+  std::string reply;
+  argv.push_back("dbsyncfile");
+  argv.push_back(sender_->module_);
+  argv.push_back(path);
+  argv.push_back(std::to_string(size));
+  Status s = Request(argv, &reply);
+  if (!s.ok()) {
+    return s;
+  }
+  // The slave has the bytes before offset already
+  int64_t offset = 0;
+  if (!slash::string2l(reply.data(), reply.size(), &offset)
+      || offset < 0 || static_cast<uint64_t>(offset) > size) {
+    return Status::Corruption("dbsyncfile: " + reply);
+  }
+
+  // The checksum of the whole file, the part the slave has is read for
+  // it but not sent
+  uint32_t checksum = 0;
+  {
+    slash::SequentialFile* reader = NULL;
+    s = slash::NewSequentialFile(sender_->bg_path_ + "/" + path, &reader);
+    if (!s.ok()) {
+      return s;
+    }
+    slash::Slice chunk;
+    uint64_t skipped = 0;
+    while (s.ok() && skipped < static_cast<uint64_t>(offset)) {
+      size_t n = std::min(static_cast<uint64_t>(kDBSyncChunkSize), offset - skipped);
+      s = reader->Read(n, &chunk, scratch_);
+      if (s.ok() && chunk.size() == 0) {
+        s = Status::IOError(path, "file shrinked");
+      }
+      if (s.ok()) {
+        checksum = PikaCommonFunc::CRC32Update(checksum, chunk.data(), chunk.size());
+        skipped += chunk.size();
+      }
+    }
+    while (s.ok() && static_cast<uint64_t>(offset) < size) {
+      size_t n = std::min(static_cast<uint64_t>(kDBSyncChunkSize), size - offset);
+      s = reader->Read(n, &chunk, scratch_);
+      if (s.ok() && chunk.size() == 0) {
+        s = Status::IOError(path, "file shrinked");
+      }
+      if (!s.ok()) {
+        break;
+      }
+      sender_->Throttle(chunk.size());
+      uint32_t crc = PikaCommonFunc::CRC32Update(0, chunk.data(), chunk.size());
+      checksum = PikaCommonFunc::CRC32Update(checksum, chunk.data(), chunk.size());
+      argv.clear();
+      argv.push_back("dbsyncdata");
+      argv.push_back(std::to_string(offset));
+      argv.push_back(std::to_string(crc));
+      argv.push_back(chunk.ToString());
+      wbuf_.clear();
+      pink::SerializeRedisCommand(std::move(argv), &wbuf_);
+      s = cli_->Send(&wbuf_);
+      offset += chunk.size();
+    }
+    delete reader;
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  argv.clear();
+  argv.push_back("dbsyncdone");
+  argv.push_back(std::to_string(checksum));
+  s = Request(argv, &reply);
+  if (s.ok() && slash::StringToLower(reply) != kInnerReplOk) {
+    s = Status::Corruption("dbsyncdone: " + reply);
+  }
+  return s;
+}
+
+// Ask the slave to take its own copy of the file, *linked is false if it
+// has none
+Status PikaDBSyncSender::Worker::LinkFile(const std::string& path, uint64_t size,
+                                         bool* linked) {
+  uint32_t checksum = 0;
+  if (!PikaCommonFunc::FileChecksum(sender_->bg_path_ + "/" + path, &checksum)) {
+    return Status::IOError(path, "checksum failed");
+  }
+  pink::RedisCmdArgsType argv;
+  std::string reply;
+  argv.push_back("dbsynclink");
+  argv.push_back(sender_->module_);
+  argv.push_back(path);
+  argv.push_back(std::to_string(size));
+  argv.push_back(std::to_string(checksum));
+  Status s = Request(argv, &reply);
+  if (s.ok()) {
+    *linked = slash::StringToLower(reply) == kInnerReplOk;
+  }
+  return s;
+}
+
+// Take files until none left, a file is tried kDBSyncMaxRetry times on a
+// new connection each, the slave resumes it where it stopped
+void* PikaDBSyncSender::Worker::ThreadMain() {
+  File file("", 0);
+  bool connected = false;
+  while (sender_->NextFile(&file)) {
+    Status s;
+    for (int i = 0; i < kDBSyncMaxRetry; i++) {
+      if (!connected) {
+        s = Connect();
+        connected = s.ok();
+      }
+      if (connected) {
+        bool linked = false;
+        if (file.reusable) {
+          s = LinkFile(file.path, file.size, &linked);
+        }
+        if (s.ok() && linked) {
+          sender_->FileReused(file);
+          break;
+        }
+        if (s.ok()) {
+          s = SendFile(file.path, file.size);
+        }
+        if (s.ok()) {
+          break;
+        }
+        connected = false;
+      }
+      LOG(WARNING) << "db sync send " << file.path << " failed, " << s.ToString()
+        << ", tried " << i + 1 << " times";
+      sleep(1);
+    }
+    if (!s.ok()) {
+      sender_->FileFailed(file);
+      break;
+    }
+  }
+  cli_->Close();
+  return NULL;
+}
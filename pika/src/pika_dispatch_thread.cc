@@ -14,10 +14,14 @@ extern PikaConf* g_pika_conf;
 
 PikaDispatchThread::PikaDispatchThread(std::set<std::string> &ips, int port, int work_num,
                                        int cron_interval, int queue_limit)
-      : handles_(this) {
+      : handles_(this),
+        last_accept_time_us_(slash::NowMicros()) {
   thread_rep_ = pink::NewDispatchThread(ips, port, work_num, &conn_factory_,
                                         cron_interval, queue_limit, &handles_);
   thread_rep_->set_thread_name("Dispatcher");
+  thread_rep_->set_reuse_port(g_pika_conf->reuse_port());
+  last_accept_nums_.assign(work_num, 0);
+  last_sec_accept_nums_.assign(work_num, 0);
 }
 
 PikaDispatchThread::~PikaDispatchThread() {
@@ -39,13 +43,31 @@ int64_t PikaDispatchThread::ThreadClientList(std::vector<ClientInfo> *clients) {
                           info.fd,
                           info.ip_port,
                           info.last_interaction.tv_sec,
-                          nullptr /* PinkConn pointer, doesn't need here */
+                          nullptr, /* PinkConn pointer, doesn't need here */
+                          info.pending_reply_len
                          });
     }
   }
   return conns_info.size();
 }
 
+void PikaDispatchThread::WorkerAcceptRates(std::vector<uint64_t> *rates) {
+  slash::MutexLock l(&accept_stat_mu_);
+  *rates = last_sec_accept_nums_;
+}
+
+void PikaDispatchThread::ResetLastSecAcceptnum() {
+  std::vector<uint64_t> accept_nums = thread_rep_->accept_nums();
+  uint64_t cur_time_us = slash::NowMicros();
+  slash::MutexLock l(&accept_stat_mu_);
+  for (size_t i = 0; i < accept_nums.size() && i < last_accept_nums_.size(); i++) {
+    last_sec_accept_nums_[i] = (accept_nums[i] - last_accept_nums_[i])
+      * 1000000 / (cur_time_us - last_accept_time_us_ + 1);
+    last_accept_nums_[i] = accept_nums[i];
+  }
+  last_accept_time_us_ = cur_time_us;
+}
+
 bool PikaDispatchThread::ClientKill(const std::string& ip_port) {
   return thread_rep_->KillConn(ip_port);
 }
@@ -74,6 +96,7 @@ bool PikaDispatchThread::Handles::AccessHandle(std::string& ip) const {
 void PikaDispatchThread::Handles::CronHandle() const {
   pika_disptcher_->thread_rep_->set_keepalive_timeout(g_pika_conf->timeout());
   g_pika_server->ResetLastSecQuerynum();
+  pika_disptcher_->ResetLastSecAcceptnum();
 }
 
 int PikaDispatchThread::Handles::CreateWorkerSpecificData(void** data) const {
@@ -22,7 +22,12 @@ void PikaHeartbeatConn::SyncProcessRedisCmd(const pink::RedisCmdArgsType& argv,
 int PikaHeartbeatConn::DealMessage(const PikaCmdArgsType& argv,
                                    std::string* response) {
   if (argv[0] == "ping") {
-    response->append("+PONG\r\n");
+    // Not pong, the slave drops the links to me and trysyncs again
+    if (g_pika_server->SlaveNeedResync(fd())) {
+      response->append("-ERR binlog resync\r\n");
+    } else {
+      response->append("+PONG\r\n");
+    }
   } else if (argv[0] == "spci") {
     int64_t sid = -1;
     slash::string2l(argv[1].data(), argv[1].size(), &sid);
@@ -467,6 +467,7 @@ void
 PikaParseSendThread::DelKeysAndWriteBinlog(std::deque<std::pair<const char, std::string>> &send_keys)
 {
     for (auto iter = send_keys.begin(); iter != send_keys.end(); ++iter) {
+        BinlogFenceReadLock fence(g_pika_server);
         KeyDelete(iter->first, iter->second);
         WriteDelKeyToBinlog(iter->second);
     }
@@ -17,7 +17,9 @@ extern PikaConf* g_pika_conf;
 
 PikaMonitorThread::PikaMonitorThread()
   : pink::Thread(),
-    monitor_cond_(&monitor_mutex_protector_) {
+    monitor_cond_(&monitor_mutex_protector_),
+    monitor_messages_len_(0),
+    soft_limit_since_(0) {
   set_thread_name("MonitorThread");
 }
 
@@ -38,7 +40,7 @@ PikaMonitorThread::~PikaMonitorThread() {
 void PikaMonitorThread::AddMonitorClient(std::shared_ptr<PikaClientConn> client_ptr) {
   StartThread();
   slash::MutexLock lm(&monitor_mutex_protector_);
-  monitor_clients_.push_back(ClientInfo{client_ptr->fd(), client_ptr->ip_port(), 0, client_ptr});
+  monitor_clients_.push_back(ClientInfo{client_ptr->fd(), client_ptr->ip_port(), 0, client_ptr, 0});
 }
 
 void PikaMonitorThread::RemoveMonitorClient(const std::string& ip_port) {
@@ -62,20 +64,47 @@ void PikaMonitorThread::RemoveMonitorClient(const std::string& ip_port) {
 
 void PikaMonitorThread::AddMonitorMessage(const std::string &monitor_message) {
     slash::MutexLock lm(&monitor_mutex_protector_);
-    if (monitor_messages_.empty() && cron_tasks_.empty()) {
-      monitor_messages_.push_back(monitor_message);
+    bool idle = monitor_messages_.empty() && cron_tasks_.empty();
+    monitor_messages_.push_back(monitor_message);
+    monitor_messages_len_ += monitor_message.size();
+    if (OutputBufferOverLimit()) {
+      LOG(WARNING) << "Monitor messages " << monitor_messages_len_
+                   << " bytes over client-output-buffer-limit, close all the monitor clients";
+      monitor_messages_.clear();
+      monitor_messages_len_ = 0;
+      soft_limit_since_ = 0;
+      cron_tasks_.push({TASK_KILLALL, "all"});
+    }
+    if (idle) {
       monitor_cond_.Signal();
-    } else {
-      monitor_messages_.push_back(monitor_message);
     }
 }
 
+// Messages pile up when the monitor clients read slower than commands come
+bool PikaMonitorThread::OutputBufferOverLimit() {
+  pink::OutputBufferLimit limit = pink::GetOutputBufferLimit(pink::kOutputBufferMonitor);
+  if (limit.hard_limit > 0 && monitor_messages_len_ >= limit.hard_limit) {
+    return true;
+  }
+  if (limit.soft_limit == 0 || monitor_messages_len_ < limit.soft_limit) {
+    soft_limit_since_ = 0;
+    return false;
+  }
+  time_t now = time(NULL);
+  if (soft_limit_since_ == 0) {
+    soft_limit_since_ = now;
+  }
+  return now - soft_limit_since_ >= limit.soft_seconds;
+}
+
 int32_t PikaMonitorThread::ThreadClientList(std::vector<ClientInfo>* clients_ptr) {
+  slash::MutexLock lm(&monitor_mutex_protector_);
   if (clients_ptr != NULL) {
     for (std::list<ClientInfo>::iterator iter = monitor_clients_.begin();
         iter != monitor_clients_.end();
         iter++) {
       clients_ptr->push_back(*iter);
+      clients_ptr->back().pending_reply_len = monitor_messages_len_;
     }
   }
   return monitor_clients_.size();
@@ -176,6 +205,7 @@ void* PikaMonitorThread::ThreadMain() {
     {
       slash::MutexLock lm(&monitor_mutex_protector_);
       messages_deque.swap(monitor_messages_);
+      monitor_messages_len_ = 0;
       if (monitor_clients_.empty() || messages_deque.empty()) {
         continue;
       }
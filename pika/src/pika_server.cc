@@ -12,6 +12,7 @@
 #include <string.h>
 #include <arpa/inet.h>
 #include <sstream>
+#include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <ctime>
@@ -20,10 +21,12 @@
 #include "slash/include/rsync.h"
 #include "slash/include/slash_string.h"
 #include "pink/include/bg_thread.h"
+#include "pink/include/redis_cli.h"
 #include "pika_server.h"
 #include "pika_conf.h"
 #include "pika_slot.h"
 #include "pika_dispatch_thread.h"
+#include "pika_dbsync_sender.h"
 #include "pika_commonfunc.h"
 
 #define BASE_CRON_TIME_US       100000
@@ -34,6 +37,27 @@ static long long cron_loops = 0 ;
 extern PikaServer *g_pika_server;
 extern PikaConf *g_pika_conf;
 
+// Binlog sender of the slave for the shard, NULL before it is created
+static PikaBinlogSenderThread* SlaveSender(const SlaveItem& slave, int shard) {
+    if (slave.sender == NULL) {
+        return NULL;
+    }
+    void* sender = shard == 0 ? slave.sender : slave.shard_senders[shard - 1];
+    return static_cast<PikaBinlogSenderThread*>(sender);
+}
+
+// Move the binlog senders out of the slave, so they could be deleted out of slave_mutex_
+static void TakeSlaveSenders(SlaveItem* slave, std::vector<PikaBinlogSenderThread*>* senders) {
+    if (slave->sender != NULL) {
+        senders->push_back(static_cast<PikaBinlogSenderThread*>(slave->sender));
+    }
+    for (size_t i = 0; i < slave->shard_senders.size(); i++) {
+        senders->push_back(static_cast<PikaBinlogSenderThread*>(slave->shard_senders[i]));
+    }
+    slave->sender = NULL;
+    slave->shard_senders.clear();
+}
+
 PikaServer::PikaServer() :
     ping_thread_(NULL),
     db_size_(0),
@@ -50,6 +74,7 @@ PikaServer::PikaServer() :
     have_scheduled_crontask_(false),
     last_check_compact_time_({0, 0}),
     disable_auto_compactions_is_change_(false),
+    cmd_cost_stats_(GetCmdNum()),
     sid_(0),
     master_ip_(""),
     master_connection_(0),
@@ -58,16 +83,12 @@ PikaServer::PikaServer() :
     repl_state_(PIKA_REPL_NO_CONNECT),
     role_(PIKA_ROLE_SINGLE),
     force_full_sync_(false),
+    db_sync_touch_time_(0),
     bgsave_engine_(NULL),
     purging_(false),
-    binlogbg_exit_(false),
-    binlogbg_cond_(&binlogbg_mutex_),
-    binlogbg_serial_(0) {
-
-    pthread_rwlockattr_t attr;
-    pthread_rwlockattr_init(&attr);
-    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
-    pthread_rwlock_init(&rwlock_, &attr);
+    binlog_fence_seq_(slash::NowMicros()),
+    binlogbg_pending_(0),
+    binlog_resync_(false) {
 
     //Init server ip host
     if (!ServerInit()) {
@@ -97,12 +118,17 @@ PikaServer::PikaServer() :
         ips.insert("127.0.0.1");
         ips.insert(host_);
     }
+    ApplyClientOutputBufferLimit();
+
     // We estimate the queue size
     int worker_queue_limit = g_pika_conf->maxclients() / worker_num_ + 100;
     LOG(INFO) << "Worker queue limit is " << worker_queue_limit;
     pika_dispatch_thread_ = new PikaDispatchThread(ips, port_, worker_num_, 3000, worker_queue_limit);
     pika_binlog_receiver_thread_ = new PikaBinlogReceiverThread(ips, port_ + 1000, 1000);
     pika_heartbeat_thread_ = new PikaHeartbeatThread(ips, port_ + 2000, 1000);
+    // The rsync daemon takes port+3000 while a full sync by rsync goes
+    pika_dbsync_receiver_thread_ = g_pika_conf->db_sync_rsync() ? NULL :
+        new PikaDBSyncReceiverThread(ips, port_ + 3000, g_pika_conf->db_sync_parallel());
     pika_trysync_thread_ = new PikaTrysyncThread();
     pika_pubsub_thread_ = new pink::PubSubThread();
     pika_thread_pools_[THREADPOOL_FAST] = new pink::ThreadPool(g_pika_conf->fast_thread_pool_size(), THREADPOOL_QUEUE_MAX, "pika:fast");
@@ -137,6 +163,11 @@ PikaServer::PikaServer() :
 
     pthread_rwlock_init(&state_protector_, NULL);
     logger_ = new Binlog(g_pika_conf->binlog_path(), g_pika_conf->binlog_file_size());
+    loggers_.push_back(logger_);
+    for (int i = 1; i < g_pika_conf->binlog_shard_num(); i++) {
+        loggers_.push_back(new Binlog(BinlogShardPath(i), g_pika_conf->binlog_file_size()));
+    }
+    UpdateBinlogCompression();
 }
 
 PikaServer::~PikaServer() {
@@ -152,8 +183,10 @@ PikaServer::~PikaServer() {
     slash::MutexLock l(&slave_mutex_);
     std::vector<SlaveItem>::iterator iter = slaves_.begin();
     while (iter != slaves_.end()) {
-        if (iter->sender != NULL) {
-            delete static_cast<PikaBinlogSenderThread*>(iter->sender);
+        std::vector<PikaBinlogSenderThread*> senders;
+        TakeSlaveSenders(&(*iter), &senders);
+        for (size_t i = 0; i < senders.size(); i++) {
+            delete senders[i];
         }
         iter =  slaves_.erase(iter);
         LOG(INFO) << "Delete slave success";
@@ -163,12 +196,11 @@ PikaServer::~PikaServer() {
     delete pika_trysync_thread_;
     delete ping_thread_;
     delete pika_binlog_receiver_thread_;
+    delete pika_dbsync_receiver_thread_;
     delete pika_pubsub_thread_;
 
-    binlogbg_exit_ = true;
     std::vector<BinlogBGWorker*>::iterator binlogbg_iter = binlogbg_workers_.begin();
     while (binlogbg_iter != binlogbg_workers_.end()) {
-        binlogbg_cond_.SignalAll();
         delete (*binlogbg_iter);
         binlogbg_iter++;
     }
@@ -189,10 +221,11 @@ PikaServer::~PikaServer() {
         delete binlog_write_thread_[i];
     }
     delete[] binlog_write_thread_;
-    delete logger_;
+    for (size_t i = 0; i < loggers_.size(); i++) {
+        delete loggers_[i];
+    }
     db_.reset();
     pthread_rwlock_destroy(&state_protector_);
-    pthread_rwlock_destroy(&rwlock_);
 
     LOG(INFO) << "PikaServer " << pthread_self() << " exit!!!";
 }
@@ -380,6 +413,14 @@ void PikaServer::Start() {
         db_.reset();
         LOG(FATAL) << "Start Heartbeat Error: " << ret << (ret == pink::kBindError ? ": bind port conflict" : ": other error");
     }
+    if (pika_dbsync_receiver_thread_ != NULL) {
+        ret = pika_dbsync_receiver_thread_->StartThread();
+        if (ret != pink::kSuccess) {
+            delete logger_;
+            db_.reset();
+            LOG(FATAL) << "Start DBSyncReceiver Error: " << ret << (ret == pink::kBindError ? ": bind port conflict" : ": other error");
+        }
+    }
     ret = pika_trysync_thread_->StartThread();
     if (ret != pink::kSuccess) {
         delete logger_;
@@ -470,7 +511,7 @@ void PikaServer::Start() {
 void PikaServer::DeleteSlave(const std::string& ip, int64_t port) {
     std::string ip_port = slash::IpPortString(ip, port);
     int slave_num = 0;
-    PikaBinlogSenderThread *sender = NULL;
+    std::vector<PikaBinlogSenderThread*> senders;
 
     {
     slash::MutexLock l(&slave_mutex_);
@@ -484,16 +525,14 @@ void PikaServer::DeleteSlave(const std::string& ip, int64_t port) {
     if (iter == slaves_.end()) {
         return;
     }
-    if (iter->sender != NULL) {
-        sender = static_cast<PikaBinlogSenderThread*>(iter->sender);
-    }
+    TakeSlaveSenders(&(*iter), &senders);
     slaves_.erase(iter);
     slave_num = slaves_.size();
     }
 
     // 把耗时操作放在锁外面
-    if (sender != NULL) {
-        delete sender;
+    for (size_t i = 0; i < senders.size(); i++) {
+        delete senders[i];
     }
 
     slash::RWLock l(&state_protector_, true);
@@ -504,7 +543,7 @@ void PikaServer::DeleteSlave(const std::string& ip, int64_t port) {
 
 void PikaServer::DeleteSlave(int fd) {
     int slave_num = 0;
-    PikaBinlogSenderThread *sender = NULL;
+    std::vector<PikaBinlogSenderThread*> senders;
 
     {
     slash::MutexLock l(&slave_mutex_);
@@ -512,9 +551,7 @@ void PikaServer::DeleteSlave(int fd) {
 
     while (iter != slaves_.end()) {
         if (iter->hb_fd == fd) {
-            if (iter->sender != NULL) {
-                sender = static_cast<PikaBinlogSenderThread*>(iter->sender);
-            }
+            TakeSlaveSenders(&(*iter), &senders);
             slaves_.erase(iter);
             LOG(INFO) << "Delete slave success";
             break;
@@ -525,8 +562,8 @@ void PikaServer::DeleteSlave(int fd) {
     }
 
     // 把耗时操作放在锁外面
-    if (sender != NULL) {
-        delete sender;
+    for (size_t i = 0; i < senders.size(); i++) {
+        delete senders[i];
     }
 
     slash::RWLock l(&state_protector_, true);
@@ -553,7 +590,7 @@ bool PikaServer::ChangeDb(const std::string& new_path) {
     tmp_path += "_bak";
     slash::DeleteDirIfExist(tmp_path);
 
-    RWLock l(&rwlock_, true);
+    slash::QuiesceWriteLock l(&rwlock_);
     LOG(INFO) << "Prepare change db from: " << tmp_path;
     db_.reset();
     if (0 != slash::RenameFile(db_path.c_str(), tmp_path)) {
@@ -570,6 +607,10 @@ bool PikaServer::ChangeDb(const std::string& new_path) {
     assert(db_);
     assert(s.ok());
     slash::DeleteDirIfExist(tmp_path);
+    // The cache is of the old db, clear it before reads come back
+    if (PIKA_CACHE_NONE != g_pika_conf->cache_model()) {
+        ClearCacheDbSync();
+    }
     LOG(INFO) << "Change db success";
 
     return true;
@@ -620,7 +661,7 @@ int64_t PikaServer::TryAddSlave(const std::string& ip, int64_t port) {
 
 // Set binlog sender of SlaveItem
 bool PikaServer::SetSlaveSender(const std::string& ip, int64_t port,
-        PikaBinlogSenderThread* s){
+        const std::vector<PikaBinlogSenderThread*>& senders){
     std::string ip_port = slash::IpPortString(ip, port);
 
     slash::MutexLock l(&slave_mutex_);
@@ -636,13 +677,31 @@ bool PikaServer::SetSlaveSender(const std::string& ip, int64_t port,
         return false;
     }
 
-    iter->sender = s;
-    iter->sender_tid = s->thread_id();
+    iter->sender = senders[0];
+    iter->shard_senders.assign(senders.begin() + 1, senders.end());
+    iter->sender_tid = senders[0]->thread_id();
     LOG(INFO) << "SetSlaveSender ok, tid is " << iter->sender_tid
         << " hd_fd: " << iter->hb_fd << " stage: " << iter->stage;
     return true;
 }
 
+bool PikaServer::SlaveNeedResync(int32_t hb_fd) {
+    slash::MutexLock l(&slave_mutex_);
+    for (const auto& slave : slaves_) {
+        if (slave.hb_fd != hb_fd) {
+            continue;
+        }
+        for (size_t i = 0; i < loggers_.size(); i++) {
+            PikaBinlogSenderThread* sender = SlaveSender(slave, i);
+            if (sender != NULL && sender->need_resync()) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
 int32_t PikaServer::GetSlaveListString(std::string& slave_list_str) {
     size_t index = 0;
     std::string slave_ip_port;
@@ -659,8 +718,22 @@ int32_t PikaServer::GetSlaveListString(std::string& slave_list_str) {
         tmp_stream << "slave" << index++
             << ":ip=" << slave_ip_port.substr(0, slave_ip_port.find(":"))
             << ",port=" << slave_ip_port.substr(slave_ip_port.find(":")+1)
-            << ",state=" << ((*iter).stage == SLAVE_ITEM_STAGE_TWO ? "online" : "offline")
-            << "\r\n";
+            << ",state=" << ((*iter).stage == SLAVE_ITEM_STAGE_TWO ? "online" : "offline");
+        uint64_t send_num = 0, send_records = 0, send_bytes_per_sec = 0;
+        for (int i = 0; i < binlog_shard_num(); i++) {
+            PikaBinlogSenderThread* sender = SlaveSender(*iter, i);
+            send_num += sender->send_num();
+            send_records += sender->send_records();
+            send_bytes_per_sec += sender->send_bytes_per_sec();
+            if (binlog_shard_num() > 1) {
+                // Where the sender of every binlog shard is
+                tmp_stream << ",shard" << i << "=" << sender->filenum() << ":" << sender->con_offset();
+            }
+        }
+        tmp_stream << ",records_per_send=" << std::fixed << std::setprecision(2)
+            << (send_num == 0 ? 0 : 1.0 * send_records / send_num)
+            << ",send_bytes_per_sec=" << send_bytes_per_sec;
+        tmp_stream << "\r\n";
     }
     slave_list_str.assign(tmp_stream.str());
     return index;
@@ -702,6 +775,7 @@ bool PikaServer::WaitingDBSync() {
 void PikaServer::NeedWaitDBSync() {
     slash::RWLock l(&state_protector_, true);
     repl_state_ = PIKA_REPL_WAIT_DBSYNC;
+    TouchDBSync();
 }
 
 void PikaServer::WaitDBSyncFinish() {
@@ -889,14 +963,22 @@ void PikaServer::RemoveMaster() {
 void PikaServer::TryDBSync(const std::string& ip, int port, int32_t top) {
     std::string bg_path;
     uint32_t bg_filenum = 0;
+    std::vector<BinlogOffset> bg_shard_offsets;
     {
         slash::MutexLock l(&bgsave_protector_);
         bg_path = bgsave_info_.path;
         bg_filenum = bgsave_info_.filenum;
+        bg_shard_offsets = bgsave_info_.shard_offsets;
     }
 
+    bool shards_found = bg_shard_offsets.size() + 1 == loggers_.size();
+    for (size_t i = 0; shards_found && i < bg_shard_offsets.size(); i++) {
+        shards_found = slash::FileExists(NewFileName(loggers_[i + 1]->filename,
+                    bg_shard_offsets[i].filenum));
+    }
     if (0 != slash::IsDir(bg_path) ||                               //Bgsaving dir exist
             !slash::FileExists(NewFileName(logger_->filename, bg_filenum)) ||  //filenum can be found in binglog
+            !shards_found ||                                        //so do the other shards
             top - bg_filenum > kDBSyncMaxGap) {      //The file is not too old
         // Need Bgsave first
         Bgsave();
@@ -930,46 +1012,32 @@ void PikaServer::DoDBSync(void* arg) {
     delete (PurgeArg*)arg;
 }
 
-void PikaServer::DBSyncSendFile(const std::string& ip, int port) {
-    std::string bg_path;
-    {
-        slash::MutexLock l(&bgsave_protector_);
-        bg_path = bgsave_info_.path;
-    }
-    // Get all files need to send
+// The full sync of older versions, to the rsync daemon of the slave
+static int RsyncSendFiles(const std::string& ip, int port,
+        const std::string& bg_path, const std::string& module) {
     std::vector<std::string> descendant;
-    int ret = 0;
-    LOG(INFO) << "Start Send files in " << bg_path << " to " << ip;
-    ret = slash::GetChildren(bg_path, descendant);
+    int ret = slash::GetChildren(bg_path, descendant);
     if (ret != 0) {
         LOG(WARNING) << "Get child directory when try to do sync failed, error: " << strerror(ret);
-        return;
+        return ret;
     }
 
-    // Iterate to send files
-    ret = 0;
     std::string local_path, target_path;
-    std::string module = kDBSyncModule + "_" + slash::IpPortString(host_, port_);
-    std::vector<std::string>::iterator it = descendant.begin();
     slash::RsyncRemote remote(ip, port, module, g_pika_conf->db_sync_speed() * 1024);
-    for (; it != descendant.end(); ++it) {
-        local_path = bg_path + "/" + *it;
-        target_path = *it;
-
+    for (const auto& child : descendant) {
+        local_path = bg_path + "/" + child;
+        target_path = child;
         if (target_path == kBgsaveInfoFile) {
             continue;
         }
-        
         if (slash::IsDir(local_path) == 0 && local_path.back() != '/') {
             local_path.push_back('/');
             target_path.push_back('/');
         }
-
         // We need specify the speed limit for every single file
         ret = slash::RsyncSendFile(local_path, target_path, remote);
-
         if (0 != ret) {
-            LOG(WARNING) << "rsync send file failed! From: " << *it
+            LOG(WARNING) << "rsync send file failed! From: " << child
                 << ", To: " << target_path
                 << ", At: " << ip << ":" << port
                 << ", Error: " << ret;
@@ -991,6 +1059,27 @@ void PikaServer::DBSyncSendFile(const std::string& ip, int port) {
             LOG(WARNING) << "send info file failed";
         }
     }
+    return ret;
+}
+
+void PikaServer::DBSyncSendFile(const std::string& ip, int port) {
+    std::string bg_path;
+    {
+        slash::MutexLock l(&bgsave_protector_);
+        bg_path = bgsave_info_.path;
+    }
+    if (bg_path.back() == '/') {
+        bg_path.resize(bg_path.size() - 1);
+    }
+
+    std::string module = kDBSyncModule + "_" + slash::IpPortString(host_, port_);
+    int ret = 0;
+    if (g_pika_conf->db_sync_rsync()) {
+        ret = RsyncSendFiles(ip, port, bg_path, module);
+    } else {
+        PikaDBSyncSender sender(ip, port, bg_path, module);
+        ret = sender.Send();
+    }
 
     // remove slave
     std::string ip_port = slash::IpPortString(ip, port);
@@ -999,7 +1088,7 @@ void PikaServer::DBSyncSendFile(const std::string& ip, int port) {
         db_sync_slaves_.erase(ip_port);
     }
     if (0 == ret) {
-        LOG(INFO) << "rsync send files success";
+        LOG(INFO) << "db sync send files success";
     }
 }
 
@@ -1007,46 +1096,188 @@ void PikaServer::DBSyncSendFile(const std::string& ip, int port) {
  * BinlogSender
  */
 Status PikaServer::AddBinlogSender(const std::string& ip, int64_t port,
-        uint32_t filenum, uint64_t con_offset) {
-    // Sanity check
-    if (con_offset > logger_->file_size()) {
-        return Status::InvalidArgument("AddBinlogSender invalid binlog offset");
+        const std::vector<BinlogOffset>& offsets) {
+    if (offsets.size() != loggers_.size()) {
+        return Status::InvalidArgument("AddBinlogSender binlog shard num mismatch");
     }
-    uint32_t cur_filenum = 0;
-    uint64_t cur_offset = 0;
-    logger_->GetProducerStatus(&cur_filenum, &cur_offset);
-    if (filenum != UINT32_MAX &&
-            (cur_filenum < filenum || (cur_filenum == filenum && cur_offset < con_offset))) {
-        return Status::InvalidArgument("AddBinlogSender invalid binlog offset");
+    // Sanity check
+    std::vector<BinlogOffset> cur_offsets;
+    GetBinlogOffsets(&cur_offsets);
+    for (size_t i = 0; i < offsets.size(); i++) {
+        uint32_t filenum = offsets[i].filenum;
+        uint64_t con_offset = offsets[i].offset;
+        if (con_offset > loggers_[i]->file_size()) {
+            return Status::InvalidArgument("AddBinlogSender invalid binlog offset");
+        }
+        if (filenum != UINT32_MAX &&
+                (cur_offsets[i].filenum < filenum
+                 || (cur_offsets[i].filenum == filenum && cur_offsets[i].offset < con_offset))) {
+            return Status::InvalidArgument("AddBinlogSender invalid binlog offset");
+        }
     }
 
-    if (filenum == UINT32_MAX) {
+    if (offsets[0].filenum == UINT32_MAX) {
         LOG(INFO) << "Maybe force full sync";
     }
 
-    // Create and set sender
-    slash::SequentialFile *readfile;
-    std::string confile = NewFileName(logger_->filename, filenum);
-    if (!slash::FileExists(confile)) {
-        // Not found binlog specified by filenum
-        TryDBSync(ip, port + 3000, cur_filenum);
-        return Status::Incomplete("Bgsaving and DBSync first");
+    // Create and set senders, one for every binlog shard
+    Status s;
+    std::vector<PikaBinlogSenderThread*> senders;
+    for (size_t i = 0; i < offsets.size(); i++) {
+        slash::SequentialFile *readfile;
+        std::string confile = NewFileName(loggers_[i]->filename, offsets[i].filenum);
+        if (!slash::FileExists(confile)) {
+            // Not found binlog specified by filenum
+            s = Status::Incomplete("Bgsaving and DBSync first");
+            break;
+        }
+        if (!slash::NewSequentialFile(confile, &readfile).ok()) {
+            s = Status::IOError("AddBinlogSender new sequtialfile");
+            break;
+        }
+
+        PikaBinlogSenderThread* sender = new PikaBinlogSenderThread(ip,
+                port + 1000, loggers_[i], readfile, offsets[i].filenum, offsets[i].offset);
+        senders.push_back(sender);
+        if (sender->trim() != 0) { // Error binlog
+            s = Status::NotFound("AddBinlogSender bad sender");
+            break;
+        }
+    }
+    if (s.ok() && !SetSlaveSender(ip, port, senders)) { // SlaveItem not exist
+        s = Status::NotFound("AddBinlogSender bad sender");
+    }
+
+    if (!s.ok()) {
+        for (size_t i = 0; i < senders.size(); i++) {
+            delete senders[i];
+        }
+        if (s.IsIncomplete()) {
+            TryDBSync(ip, port + 3000, cur_offsets[0].filenum);
+        } else if (s.IsNotFound()) {
+            LOG(WARNING) << "AddBinlogSender failed";
+        }
+        return s;
     }
-    if (!slash::NewSequentialFile(confile, &readfile).ok()) {
-        return Status::IOError("AddBinlogSender new sequtialfile");
+    for (size_t i = 0; i < senders.size(); i++) {
+        senders[i]->StartThread();
+    }
+    return Status::OK();
+}
+
+std::string PikaServer::BinlogShardPath(int shard) {
+    if (shard == 0) {
+        return g_pika_conf->binlog_path();
     }
+    return g_pika_conf->binlog_path() + kBinlogShardDir + std::to_string(shard) + "/";
+}
 
-    PikaBinlogSenderThread* sender = new PikaBinlogSenderThread(ip,
-            port + 1000, readfile, filenum, con_offset);
+bool PikaServer::IsCrossShardItem(const PikaCmdArgsType& argv) {
+    if (loggers_.size() <= 1) {
+        return false;
+    }
+    if (argv.size() < 2) {
+        return true;
+    }
+    std::string opt = argv[0];
+    slash::StringToLower(opt);
+    if (opt == kCmdNameDel) {
+        return argv.size() > 2;
+    } else if (opt == kCmdNameMset || opt == kCmdNameMsetnx) {
+        return argv.size() > 3;
+    }
+    return opt == kCmdNameRPopLPush
+        || opt == kCmdNameSMove
+        || opt == kCmdNameBitOp
+        || opt == kCmdNameZUnionstore
+        || opt == kCmdNameZInterstore
+        || opt == kCmdNameSUnionstore
+        || opt == kCmdNameSInterstore
+        || opt == kCmdNameSDiffstore
+        || opt == kCmdNamePfMerge;
+}
 
-    if (sender->trim() == 0 // Error binlog
-            && SetSlaveSender(ip, port, sender)) { // SlaveItem not exist
-        sender->StartThread();
-        return Status::OK();
+int PikaServer::BinlogShard(const PikaCmdArgsType& argv) {
+    if (loggers_.size() <= 1 || IsCrossShardItem(argv)) {
+        return 0;
+    }
+    uint32_t crc = PikaCommonFunc::CRC32Update(0, argv[1].data(), (int)argv[1].size());
+    return BinlogShard(crc);
+}
+
+void PikaServer::BinlogFenceLock(bool cross_shard) {
+    if (loggers_.size() <= 1) {
+        return;
+    }
+    if (cross_shard) {
+        binlog_fence_mutex_.WriteLock();
     } else {
-        delete sender;
-        LOG(WARNING) << "AddBinlogSender failed";
-        return Status::NotFound("AddBinlogSender bad sender");
+        binlog_fence_mutex_.ReadLock();
+    }
+}
+
+void PikaServer::BinlogFenceUnlock(bool cross_shard) {
+    if (loggers_.size() <= 1) {
+        return;
+    }
+    if (cross_shard) {
+        binlog_fence_mutex_.WriteUnlock();
+    } else {
+        binlog_fence_mutex_.ReadUnlock();
+    }
+}
+
+/*
+ * Every write before this one is in the binlog before the fences, nothing
+ * after it is, the exclusive side keeps the writes out. The slave holds
+ * each shard at its fence until all came, then applies raw_args alone
+ */
+Status PikaServer::WriteCrossShardBinlog(const std::string& raw_args) {
+    if (g_pika_conf->binlog_writer_method() != "sync") {
+        for (int i = 0; i < g_pika_conf->binlog_writer_num(); i++) {
+            binlog_write_thread_[i]->WaitBinlogWriterIdle();
+        }
+    }
+    uint64_t seq = ++binlog_fence_seq_;
+    Status s;
+    for (size_t i = 0; i < loggers_.size(); i++) {
+        PikaCmdArgsType fence = {kBinlogFenceCmd, std::to_string(i), std::to_string(seq)};
+        std::string fence_args;
+        pink::SerializeRedisCommand(fence, &fence_args);
+        s = loggers_[i]->GroupPut(fence_args);
+        if (!s.ok()) {
+            return s;
+        }
+    }
+    return logger_->GroupPut(raw_args);
+}
+
+void PikaServer::UpdateBinlogCompression() {
+    bool compression = g_pika_conf->binlog_compression() == "snappy";
+    for (size_t i = 0; i < loggers_.size(); i++) {
+        loggers_[i]->set_compression(compression);
+    }
+}
+
+void PikaServer::GetBinlogOffsets(std::vector<BinlogOffset>* offsets) {
+    offsets->resize(loggers_.size());
+    for (size_t i = 0; i < loggers_.size(); i++) {
+        loggers_[i]->GetProducerStatus(&(*offsets)[i].filenum, &(*offsets)[i].offset);
+    }
+}
+
+void PikaServer::SeekBinlog(uint32_t time, std::vector<BinlogOffset>* offsets,
+        std::vector<uint32_t>* item_times) {
+    offsets->resize(loggers_.size());
+    item_times->resize(loggers_.size());
+    for (size_t i = 0; i < loggers_.size(); i++) {
+        Status s = loggers_[i]->Seek(time, &(*offsets)[i].filenum,
+                &(*offsets)[i].offset, &(*item_times)[i]);
+        if (!s.ok()) {
+            LOG(WARNING) << "Seek binlog shard " << i << " failed: " << s.ToString();
+            loggers_[i]->GetProducerStatus(&(*offsets)[i].filenum, &(*offsets)[i].offset);
+            (*item_times)[i] = 0;
+        }
     }
 }
 
@@ -1091,7 +1322,7 @@ bool PikaServer::InitBgsaveEngine() {
         } else {
             LOG(WARNING) << "preset backup content success";
         }
-        RWLock l(&rwlock_, true);
+        slash::QuiesceWriteLock l(&rwlock_);
         s = bgsave_engine_->SetBackupContent();
         if (!s.ok()){
             LOG(WARNING) << "set backup content failed " << s.ToString();
@@ -1111,6 +1342,12 @@ bool PikaServer::InitBgsaveEngine() {
             
             slash::MutexLock l(&bgsave_protector_);
             logger_->GetProducerStatus(&bgsave_info_.filenum, &bgsave_info_.offset);
+            bgsave_info_.shard_offsets.clear();
+            for (size_t i = 1; i < loggers_.size(); i++) {
+                BinlogOffset offset;
+                loggers_[i]->GetProducerStatus(&offset.filenum, &offset.offset);
+                bgsave_info_.shard_offsets.push_back(offset);
+            }
         }
     }
     return true;
@@ -1180,6 +1417,10 @@ void PikaServer::DoBgsave(void* arg) {
       << p->port() << "\n"
       << info.filenum << "\n"
       << info.offset << "\n";
+    // One line of "filenum offset" for every other binlog shard
+    for (size_t i = 0; i < info.shard_offsets.size(); i++) {
+      out << info.shard_offsets[i].filenum << " " << info.shard_offsets[i].offset << "\n";
+    }
     out.close();
   }
   if (!ok) {
@@ -1252,6 +1493,7 @@ rocksdb::Status PikaServer::SlotsDelSlot(int slot){
                     continue;
                 }   
                 
+                BinlogFenceReadLock fence(this);
                 ret = db_->DelByType(key, KeyType(type.at(0)));
                 if (ret < 0) {
                     LOG(ERROR) << "del key: " << key << " error";
@@ -1435,10 +1677,10 @@ bool PikaServer::GetPurgeWindow(uint32_t &max) {
     return false;
 }
 
-bool PikaServer::CouldPurge(uint32_t index) {
+bool PikaServer::CouldPurge(int shard, uint32_t index) {
     uint32_t pro_num;
     uint64_t tmp;
-    logger_->GetProducerStatus(&pro_num, &tmp);
+    loggers_[shard]->GetProducerStatus(&pro_num, &tmp);
 
     index += 10; //remain some more
     if (index > pro_num) {
@@ -1451,7 +1693,7 @@ bool PikaServer::CouldPurge(uint32_t index) {
             // One Binlog Sender has not yet created, no purge
             return false;
         }
-        PikaBinlogSenderThread *pb = static_cast<PikaBinlogSenderThread*>((*it).sender);
+        PikaBinlogSenderThread *pb = SlaveSender(*it, shard);
         uint32_t filenum = pb->filenum();
         if (index > filenum) {
             return false;
@@ -1462,8 +1704,19 @@ bool PikaServer::CouldPurge(uint32_t index) {
 
 bool PikaServer::PurgeFiles(uint32_t to, bool manual, bool force)
 {
+    // Manual purge names the files of shard 0, the other shards only expire
+    bool ret = PurgeShardFiles(0, to, manual, force);
+    for (int i = 1; i < binlog_shard_num(); i++) {
+        ret = PurgeShardFiles(i, 0, false, force) && ret;
+    }
+    return ret;
+}
+
+bool PikaServer::PurgeShardFiles(int shard, uint32_t to, bool manual, bool force)
+{
+    std::string binlog_path = BinlogShardPath(shard);
     std::map<uint32_t, std::string> binlogs;
-    if (!GetBinlogFiles(binlogs)) {
+    if (!GetBinlogFiles(shard, binlogs)) {
         LOG(WARNING) << "Could not get binlog files!";
         return false;
     }
@@ -1476,17 +1729,18 @@ bool PikaServer::PurgeFiles(uint32_t to, bool manual, bool force)
         if ((manual && it->first <= to) ||           // Argument bound
                 remain_expire_num > 0 ||                 // Expire num trigger
                 (binlogs.size() > 10 /* at lease remain 10 files */
-                && stat(((g_pika_conf->binlog_path() + it->second)).c_str(), &file_stat) == 0 &&
+                && stat(((binlog_path + it->second)).c_str(), &file_stat) == 0 &&
                 file_stat.st_mtime < time(NULL) - g_pika_conf->expire_logs_days()*24*3600)) // Expire time trigger
         {
             // We check this every time to avoid lock when we do file deletion
-            if (!CouldPurge(it->first) && !force) {
+            if (!CouldPurge(shard, it->first) && !force) {
                 LOG(WARNING) << "Could not purge "<< (it->first) << ", since it is already be used";
                 return false;
             }
 
             // Do delete
-            slash::Status s = slash::DeleteFile(g_pika_conf->binlog_path() + it->second);
+            slash::Status s = slash::DeleteFile(binlog_path + it->second);
+            slash::DeleteFile(binlog_path + it->second + kBinlogIndexSuffix);
             if (s.ok()) {
                 ++delete_num;
                 --remain_expire_num;
@@ -1506,9 +1760,9 @@ bool PikaServer::PurgeFiles(uint32_t to, bool manual, bool force)
     return true;
 }
 
-bool PikaServer::GetBinlogFiles(std::map<uint32_t, std::string>& binlogs) {
+bool PikaServer::GetBinlogFiles(int shard, std::map<uint32_t, std::string>& binlogs) {
     std::vector<std::string> children;
-    int ret = slash::GetChildren(g_pika_conf->binlog_path(), children);
+    int ret = slash::GetChildren(BinlogShardPath(shard), children);
     if (ret != 0){
         LOG(WARNING) << "Get all files in log path failed! error:" << ret;
         return false;
@@ -1900,28 +2154,20 @@ void PikaServer::CancelMigrate(void)
 }
 
 void PikaServer::DispatchBinlogBG(const std::string &key,
-        PikaCmdArgsType* argv, const std::string& raw_args,
-        uint64_t cur_serial, bool readonly) {
+        PikaCmdArgsType* argv, bool readonly) {
     size_t index = str_hash(key) % binlogbg_workers_.size();
-    binlogbg_workers_[index]->Schedule(argv, raw_args, cur_serial, readonly);
+    binlogbg_pending_++;
+    binlogbg_workers_[index]->Schedule(argv, readonly);
 }
 
-bool PikaServer::WaitTillBinlogBGSerial(uint64_t my_serial) {
-    binlogbg_mutex_.Lock();
-    //DLOG(INFO) << "Binlog serial wait: " << my_serial << ", current: " << binlogbg_serial_;
-    while (binlogbg_serial_ != my_serial && !binlogbg_exit_) {
-        binlogbg_cond_.Wait();
-    }
-    binlogbg_mutex_.Unlock();
-    return (binlogbg_serial_ == my_serial);
+void PikaServer::PlusBinlogApplyNum() {
+    binlogbg_pending_--;
+    statistic_data_.binlog_apply_num++;
 }
 
-void PikaServer::SignalNextBinlogBGSerial() {
-    binlogbg_mutex_.Lock();
-    //DLOG(INFO) << "Binlog serial signal: " << binlogbg_serial_;
-    ++binlogbg_serial_;
-    binlogbg_cond_.SignalAll();
-    binlogbg_mutex_.Unlock();
+uint64_t PikaServer::BinlogApplyQps() {
+    slash::ReadLock l(&statistic_data_.statistic_lock);
+    return statistic_data_.last_sec_binlog_apply_num;
 }
 
 void PikaServer::RunKeyScan() {
@@ -1983,6 +2229,14 @@ int PikaServer::ClientKill(const std::string &ip_port) {
     return 0;
 }
 
+void PikaServer::ApplyClientOutputBufferLimit() {
+    for (int i = 0; i < pink::kOutputBufferClassNum; i++) {
+        pink::OutputBufferClass type = static_cast<pink::OutputBufferClass>(i);
+        pink::SetOutputBufferLimit(type, g_pika_conf->client_output_buffer_limit(type));
+    }
+    pink::SetOutputBufferPauseLen(g_pika_conf->client_output_buffer_pause());
+}
+
 int64_t PikaServer::ClientList(std::vector<ClientInfo> *clients) {
     int64_t clients_num = 0;
     clients_num += pika_dispatch_thread_->ThreadClientList(clients);
@@ -1991,15 +2245,23 @@ int64_t PikaServer::ClientList(std::vector<ClientInfo> *clients) {
 }
 
 void PikaServer::RWLockWriter() {
-    pthread_rwlock_wrlock(&rwlock_);
+    rwlock_.WriteLock();
+}
+
+void PikaServer::RWUnlockWriter() {
+    rwlock_.WriteUnlock();
 }
 
 void PikaServer::RWLockReader() {
-    pthread_rwlock_rdlock(&rwlock_);
+    rwlock_.ReadLock();
+}
+
+bool PikaServer::RWTryLockReader() {
+    return rwlock_.TryReadLock();
 }
 
-void PikaServer::RWUnlock() {
-    pthread_rwlock_unlock(&rwlock_);
+void PikaServer::RWUnlockReader() {
+    rwlock_.ReadUnlock();
 }
 
 void PikaServer::PlusThreadQuerynum() {
@@ -2016,6 +2278,10 @@ void PikaServer::ResetStat() {
     slash::WriteLock l(&statistic_data_.statistic_lock);
     statistic_data_.thread_querynum = 0;
     statistic_data_.last_thread_querynum = 0;
+    for (int i = 0; i < THREADPOOL_NUM; i++) {
+        pool_queue_stats_[i].Reset();
+    }
+    cmd_cost_stats_.ResetRouted();
 }
 
 uint64_t PikaServer::ServerCurrentQps() {
@@ -2027,6 +2293,10 @@ uint32_t PikaServer::GetThreadPoolTasks(int type) {
     return pika_thread_pools_[type]->task_num();
 }
 
+void PikaServer::WorkerAcceptRates(std::vector<uint64_t> *rates) {
+    pika_dispatch_thread_->WorkerAcceptRates(rates);
+}
+
 void PikaServer::ResetLastSecQuerynum() {
  slash::WriteLock l(&statistic_data_.statistic_lock);
  uint64_t cur_time_us = slash::NowMicros();
@@ -2034,6 +2304,10 @@ void PikaServer::ResetLastSecQuerynum() {
             (statistic_data_.thread_querynum - statistic_data_.last_thread_querynum)
             * 1000000 / (cur_time_us - statistic_data_.last_time_us + 1));
  statistic_data_.last_thread_querynum.store(statistic_data_.thread_querynum.load());
+ statistic_data_.last_sec_binlog_apply_num = (
+            (statistic_data_.binlog_apply_num - statistic_data_.last_binlog_apply_num)
+            * 1000000 / (cur_time_us - statistic_data_.last_time_us + 1));
+ statistic_data_.last_binlog_apply_num.store(statistic_data_.binlog_apply_num.load());
  statistic_data_.last_time_us = cur_time_us;
 }
 
@@ -2254,10 +2528,11 @@ void PikaServer::DoTimingTask() {
     AutoDeleteExpiredDump();
 
     // Check rsync deamon
-    if (((role_ & PIKA_ROLE_SLAVE) ^ PIKA_ROLE_SLAVE) || // Not a slave
+    if (g_pika_conf->db_sync_rsync() &&
+        (((role_ & PIKA_ROLE_SLAVE) ^ PIKA_ROLE_SLAVE) || // Not a slave
         repl_state_ == PIKA_REPL_NO_CONNECT ||
         repl_state_ == PIKA_REPL_CONNECTED ||
-        repl_state_ == PIKA_REPL_ERROR) {
+        repl_state_ == PIKA_REPL_ERROR)) {
         slash::StopRsync(g_pika_conf->db_sync_path());
     }
 
@@ -2277,7 +2552,7 @@ void PikaServer::DoFreshInfoTimingTask() {
 	g_pika_server->db()->GetUsage(blackwidow::USAGE_TYPE_ROCKSDB_TABLE_READER, &g_pika_server->table_reader_usage_);
 	//fresh log_info
 	g_pika_server->log_size_ = slash::Du(g_pika_conf->log_path());
-    g_pika_server->RWUnlock();
+    g_pika_server->RWUnlockReader();
 }
 
 void PikaServer::DoClearSysCachedMemory() {
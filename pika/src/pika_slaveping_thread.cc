@@ -58,6 +58,8 @@ void* PikaSlavepingThread::ThreadMain() {
       cli_->set_send_timeout(1000);
       cli_->set_recv_timeout(1000);
       connect_retry_times = 0;
+      // Asked before this session, its receiver conns are new
+      g_pika_server->TakeBinlogResync();
       g_pika_server->PlusMasterConnection();
       while (true) {
         if (should_stop()) {
@@ -71,6 +73,10 @@ void* PikaSlavepingThread::ThreadMain() {
         if (s.ok()) {
           s = RecvProc();
         }
+        if (s.ok() && g_pika_server->TakeBinlogResync()) {
+          // The receiver lost items of the master, trysync again
+          s = Status::Corruption("binlog resync");
+        }
         if (s.ok()) {
           DLOG(INFO) << "Ping master success";
           gettimeofday(&last_interaction, NULL);
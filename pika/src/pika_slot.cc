@@ -844,7 +844,8 @@ slash::Status BinlogPut(const std::string &key, const std::string &raw_args){
     uint32_t crc = PikaCommonFunc::CRC32Update(0, key.data(), (int)key.size());
     int binlog_writer_num = g_pika_conf->binlog_writer_num();
     int thread_index =  (int)(crc % binlog_writer_num);
-	slash::Status s = g_pika_server->binlog_write_thread_[thread_index]->WriteBinlog(raw_args, "sync" == g_pika_conf->binlog_writer_method());
+	slash::Status s = g_pika_server->binlog_write_thread_[thread_index]->WriteBinlog(raw_args, "sync" == g_pika_conf->binlog_writer_method(),
+			g_pika_server->BinlogShard(crc));
 	if (!s.ok()) {
 		LOG(ERROR) << "Writing binlog failed, maybe no space left on device";
 		//g_pika_server->SetBinlogIoError(true);
@@ -892,6 +893,7 @@ static int SlotsMgrtOne(const std::string &host, const int port, int timeout, co
 	if (send_command_num >= 1) {
 		std::vector<std::string> keys;
 		keys.push_back(key);
+		BinlogFenceReadLock fence(g_pika_server);
 		int64_t count = g_pika_server->db()->Del(keys, &type_status);
 		if (count > 0) {
 			WriteDelKeyToBinlog(key);
@@ -1801,6 +1803,8 @@ void SlotsrestoreCmd::Do() {
   std::vector<struct RestoreKey>::const_iterator iter = restore_keys_.begin();
 
   for (; iter != restore_keys_.end(); iter++) {
+	// The key, its ttl and their binlog go in together
+	BinlogFenceReadLock fence(g_pika_server);
 	//LOG(ERROR) << "SlotsrestoreCmd: key[" << iter->key << "], ttlms[" << iter->ttlms << "]"; //, value[" << iter->value << "]";
 
 	if (verifyDumpPayload((unsigned char *)iter->value.data(), iter->value.size()) != REDIS_OK) {
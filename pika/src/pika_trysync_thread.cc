@@ -20,7 +20,9 @@ extern PikaConf* g_pika_conf;
 
 PikaTrysyncThread::~PikaTrysyncThread() {
   StopThread();
-  slash::StopRsync(g_pika_conf->db_sync_path());
+  if (g_pika_conf->db_sync_rsync()) {
+    slash::StopRsync(g_pika_conf->db_sync_path());
+  }
   delete cli_;
   LOG(INFO) << " Trysync thread " << thread_id() << " exit!!!";
 }
@@ -40,16 +42,18 @@ bool PikaTrysyncThread::Send() {
   argv.push_back("trysync");
   argv.push_back(g_pika_server->host());
   argv.push_back(std::to_string(g_pika_server->port()));
-  uint32_t filenum;
-  uint64_t pro_offset;
-  g_pika_server->logger_->GetProducerStatus(&filenum, &pro_offset);
+  // "filenum offset" of every binlog shard
+  std::vector<BinlogOffset> offsets;
+  g_pika_server->GetBinlogOffsets(&offsets);
   
-  if (g_pika_server->force_full_sync()) {
-    argv.push_back(std::to_string(UINT32_MAX));
-    argv.push_back(std::to_string(0));
-  } else {
-    argv.push_back(std::to_string(filenum));
-    argv.push_back(std::to_string(pro_offset));
+  for (size_t i = 0; i < offsets.size(); i++) {
+    if (g_pika_server->force_full_sync()) {
+      argv.push_back(std::to_string(UINT32_MAX));
+      argv.push_back(std::to_string(0));
+    } else {
+      argv.push_back(std::to_string(offsets[i].filenum));
+      argv.push_back(std::to_string(offsets[i].offset));
+    }
   }
   pink::SerializeRedisCommand(argv, &tbuf_str);
 
@@ -138,6 +142,8 @@ bool PikaTrysyncThread::TryUpdateMasterOffset() {
   std::string line, master_ip;
   int lineno = 0;
   int64_t filenum = 0, offset = 0, tmp = 0, master_port = 0;
+  // Lines after the 5th are "filenum offset" of binlog shards 1 ~ n-1
+  std::vector<BinlogOffset> shard_offsets;
   while (std::getline(is, line)) {
     lineno++;
     if (lineno == 2) {
@@ -153,9 +159,16 @@ bool PikaTrysyncThread::TryUpdateMasterOffset() {
       else { offset = tmp; }
 
     } else if (lineno > 5) {
-      LOG(WARNING) << "Format of info file after db sync error, line : " << line;
-      is.close();
-      return false;
+      int64_t shard_filenum = 0, shard_offset = 0;
+      size_t pos = line.find(' ');
+      if (pos == std::string::npos
+          || !slash::string2l(line.data(), pos, &shard_filenum) || shard_filenum < 0
+          || !slash::string2l(line.data() + pos + 1, line.size() - pos - 1, &shard_offset) || shard_offset < 0) {
+        LOG(WARNING) << "Format of info file after db sync error, line : " << line;
+        is.close();
+        return false;
+      }
+      shard_offsets.push_back(BinlogOffset(shard_filenum, shard_offset));
     }
   }
   is.close();
@@ -170,9 +183,16 @@ bool PikaTrysyncThread::TryUpdateMasterOffset() {
     LOG(WARNING) << "Error master ip port: " << master_ip << ":" << master_port;
     return false;
   }
+  if (static_cast<int>(shard_offsets.size()) + 1 != g_pika_server->binlog_shard_num()) {
+    LOG(WARNING) << "Error binlog shard num: " << shard_offsets.size() + 1
+      << ", mine: " << g_pika_server->binlog_shard_num();
+    return false;
+  }
 
   // Replace the old db
-  slash::StopRsync(g_pika_conf->db_sync_path());
+  if (g_pika_conf->db_sync_rsync()) {
+    slash::StopRsync(g_pika_conf->db_sync_path());
+  }
   slash::DeleteFile(info_path);
   if (!g_pika_server->ChangeDb(g_pika_conf->db_sync_path())) {
     LOG(WARNING) << "Failed to change db";
@@ -181,6 +201,9 @@ bool PikaTrysyncThread::TryUpdateMasterOffset() {
 
   // Update master offset
   g_pika_server->logger_->SetProducerStatus(filenum, offset);
+  for (size_t i = 0; i < shard_offsets.size(); i++) {
+    g_pika_server->logger(i + 1)->SetProducerStatus(shard_offsets[i].filenum, shard_offsets[i].offset);
+  }
   g_pika_server->WaitDBSyncFinish();
   g_pika_server->SetForceFullSync(false);
   return true;
@@ -205,6 +228,11 @@ void* PikaTrysyncThread::ThreadMain() {
       //Try to update offset by db sync
       if (TryUpdateMasterOffset()) {
         LOG(INFO) << "Success Update Master Offset";
+      } else if (!g_pika_conf->db_sync_rsync() && g_pika_server->DBSyncIdleTooLong()) {
+        // The master gave up or died, trysync again, the files received
+        // are kept and resumed
+        LOG(WARNING) << "No db sync data for " << kDBSyncIdleTimeout << "s, trysync again";
+        g_pika_server->WaitDBSyncFinish();
       }
     }
 
@@ -217,26 +245,31 @@ void* PikaTrysyncThread::ThreadMain() {
     std::string master_ip = g_pika_server->master_ip();
     int master_port = g_pika_server->master_port();
     
-    // Start rsync
     std::string dbsync_path = g_pika_conf->db_sync_path();
-    PrepareRsync();
-    std::string ip_port = slash::IpPortString(master_ip, master_port);
-    // We append the master ip port after module name
-    // To make sure only data from current master is received
-    int ret = slash::StartRsync(dbsync_path, kDBSyncModule + "_" + ip_port, g_pika_server->host(), g_pika_conf->port() + 3000);
-    if (0 != ret) {
-      LOG(WARNING) << "Failed to start rsync, path:" << dbsync_path << " error : " << ret;
+    if (g_pika_conf->db_sync_rsync()) {
+      // Start rsync
+      PrepareRsync();
+      std::string ip_port = slash::IpPortString(master_ip, master_port);
+      // We append the master ip port after module name
+      // To make sure only data from current master is received
+      int ret = slash::StartRsync(dbsync_path, kDBSyncModule + "_" + ip_port, g_pika_server->host(), g_pika_conf->port() + 3000);
+      if (0 != ret) {
+        LOG(WARNING) << "Failed to start rsync, path:" << dbsync_path << " error : " << ret;
+      }
+      LOG(INFO) << "Finish to start rsync, path:" << dbsync_path;
+    } else {
+      slash::CreatePath(dbsync_path);
     }
-    LOG(INFO) << "Finish to start rsync, path:" << dbsync_path;
-
 
     if ((cli_->Connect(master_ip, master_port, "")).ok()) {
       cli_->set_send_timeout(30000);
       cli_->set_recv_timeout(30000);
       if (Send() && RecvProc()) {
         g_pika_server->ConnectMasterDone();
-        // Stop rsync, binlog sync with master is begin
-        slash::StopRsync(dbsync_path);
+        if (g_pika_conf->db_sync_rsync()) {
+          // Stop rsync, binlog sync with master is begin
+          slash::StopRsync(dbsync_path);
+        }
         delete g_pika_server->ping_thread_;
         g_pika_server->ping_thread_ = new PikaSlavepingThread(sid_);
         g_pika_server->ping_thread_->StartThread();
@@ -180,6 +180,7 @@ bool PikaZsetAutoDelThread::BatchTrimZsetKeys(double speed_factor) {
 
             {
                 slash::ScopeRecordLock l(g_pika_server->LockMgr(), key);
+                BinlogFenceReadLock fence(g_pika_server);
                 int32_t count = 0;
                 int start = (0 == g_pika_conf->zset_auto_del_direction()) ? 0 : -need_delete_nums;
                 int end = (0 == g_pika_conf->zset_auto_del_direction()) ? need_delete_nums - 1 : -1;
@@ -0,0 +1,202 @@
+// Copyright (c) 2015-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "slash/include/env.h"
+#include "slash/include/testutil.h"
+#include "slash/include/slash_testharness.h"
+#include "pika_binlog.h"
+
+struct ItemPos {
+  uint32_t filenum;
+  uint64_t offset;
+};
+
+class PikaBinlogTest {
+ public:
+  PikaBinlogTest() {
+    slash::GetTestDirectory(&path_);
+    path_ += "/pika_binlog/";
+    slash::DeleteDirIfExist(path_);
+    slash::CreatePath(path_);
+  }
+  ~PikaBinlogTest() {
+    slash::DeleteDirIfExist(path_);
+  }
+
+ protected:
+  // An item of len bytes, len is at least 4
+  std::string Item(size_t len, char c) {
+    return "*1\r\n" + std::string(len - 4, c);
+  }
+
+  // Where the next item of binlog starts, it is in the next file if the
+  // current one is full and in the next block if the trailer is too short
+  // for a header
+  ItemPos NextPos(Binlog* binlog) {
+    ItemPos pos;
+    binlog->GetProducerStatus(&pos.filenum, &pos.offset);
+    if (pos.offset > binlog->file_size()) {
+      pos.filenum++;
+      pos.offset = 0;
+    }
+    if (kBlockSize - pos.offset % kBlockSize < kHeaderSize) {
+      pos.offset += kBlockSize - pos.offset % kBlockSize;
+    }
+    return pos;
+  }
+
+  // Offsets of the items of a file found by BinlogItemScanner
+  std::vector<uint64_t> Scan(Binlog* binlog, uint32_t filenum, uint64_t limit) {
+    std::vector<uint64_t> offsets;
+    BinlogItemScanner scanner(NewFileName(binlog->filename, filenum), 0, limit);
+    uint64_t offset = 0;
+    uint32_t time = 0;
+    while (scanner.Next(&offset, &time).ok()) {
+      offsets.push_back(offset);
+    }
+    return offsets;
+  }
+
+  // Wait for the next second, items written after it have a later time
+  uint32_t NextSecond() {
+    uint32_t now = time(NULL);
+    while (static_cast<uint32_t>(time(NULL)) == now) {
+      usleep(10000);
+    }
+    return time(NULL);
+  }
+
+  std::string path_;
+};
+
+TEST(PikaBinlogTest, ScanItemsSpanBlocks) {
+  Binlog binlog(path_, 64 * 1024 * 1024);
+  std::vector<uint64_t> expect;
+  for (int i = 0; i < 300; i++) {
+    ItemPos pos = NextPos(&binlog);
+    size_t len = 100 + (i * 37) % 900;
+    if (i % 50 == 7) {
+      // Over three blocks, written as first, middle and last records
+      len = 3 * kBlockSize + 100;
+    } else if (i % 50 == 20) {
+      // Leaves less than a header at the end of the block, the next item
+      // starts in the next block
+      size_t left = kBlockSize - pos.offset % kBlockSize;
+      if (left >= kHeaderSize + 4 + 5) {
+        len = left - kHeaderSize - 5;
+      }
+    }
+    ASSERT_EQ(pos.filenum, 0u);
+    expect.push_back(pos.offset);
+    if (i % 3 == 0) {
+      ASSERT_OK(binlog.Put(Item(len, 'a' + i % 26)));
+    } else {
+      ASSERT_OK(binlog.GroupPut(Item(len, 'a' + i % 26)));
+    }
+  }
+
+  uint32_t filenum = 0;
+  uint64_t pro_offset = 0;
+  ASSERT_OK(binlog.GetProducerStatus(&filenum, &pro_offset));
+  std::vector<uint64_t> offsets = Scan(&binlog, 0, pro_offset);
+  ASSERT_EQ(offsets.size(), expect.size());
+  for (size_t i = 0; i < expect.size(); i++) {
+    ASSERT_EQ(offsets[i], expect[i]);
+  }
+
+  // An item ending after the limit is not returned
+  offsets = Scan(&binlog, 0, expect.back() + 1);
+  ASSERT_EQ(offsets.size(), expect.size() - 1);
+}
+
+TEST(PikaBinlogTest, ScanAfterAppendBlank) {
+  Binlog binlog(path_, 64 * 1024 * 1024);
+  const uint64_t start = 3 * kBlockSize + 1000;
+  ASSERT_OK(binlog.SetProducerStatus(5, start));
+
+  std::vector<uint64_t> expect;
+  for (int i = 0; i < 20; i++) {
+    ItemPos pos = NextPos(&binlog);
+    ASSERT_EQ(pos.filenum, 5u);
+    expect.push_back(pos.offset);
+    ASSERT_OK(binlog.Put(Item(i == 3 ? 2 * kBlockSize : 500, 'p')));
+  }
+  ASSERT_EQ(expect[0], start);
+
+  uint32_t filenum = 0;
+  uint64_t pro_offset = 0;
+  ASSERT_OK(binlog.GetProducerStatus(&filenum, &pro_offset));
+  std::vector<uint64_t> offsets = Scan(&binlog, 5, pro_offset);
+  ASSERT_EQ(offsets.size(), expect.size());
+  for (size_t i = 0; i < expect.size(); i++) {
+    ASSERT_EQ(offsets[i], expect[i]);
+  }
+
+  // The first item is after the blank
+  uint64_t offset = 0;
+  uint32_t item_time = 0;
+  ASSERT_OK(binlog.Seek(0, &filenum, &offset, &item_time));
+  ASSERT_EQ(filenum, 5u);
+  ASSERT_EQ(offset, start);
+  ASSERT_GT(item_time, 0u);
+}
+
+TEST(PikaBinlogTest, SeekByTime) {
+  // Small files, so the items of a second span files
+  Binlog binlog(path_, 256 * 1024);
+  std::vector<ItemPos> firsts;
+  std::vector<uint32_t> times;
+  for (int round = 0; round < 3; round++) {
+    times.push_back(NextSecond());
+    for (int i = 0; i < 60; i++) {
+      ItemPos pos = NextPos(&binlog);
+      if (i == 0) {
+        firsts.push_back(pos);
+      }
+      size_t len = i % 20 == 5 ? kBlockSize + 500 : 2000;
+      if (i % 2 == 0) {
+        ASSERT_OK(binlog.Put(Item(len, 's')));
+      } else {
+        ASSERT_OK(binlog.GroupPut(Item(len, 's')));
+      }
+    }
+  }
+  uint32_t filenum = 0;
+  uint64_t offset = 0;
+  uint32_t item_time = 0;
+  ASSERT_OK(binlog.GetProducerStatus(&filenum, &offset));
+  ASSERT_GT(filenum, 2u);
+
+  for (size_t round = 0; round < times.size(); round++) {
+    ASSERT_OK(binlog.Seek(times[round], &filenum, &offset, &item_time));
+    ASSERT_EQ(filenum, firsts[round].filenum);
+    ASSERT_EQ(offset, firsts[round].offset);
+    // A round may run into the next second
+    ASSERT_GE(item_time, times[round]);
+  }
+
+  // Older than every item
+  ASSERT_OK(binlog.Seek(times[0] - 100, &filenum, &offset, &item_time));
+  ASSERT_EQ(filenum, 0u);
+  ASSERT_EQ(offset, 0u);
+
+  // Newer than every item, the producer position
+  uint32_t pro_num = 0;
+  uint64_t pro_offset = 0;
+  ASSERT_OK(binlog.GetProducerStatus(&pro_num, &pro_offset));
+  ASSERT_OK(binlog.Seek(time(NULL) + 100, &filenum, &offset, &item_time));
+  ASSERT_EQ(filenum, pro_num);
+  ASSERT_EQ(offset, pro_offset);
+  ASSERT_EQ(item_time, 0u);
+}
+
+int main() {
+  return slash::test::RunAllTests();
+}
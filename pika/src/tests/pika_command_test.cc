@@ -0,0 +1,73 @@
+// Copyright (c) 2015-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+#include <set>
+#include <string>
+
+#include "slash/include/slash_string.h"
+#include "slash/include/slash_testharness.h"
+#include "pika_conf.h"
+#include "pika_server.h"
+#include "pika_cmd_table_manager.h"
+#include "pika_command.h"
+
+// Defined by pika.cc, which is not linked in
+PikaConf* g_pika_conf = NULL;
+PikaServer* g_pika_server = NULL;
+PikaCmdTableManager* g_pika_cmd_table_manager = NULL;
+
+class PikaCommandTest {
+ public:
+  PikaCommandTest() {
+    InitCmdInfoTable();
+    InitCmdTable(&cmd_table_);
+  }
+  ~PikaCommandTest() {
+    DestoryCmdTable(&cmd_table_);
+    DestoryCmdInfoTable();
+  }
+
+ protected:
+  CmdTable cmd_table_;
+};
+
+TEST(PikaCommandTest, IndexEveryCommand) {
+  ASSERT_EQ(static_cast<size_t>(GetCmdNum()), cmd_table_.size());
+  std::set<int> indexes;
+  for (const auto& item : cmd_table_) {
+    int index = GetCmdIndex(item.first);
+    ASSERT_GE(index, 0);
+    ASSERT_LT(index, GetCmdNum());
+    ASSERT_TRUE(indexes.insert(index).second);
+    ASSERT_TRUE(GetCmdInfo(item.first) == GetCmdInfoByIndex(index));
+
+    // Any case finds the same command
+    std::string upper = item.first;
+    slash::StringToUpper(upper);
+    ASSERT_EQ(GetCmdIndex(upper), index);
+  }
+}
+
+TEST(PikaCommandTest, TableNames) {
+  // pttl has the CmdInfo of ttl, each is found by its own name
+  int ttl = GetCmdIndex(kCmdNameTtl);
+  int pttl = GetCmdIndex(kCmdNamePttl);
+  ASSERT_GE(ttl, 0);
+  ASSERT_GE(pttl, 0);
+  ASSERT_NE(ttl, pttl);
+  ASSERT_TRUE(GetCmdInfo(kCmdNamePttl) != NULL);
+}
+
+TEST(PikaCommandTest, UnknownCommands) {
+  ASSERT_EQ(GetCmdIndex(""), -1);
+  ASSERT_EQ(GetCmdIndex("nosuchcommand"), -1);
+  ASSERT_EQ(GetCmdIndex("ge"), -1);
+  ASSERT_EQ(GetCmdIndex("gett"), -1);
+  ASSERT_EQ(GetCmdIndex(std::string("get\0", 4)), -1);
+  ASSERT_TRUE(GetCmdInfo("nosuchcommand") == NULL);
+}
+
+int main() {
+  return slash::test::RunAllTests();
+}
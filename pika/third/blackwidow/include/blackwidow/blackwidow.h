@@ -240,6 +240,12 @@ class BlackWidow {
   Status MGet(const std::vector<std::string>& keys,
               std::vector<ValueStatus>* vss);
 
+  // Like MGet, and also returns the ttl of every key, which is -1 if
+  // the key has no ttl, and -2 if the key does not exist
+  Status MGetWithTTL(const std::vector<std::string>& keys,
+                     std::vector<ValueStatus>* vss,
+                     std::vector<int64_t>* ttls);
+
   // Set key to hold string value if key does not exist
   // return 1 if the key was set
   // return 0 if the key was not set
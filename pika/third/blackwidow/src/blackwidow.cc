@@ -297,6 +297,12 @@ Status BlackWidow::MGet(const std::vector<std::string>& keys,
   return strings_db_->MGet(keys, vss);
 }
 
+Status BlackWidow::MGetWithTTL(const std::vector<std::string>& keys,
+                               std::vector<ValueStatus>* vss,
+                               std::vector<int64_t>* ttls) {
+  return strings_db_->MGetWithTTL(keys, vss, ttls);
+}
+
 Status BlackWidow::Setnx(const Slice& key, const Slice& value,
                          int32_t* ret, const int32_t ttl) {
   return strings_db_->Setnx(key, value, ret, ttl);
@@ -626,16 +626,18 @@ Status RedisStrings::MGet(const std::vector<std::string>& keys,
                           std::vector<ValueStatus>* vss) {
   vss->clear();
 
-  Status s;
-  std::string value;
   rocksdb::ReadOptions read_options;
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(Titandb_, &snapshot);
   read_options.snapshot = snapshot;
-  for (const auto& key : keys) {
-    s = Titandb_->Get(read_options, key, &value);
+  std::vector<Slice> key_slices(keys.begin(), keys.end());
+  std::vector<std::string> values;
+  std::vector<Status> statuses =
+    Titandb_->MultiGet(read_options, key_slices, &values);
+  for (size_t i = 0; i < keys.size(); i++) {
+    const Status& s = statuses[i];
     if (s.ok()) {
-      ParsedStringsValue parsed_strings_value(&value);
+      ParsedStringsValue parsed_strings_value(&values[i]);
       if (parsed_strings_value.IsStale()) {
         vss->push_back({std::string(), Status::NotFound("Stale")});
       } else {
@@ -652,6 +654,52 @@ Status RedisStrings::MGet(const std::vector<std::string>& keys,
   return Status::OK();
 }
 
+Status RedisStrings::MGetWithTTL(const std::vector<std::string>& keys,
+                                 std::vector<ValueStatus>* vss,
+                                 std::vector<int64_t>* ttls) {
+  vss->clear();
+  ttls->clear();
+
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+  ScopeSnapshot ss(Titandb_, &snapshot);
+  read_options.snapshot = snapshot;
+  std::vector<Slice> key_slices(keys.begin(), keys.end());
+  std::vector<std::string> values;
+  std::vector<Status> statuses =
+    Titandb_->MultiGet(read_options, key_slices, &values);
+  int64_t curtime = 0;
+  rocksdb::Env::Default()->GetCurrentTime(&curtime);
+  for (size_t i = 0; i < keys.size(); i++) {
+    const Status& s = statuses[i];
+    if (s.ok()) {
+      ParsedStringsValue parsed_strings_value(&values[i]);
+      if (parsed_strings_value.IsStale()) {
+        vss->push_back({std::string(), Status::NotFound("Stale")});
+        ttls->push_back(-2);
+      } else {
+        int64_t ttl = parsed_strings_value.timestamp();
+        if (ttl == 0) {
+          ttl = -1;
+        } else {
+          ttl = ttl - curtime >= 0 ? ttl - curtime : -2;
+        }
+        vss->push_back(
+            {parsed_strings_value.user_value().ToString(), Status::OK()});
+        ttls->push_back(ttl);
+      }
+    } else if (s.IsNotFound()) {
+      vss->push_back({std::string(), Status::NotFound()});
+      ttls->push_back(-2);
+    } else {
+      vss->clear();
+      ttls->clear();
+      return s;
+    }
+  }
+  return Status::OK();
+}
+
 Status RedisStrings::MSet(const std::vector<KeyValue>& kvs) {
   std::vector<std::string> keys;
   for (const auto& kv :  kvs) {
@@ -52,6 +52,9 @@ class RedisStrings : public Redis {
   Status Incrbyfloat(const Slice& key, const Slice& value, std::string* ret);
   Status MGet(const std::vector<std::string>& keys,
               std::vector<ValueStatus>* vss);
+  Status MGetWithTTL(const std::vector<std::string>& keys,
+                     std::vector<ValueStatus>* vss,
+                     std::vector<int64_t>* ttls);
   Status MSet(const std::vector<KeyValue>& kvs);
   Status MSetnx(const std::vector<KeyValue>& kvs, int32_t* ret);
   Status Set(const Slice& key, const Slice& value, const int32_t ttl = 0);
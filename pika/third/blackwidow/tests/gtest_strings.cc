@@ -347,6 +347,42 @@ TEST_F(StringsTest, MGetTest) {
   ASSERT_EQ(vss[3].value, "");
 }
 
+// MGetWithTTL
+TEST_F(StringsTest, MGetWithTTLTest) {
+  std::vector<blackwidow::ValueStatus> vss;
+  std::vector<int64_t> ttls;
+
+  s = db.Set("MGETWITHTTL_KEY1", "VALUE1");
+  ASSERT_TRUE(s.ok());
+  s = db.Setex("MGETWITHTTL_KEY2", "VALUE2", 100);
+  ASSERT_TRUE(s.ok());
+  s = db.Set("MGETWITHTTL_KEY3", "VALUE3");
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(make_expired(&db, "MGETWITHTTL_KEY3"));
+
+  std::vector<std::string> keys {"MGETWITHTTL_KEY1",
+                                 "MGETWITHTTL_KEY2",
+                                 "MGETWITHTTL_KEY3",
+                                 "MGETWITHTTL_NOT_EXIST_KEY",
+                                 "MGETWITHTTL_KEY1"};
+  s = db.MGetWithTTL(keys, &vss, &ttls);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(vss.size(), 5);
+  ASSERT_EQ(ttls.size(), 5);
+  ASSERT_TRUE(vss[0].status.ok());
+  ASSERT_EQ(vss[0].value, "VALUE1");
+  ASSERT_EQ(ttls[0], -1);
+  ASSERT_TRUE(vss[1].status.ok());
+  ASSERT_EQ(vss[1].value, "VALUE2");
+  ASSERT_TRUE(ttls[1] > 0 && ttls[1] <= 100);
+  ASSERT_TRUE(vss[2].status.IsNotFound());
+  ASSERT_EQ(ttls[2], -2);
+  ASSERT_TRUE(vss[3].status.IsNotFound());
+  ASSERT_EQ(ttls[3], -2);
+  ASSERT_TRUE(vss[4].status.ok());
+  ASSERT_EQ(vss[4].value, "VALUE1");
+}
+
 // MSet
 TEST_F(StringsTest, MSetTest) {
   std::vector<blackwidow::KeyValue> kvs;
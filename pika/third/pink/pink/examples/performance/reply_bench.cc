@@ -0,0 +1,152 @@
+// Copyright (c) 2015-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+/*
+ * Compare the reply path of RedisConn before and after chunked output:
+ *   old: every reply is appended to one std::string, flushed by write()
+ *   new: RedisConn::AppendReply, flushed by writev() in SendReply
+ * Bytes copied counts the bytes memcpy'd into the output buffer, including
+ * the moves done when the buffer grows.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "slash/include/env.h"
+#include "pink/include/redis_conn.h"
+
+using namespace pink;
+
+class BenchConn : public RedisConn {
+ public:
+  BenchConn(int fd) : RedisConn(fd, "bench", nullptr) {}
+  virtual int DealMessage(const RedisCmdArgsType& argv, std::string* response) {
+    return 0;
+  }
+};
+
+static void Drain(int fd) {
+  char buf[65536];
+  while (read(fd, buf, sizeof(buf)) > 0) {
+  }
+}
+
+static void WriteAll(int fd, const std::string& buf) {
+  size_t pos = 0;
+  while (pos < buf.size()) {
+    ssize_t n = write(fd, buf.data() + pos, buf.size() - pos);
+    if (n > 0) {
+      pos += n;
+    }
+  }
+}
+
+// Copies done by appending to one growing string
+static uint64_t OldCopied(const std::vector<std::string>& replies) {
+  uint64_t copied = 0;
+  std::string response;
+  for (const auto& r : replies) {
+    if (response.empty()) {
+      response = r;  // was a move
+      continue;
+    }
+    if (response.size() + r.size() > response.capacity()) {
+      copied += response.size();
+    }
+    copied += r.size();
+    response.append(r);
+  }
+  return copied;
+}
+
+// Copies done by the policy documented at RedisConn::AppendReply
+static uint64_t NewCopied(const std::vector<std::string>& replies) {
+  uint64_t copied = 0;
+  std::string response;
+  for (const auto& r : replies) {
+    if (r.size() >= REDIS_REPLY_CHUNK_LEN
+        || response.size() + r.size() > REDIS_REPLY_CHUNK_LEN) {
+      response = std::string();
+    }
+    if (r.size() >= REDIS_REPLY_CHUNK_LEN) {
+      continue;
+    } else if (response.empty()) {
+      response = r;  // swapped in
+    } else {
+      if (response.size() + r.size() > response.capacity()) {
+        copied += response.size();
+      }
+      copied += r.size();
+      response.append(r);
+    }
+  }
+  return copied;
+}
+
+static void Run(const char* name, size_t reply_num, size_t reply_len, int rounds) {
+  std::vector<std::string> replies;
+  for (size_t i = 0; i < reply_num; i++) {
+    replies.push_back("$" + std::to_string(reply_len) + "\r\n"
+                      + std::string(reply_len, 'v') + "\r\n");
+  }
+  uint64_t total = 0;
+  for (const auto& r : replies) {
+    total += r.size();
+  }
+
+  int fds[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  std::thread reader(Drain, fds[1]);
+
+  uint64_t start = slash::NowMicros();
+  for (int i = 0; i < rounds; i++) {
+    std::vector<std::string> batch(replies);
+    std::string response;
+    for (auto& r : batch) {
+      if (response.empty()) {
+        response = std::move(r);
+      } else {
+        response.append(r);
+      }
+    }
+    WriteAll(fds[0], response);
+  }
+  uint64_t old_us = slash::NowMicros() - start;
+
+  BenchConn conn(fds[0]);
+  start = slash::NowMicros();
+  for (int i = 0; i < rounds; i++) {
+    std::vector<std::string> batch(replies);
+    for (auto& r : batch) {
+      conn.AppendReply(&r);
+    }
+    while (conn.SendReply() == kWriteHalf) {
+    }
+  }
+  uint64_t new_us = slash::NowMicros() - start;
+
+  shutdown(fds[0], SHUT_WR);
+  reader.join();
+  close(fds[0]);
+  close(fds[1]);
+
+  printf("%-28s reply bytes %10lu  copied old %10lu new %10lu  "
+         "time(us) old %8lu new %8lu\n",
+         name, total, OldCopied(replies), NewCopied(replies),
+         old_us, new_us);
+}
+
+int main() {
+  Run("pipeline 100 x 64B", 100, 64, 2000);
+  Run("pipeline 100 x 4KB", 100, 4096, 500);
+  Run("pipeline 100 x 64KB", 100, 65536, 20);
+  Run("single 8MB bulk", 1, 8 << 20, 20);
+  return 0;
+}
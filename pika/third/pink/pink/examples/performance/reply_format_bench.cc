@@ -0,0 +1,195 @@
+// Copyright (c) 2015-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+/*
+ * Compare the way pika builds the replies of GET, HGETALL and ZRANGE
+ * WITHSCORES before and after the reply arena:
+ *   old: every command formats its reply into a fresh string, headers by
+ *        ll2string, the string is moved out and swapped into response_
+ *   new: the reply is formatted into a string reused by the thread, headers
+ *        by AppendRedisLen, then copied into response_ by AppendReply
+ * Replies are flushed every pipeline. Allocations count the
+ * calls of operator new, in the formatting and queueing only.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "slash/include/env.h"
+#include "slash/include/slash_string.h"
+#include "pink/include/redis_conn.h"
+
+using namespace pink;
+
+static std::atomic<uint64_t> g_alloc_num(0);
+
+void* operator new(size_t size) {
+  g_alloc_num.fetch_add(1, std::memory_order_relaxed);
+  void* p = malloc(size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+class BenchConn : public RedisConn {
+ public:
+  BenchConn(int fd) : RedisConn(fd, "bench", nullptr) {}
+  virtual int DealMessage(const RedisCmdArgsType& argv, std::string* response) {
+    return 0;
+  }
+};
+
+static void Drain(int fd) {
+  char buf[65536];
+  while (read(fd, buf, sizeof(buf)) > 0) {
+  }
+}
+
+static void WriteAll(int fd, const std::string& buf) {
+  size_t pos = 0;
+  while (pos < buf.size()) {
+    ssize_t n = write(fd, buf.data() + pos, buf.size() - pos);
+    if (n > 0) {
+      pos += n;
+    }
+  }
+}
+
+// RedisAppendLen of pika before the header tables
+static void OldAppendLen(std::string& str, int64_t ori, const std::string& prefix) {
+  char buf[32];
+  slash::ll2string(buf, 32, static_cast<long long>(ori));
+  str.append(prefix);
+  str.append(buf);
+  str.append("\r\n");
+}
+
+static void OldAppendString(std::string& str, const std::string& value) {
+  OldAppendLen(str, value.size(), "$");
+  str.append(value);
+  str.append("\r\n");
+}
+
+static void NewAppendString(std::string* str, const std::string& value) {
+  AppendRedisLen(str, value.size(), '$');
+  str->append(value);
+  str->append("\r\n");
+}
+
+// The array of a reply, an empty one is a GET
+typedef std::vector<std::string> Values;
+
+static std::string OldFormat(const Values& values, bool array) {
+  std::string message;
+  if (array) {
+    OldAppendLen(message, values.size(), "*");
+  }
+  for (const auto& v : values) {
+    OldAppendString(message, v);
+  }
+  return message;
+}
+
+static void NewFormat(const Values& values, bool array, std::string* message) {
+  if (array) {
+    AppendRedisLen(message, values.size(), '*');
+  }
+  for (const auto& v : values) {
+    NewAppendString(message, v);
+  }
+}
+
+static void Run(const char* name, const Values& values, bool array,
+                int pipeline, int rounds) {
+  int fds[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  std::thread reader(Drain, fds[1]);
+
+  std::string response;
+  uint64_t old_allocs = 0;
+  uint64_t start = slash::NowMicros();
+  for (int i = 0; i < rounds; i++) {
+    uint64_t allocs = g_alloc_num.load();
+    for (int j = 0; j < pipeline; j++) {
+      std::string resp = OldFormat(values, array);
+      // AppendReply swapped a reply into an empty response_
+      if (response.empty()) {
+        response.swap(resp);
+      } else {
+        response.append(resp);
+      }
+    }
+    old_allocs += g_alloc_num.load() - allocs;
+    WriteAll(fds[0], response);
+    response.clear();
+  }
+  uint64_t old_us = slash::NowMicros() - start;
+
+  BenchConn new_conn(fds[0]);
+  std::string message;  // CmdRes of the thread
+  std::string arena;
+  uint64_t new_allocs = 0;
+  start = slash::NowMicros();
+  for (int i = 0; i < rounds; i++) {
+    uint64_t allocs = g_alloc_num.load();
+    for (int j = 0; j < pipeline; j++) {
+      message.clear();
+      NewFormat(values, array, &message);
+      // CmdRes::AppendMessageTo
+      if (arena.empty() && arena.capacity() < message.size()) {
+        arena.swap(message);
+      } else {
+        arena.append(message);
+      }
+      new_conn.AppendReply(&arena);
+    }
+    new_allocs += g_alloc_num.load() - allocs;
+    while (new_conn.SendReply() == kWriteHalf) {
+    }
+  }
+  uint64_t new_us = slash::NowMicros() - start;
+
+  shutdown(fds[0], SHUT_WR);
+  reader.join();
+  close(fds[0]);
+  close(fds[1]);
+
+  uint64_t replies = static_cast<uint64_t>(rounds) * pipeline;
+  printf("%-28s allocs/reply old %6.2f new %6.2f  "
+         "ns/reply old %6lu new %6lu\n",
+         name, 1.0 * old_allocs / replies, 1.0 * new_allocs / replies,
+         old_us * 1000 / replies, new_us * 1000 / replies);
+}
+
+int main() {
+  Values get(1, std::string(100, 'v'));
+  Values hgetall;
+  for (int i = 0; i < 20; i++) {
+    hgetall.push_back("field" + std::to_string(i));
+    hgetall.push_back(std::string(64, 'v'));
+  }
+  Values zrange;
+  for (int i = 0; i < 50; i++) {
+    zrange.push_back("member:" + std::to_string(100000 + i));
+    zrange.push_back(std::to_string(1.5 * i));
+  }
+
+  Run("GET 100B", get, false, 16, 100000);
+  Run("HGETALL 20 fields", hgetall, true, 16, 20000);
+  Run("ZRANGE 50 WITHSCORES", zrange, true, 16, 10000);
+  return 0;
+}
@@ -6,6 +6,7 @@
 #ifndef PINK_INCLUDE_PINK_CONN_H_
 #define PINK_INCLUDE_PINK_CONN_H_
 
+#include <stdint.h>
 #include <sys/time.h>
 #include <string>
 
@@ -23,6 +24,35 @@ namespace pink {
 
 class Thread;
 
+enum OutputBufferClass {
+  kOutputBufferNormal = 0,
+  kOutputBufferPubSub = 1,
+  kOutputBufferMonitor = 2,
+  kOutputBufferClassNum = 3,
+};
+
+/*
+ * Like client-output-buffer-limit of Redis, a conn is closed when its
+ * unsent replies reach hard_limit bytes, or stay over soft_limit bytes for
+ * soft_seconds. 0 means no limit
+ */
+struct OutputBufferLimit {
+  uint64_t hard_limit;
+  uint64_t soft_limit;
+  int soft_seconds;
+};
+
+extern void SetOutputBufferLimit(OutputBufferClass type,
+                                 const OutputBufferLimit& limit);
+extern OutputBufferLimit GetOutputBufferLimit(OutputBufferClass type);
+
+/*
+ * Worker threads stop reading from a conn while it has this many bytes of
+ * unsent replies, until they are all sent. 0 means never
+ */
+extern void SetOutputBufferPauseLen(uint64_t len);
+extern uint64_t GetOutputBufferPauseLen();
+
 class PinkConn : public std::enable_shared_from_this<PinkConn> {
  public:
   PinkConn(const int fd, const std::string &ip_port, ServerThread *thread, PinkEpoll* pink_epoll = nullptr);
@@ -51,6 +81,32 @@ class PinkConn : public std::enable_shared_from_this<PinkConn> {
 
   virtual void TryResizeBuffer() {}
 
+  /*
+   * Bytes of replies not sent yet, may be called from other threads
+   */
+  virtual uint64_t pending_reply_len() const {
+    return 0;
+  }
+
+  void set_output_buffer_class(OutputBufferClass type) {
+    output_buffer_class_ = type;
+  }
+
+  OutputBufferClass output_buffer_class() const {
+    return output_buffer_class_;
+  }
+
+  /*
+   * Whether pending_reply_len is over the limit of the output buffer class,
+   * the conn should be closed then. Called by the thread owning the conn
+   */
+  bool OutputBufferOverLimit(time_t now);
+
+  // Set by OutputBufferOverLimit, the limit may be hit by waiting only
+  bool over_soft_limit() const {
+    return soft_limit_since_ != 0;
+  }
+
   int flags() const {
     return flags_;
   }
@@ -110,6 +166,9 @@ class PinkConn : public std::enable_shared_from_this<PinkConn> {
   bool is_reply_;
   struct timeval last_interaction_;
   int flags_;
+  OutputBufferClass output_buffer_class_;
+  // Since when pending_reply_len is over the soft limit, 0 if not
+  time_t soft_limit_since_;
 
 #ifdef __ENABLE_SSL
   SSL* ssl_;
@@ -39,7 +39,8 @@ enum NotifyType {
   kNotiClose = 1,
   kNotiEpollout = 2,
   kNotiEpollin = 3,
-  kNotiEpolloutAndEpollin = 4
+  kNotiEpolloutAndEpollin = 4,
+  kNotiTask = 5
 };
 
 enum EventStatus {
@@ -65,6 +66,8 @@ enum ReadStatus {
   kParseError = 5,
   kDealError = 6,
   kOk = 7,
+  // The requests were answered on the worker, the reply is ready to send
+  kReadReplied = 8,
 };
 
 enum WriteStatus {
@@ -90,6 +93,8 @@ enum RetCode {
 #define DEFAULT_WBUF_SIZE 262144 // 256KB
 #define REDIS_INLINE_MAXLEN (1024 * 64) // 64KB
 #define REDIS_IOBUF_LEN 16384 // 16KB
+#define REDIS_REPLY_CHUNK_LEN (1024 * 16) // 16KB
+#define REDIS_WRITEV_IOVCNT 64
 #define REDIS_REQ_INLINE 1
 #define REDIS_REQ_MULTIBULK 2
 
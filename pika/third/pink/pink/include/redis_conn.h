@@ -7,6 +7,8 @@
 #define PINK_INCLUDE_REDIS_CONN_H_
 
 #include <map>
+#include <atomic>
+#include <deque>
 #include <vector>
 #include <string>
 
@@ -19,6 +21,13 @@ namespace pink {
 
 typedef std::vector<std::string> RedisCmdArgsType;
 
+/*
+ * Append "<prefix><num>\r\n" to str, the bulk, multi bulk and integer
+ * headers of num below kRedisSharedHeaderNum come from precomputed tables
+ */
+const int kRedisSharedHeaderNum = 1024;
+void AppendRedisLen(std::string* str, int64_t num, char prefix);
+
 enum HandleType {
   kSynchronous,
   kAsynchronous
@@ -42,15 +51,43 @@ class RedisConn: public PinkConn {
   HandleType GetHandleType();
 
   virtual void SyncProcessRedisCmd(const RedisCmdArgsType& argv, std::string* response);
-  virtual void AsynProcessRedisCmds(const std::vector<RedisCmdArgsType>& argvs, std::string* response);
+  virtual void AsynProcessRedisCmds(std::vector<RedisCmdArgsType>* argvs, std::string* response);
   void NotifyEpoll(bool success);
+  /*
+   * Called by AsynProcessRedisCmds when it answered all the requests
+   * itself, on the worker thread. GetRequest returns kReadReplied then,
+   * and the worker sends the reply at once, no NotifyEpoll is needed.
+   */
+  void SetRepliedInPlace() {
+    replied_in_place_ = true;
+  }
+
+  /*
+   * Queue a reply. A reply of REDIS_REPLY_CHUNK_LEN or more becomes a chunk
+   * of its own without copying, smaller ones are copied into response_,
+   * whose buffer is kept between replies, and SendReply flushes all of
+   * them with writev.
+   * The reply is left empty, keeping its buffer too if it was copied.
+   */
+  void AppendReply(std::string* reply);
+  bool ReplyEmpty() const {
+    return response_.empty() && wchunks_.empty();
+  }
+
+  /*
+   * Replies queued by AppendReply and WriteResp, and not sent yet
+   */
+  uint64_t pending_reply_len() const override {
+    return pending_reply_len_.load(std::memory_order_relaxed);
+  }
 
   virtual int DealMessage(const RedisCmdArgsType& argv, std::string* response) = 0;
 
  private:
   static int ParserDealMessageCb(RedisParser* parser, const RedisCmdArgsType& argv);
-  static int ParserCompleteCb(RedisParser* parser, const std::vector<RedisCmdArgsType>& argvs);
+  static int ParserCompleteCb(RedisParser* parser, std::vector<RedisCmdArgsType>* argvs);
   ReadStatus ParseRedisParserStatus(RedisParserStatus status);
+  void SealResponse();
 
   HandleType handle_type_;
 
@@ -58,8 +95,13 @@ class RedisConn: public PinkConn {
   int rbuf_len_;
   int msg_peak_;
 
+  // Offset of the first unsent byte, in wchunks_.front() or response_
   uint32_t wbuf_pos_;
+  // Reply chunks sent before response_
+  std::deque<std::string> wchunks_;
   std::string response_;
+  std::atomic<uint64_t> pending_reply_len_;
+  bool replied_in_place_;
 
   // For Redis Protocol parser
   int last_read_pos_;
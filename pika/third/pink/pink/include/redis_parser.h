@@ -19,7 +19,8 @@ class RedisParser;
 
 typedef std::vector<std::string> RedisCmdArgsType;
 typedef int (*RedisParserDataCb) (RedisParser*, const RedisCmdArgsType&);
-typedef int (*RedisParserMultiDataCb) (RedisParser*, const std::vector<RedisCmdArgsType>&);
+// The parser drops argvs after Complete returns, callee may take them over
+typedef int (*RedisParserMultiDataCb) (RedisParser*, std::vector<RedisCmdArgsType>*);
 typedef int (*RedisParserCb) (RedisParser*);
 typedef int RedisParserType;
 
@@ -92,6 +93,7 @@ class RedisParser {
 
   int cur_pos_;
   const char* input_buf_;
+  // Owns input_buf_ when the buffer continues a half argv
   std::string input_str_;
   int length_;
 };
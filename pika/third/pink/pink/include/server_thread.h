@@ -141,6 +141,7 @@ class ServerThread : public Thread {
     int fd;
     std::string ip_port;
     struct timeval last_interaction;
+    uint64_t pending_reply_len;
   };
   virtual std::vector<ConnInfo> conns_info() const = 0;
 
@@ -154,6 +155,19 @@ class ServerThread : public Thread {
 
   virtual void SetQueueLimit(int queue_limit) { }
 
+  /*
+   * Let every worker thread own a SO_REUSEPORT listen socket and accept
+   * new connections by itself, set before StartThread, default: false
+   */
+  virtual void set_reuse_port(bool reuse_port) { UNUSED(reuse_port); }
+
+  /*
+   * The number of connections accepted by each worker thread
+   */
+  virtual std::vector<uint64_t> accept_nums() const {
+    return std::vector<uint64_t>();
+  }
+
   virtual ~ServerThread();
 
  protected:
@@ -188,6 +202,11 @@ class ServerThread : public Thread {
 
   virtual int InitHandle();
   virtual void *ThreadMain() override;
+  /*
+   * Accept one connection on listen_fd and check it with AccessHandle,
+   * return the connfd, or -1 if nothing accepted
+   */
+  int AcceptConn(int listen_fd, std::string* ip_port);
   /*
    * The server event handle
    */
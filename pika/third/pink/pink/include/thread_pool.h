@@ -7,7 +7,7 @@
 #define PINK_INCLUDE_THREAD_POOL_H_
 
 #include <string>
-#include <queue>
+#include <vector>
 #include <atomic>
 #include <pthread.h>
 
@@ -25,24 +25,44 @@ struct Task {
      : func(_func), arg(_arg) {}
 };
 
+class TaskQueue;
+
+/*
+ * Every worker owns a bounded lock free task queue, Schedule spreads tasks
+ * over these queues, a worker runs tasks from its own queue first and
+ * steals from the others when it is empty, only one sleeping worker is
+ * woken up for each task.
+ */
 class ThreadPool {
 
  public:
   class Worker {
     public:
-      Worker(ThreadPool* tp, const std::string& name = "ThreadPool:worker")
-        : start_(false),
-          thread_pool_(tp),
-          worker_name_(name) {};
+      Worker(ThreadPool* tp, size_t index, size_t queue_size,
+             const std::string& name = "ThreadPool:worker");
+      ~Worker();
       static void* WorkerMain(void* arg);
 
       int start();
       int stop();
     private:
+      friend class ThreadPool;
+
       pthread_t thread_id_;
       std::atomic<bool> start_;
       ThreadPool* const thread_pool_;
+      const size_t index_;
       std::string worker_name_;
+
+      TaskQueue* queue_;
+      slash::Mutex mu_;
+      slash::CondVar cv_;
+      std::atomic<bool> sleeping_;
+      bool notified_;
+      // Rounds to spin before sleeping, only touched by the worker itself
+      int spin_limit_;
+
+      void Wakeup();
       /*
        * No allowed copy and copy assign
        */
@@ -66,20 +86,29 @@ class ThreadPool {
   uint32_t task_num() { return task_num_; }
 
  private:
-  void runInThread();
+  void runInThread(Worker* worker);
+  bool TryPop(Worker* worker, TaskFunc* func, void** arg);
+  bool HasTask();
+  bool HasRoom();
+  void WakeupOne(size_t hint);
 
   size_t worker_num_;
   size_t max_queue_size_;
   std::string thread_pool_name_;
-  std::queue<Task> queue_;
   std::vector<Worker*> workers_;
   std::atomic<bool> running_;
   std::atomic<bool> should_stop_;
   std::atomic<uint32_t> task_num_;
+  std::atomic<uint32_t> idle_num_;
+  // Queue a Schedule starts from
+  std::atomic<size_t> next_queue_;
 
+  /*
+   * Schedule waits on wsignal_ only when every queue is full
+   */
   slash::Mutex mu_;
-  slash::CondVar rsignal_;
   slash::CondVar wsignal_;
+  std::atomic<uint32_t> wait_num_;
 
   /*
    * No allowed copy and copy assign
@@ -20,7 +20,8 @@ DispatchThread::DispatchThread(int port,
       : ServerThread::ServerThread(port, cron_interval, handle),
         last_thread_(0),
         work_num_(work_num),
-        queue_limit_(queue_limit) {
+        queue_limit_(queue_limit),
+        reuse_port_(false) {
   worker_thread_ = new WorkerThread*[work_num_];
   for (int i = 0; i < work_num_; i++) {
     worker_thread_[i] = new WorkerThread(conn_factory, this, cron_interval);
@@ -34,7 +35,8 @@ DispatchThread::DispatchThread(const std::string &ip, int port,
       : ServerThread::ServerThread(ip, port, cron_interval, handle),
         last_thread_(0),
         work_num_(work_num),
-        queue_limit_(queue_limit) {
+        queue_limit_(queue_limit),
+        reuse_port_(false) {
   worker_thread_ = new WorkerThread*[work_num_];
   for (int i = 0; i < work_num_; i++) {
     worker_thread_[i] = new WorkerThread(conn_factory, this, cron_interval);
@@ -48,7 +50,8 @@ DispatchThread::DispatchThread(const std::set<std::string>& ips, int port,
       : ServerThread::ServerThread(ips, port, cron_interval, handle),
         last_thread_(0),
         work_num_(work_num),
-        queue_limit_(queue_limit) {
+        queue_limit_(queue_limit),
+        reuse_port_(false) {
   worker_thread_ = new WorkerThread*[work_num_];
   for (int i = 0; i < work_num_; i++) {
     worker_thread_[i] = new WorkerThread(conn_factory, this, cron_interval);
@@ -70,6 +73,13 @@ int DispatchThread::StartThread() {
       return ret;
     }
 
+    if (reuse_port_) {
+      ret = worker_thread_[i]->ListenReusePort(ips_, port_);
+      if (ret != kSuccess) {
+        return ret;
+      }
+    }
+
     ret = worker_thread_[i]->StartThread();
     if (ret != 0) {
       return ret;
@@ -101,6 +111,14 @@ int DispatchThread::StopThread() {
   return ServerThread::StopThread();
 }
 
+int DispatchThread::InitHandle() {
+  if (!reuse_port_) {
+    return ServerThread::InitHandle();
+  }
+  pink_epoll_ = new PinkEpoll();
+  return kSuccess;
+}
+
 void DispatchThread::set_keepalive_timeout(int timeout) {
   for (int i = 0; i < work_num_; ++i) {
     worker_thread_[i]->set_keepalive_timeout(timeout);
@@ -127,11 +145,19 @@ std::vector<ServerThread::ConnInfo> DispatchThread::conns_info() const {
   return result;
 }
 
+std::vector<uint64_t> DispatchThread::accept_nums() const {
+  std::vector<uint64_t> result;
+  for (int i = 0; i < work_num_; ++i) {
+    result.push_back(worker_thread_[i]->accept_num());
+  }
+  return result;
+}
+
 std::shared_ptr<PinkConn> DispatchThread::MoveConnOut(int fd) {
+  // Only ask the owner
   for (int i = 0; i < work_num_; ++i) {
-    std::shared_ptr<PinkConn> conn = worker_thread_[i]->MoveConnOut(fd);
-    if (conn != nullptr) {
-      return conn;
+    if (worker_thread_[i]->HasConn(fd)) {
+      return worker_thread_[i]->MoveConnOut(fd);
     }
   }
   return nullptr;
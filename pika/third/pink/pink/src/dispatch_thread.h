@@ -60,6 +60,13 @@ class DispatchThread : public ServerThread {
   void HandleNewConn(const int connfd, const std::string& ip_port) override;
 
   void SetQueueLimit(int queue_limit) override;
+
+  void set_reuse_port(bool reuse_port) override {
+    reuse_port_ = reuse_port;
+  }
+
+  std::vector<uint64_t> accept_nums() const override;
+
  private:
   /*
    * Here we used auto poll to find the next work thread,
@@ -73,6 +80,13 @@ class DispatchThread : public ServerThread {
   WorkerThread** worker_thread_;
   int queue_limit_;
   std::map<WorkerThread*, void*> localdata_;
+  /*
+   * In reuse port mode every worker thread accepts by itself,
+   * the dispatch thread only runs the cron task
+   */
+  bool reuse_port_;
+
+  int InitHandle() override;
 
   void HandleConnEvent(PinkFiredEvent *pfe) override {
     UNUSED(pfe);
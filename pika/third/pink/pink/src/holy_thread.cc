@@ -3,6 +3,8 @@
 // LICENSE file in the root directory of this source tree. An additional grant
 // of patent rights can be found in the PATENTS file in the same directory.
 
+#include <time.h>
+
 #include <vector>
 
 #include "pink/src/holy_thread.h"
@@ -52,7 +54,8 @@ std::vector<ServerThread::ConnInfo> HolyThread::conns_info() const {
     result.push_back({
                       conn.first,
                       conn.second->ip_port(),
-                      conn.second->last_interaction()
+                      conn.second->last_interaction(),
+                      conn.second->pending_reply_len()
                      });
   }
   return result;
@@ -136,9 +139,10 @@ void HolyThread::HandleConnEvent(PinkFiredEvent *pfe) {
     if (write_status == kWriteAll) {
       in_conn->set_is_reply(false);
       pink_epoll_->PinkModEvent(pfe->fd, 0, EPOLLIN);
-    } else if (write_status == kWriteHalf) {
+    } else if (write_status == kWriteHalf
+               && !in_conn->OutputBufferOverLimit(time(nullptr))) {
       return;
-    } else if (write_status == kWriteError) {
+    } else {
       should_close = 1;
     }
   }
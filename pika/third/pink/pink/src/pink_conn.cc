@@ -6,6 +6,8 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include <atomic>
+
 #include "slash/include/xdebug.h"
 #include "pink/include/pink_conn.h"
 #include "pink/include/pink_thread.h"
@@ -13,6 +15,34 @@
 
 namespace pink {
 
+static std::atomic<uint64_t> output_hard_limit[kOutputBufferClassNum];
+static std::atomic<uint64_t> output_soft_limit[kOutputBufferClassNum];
+static std::atomic<int> output_soft_seconds[kOutputBufferClassNum];
+static std::atomic<uint64_t> output_pause_len(0);
+
+void SetOutputBufferLimit(OutputBufferClass type,
+                          const OutputBufferLimit& limit) {
+  output_hard_limit[type] = limit.hard_limit;
+  output_soft_limit[type] = limit.soft_limit;
+  output_soft_seconds[type] = limit.soft_seconds;
+}
+
+OutputBufferLimit GetOutputBufferLimit(OutputBufferClass type) {
+  OutputBufferLimit limit;
+  limit.hard_limit = output_hard_limit[type];
+  limit.soft_limit = output_soft_limit[type];
+  limit.soft_seconds = output_soft_seconds[type];
+  return limit;
+}
+
+void SetOutputBufferPauseLen(uint64_t len) {
+  output_pause_len = len;
+}
+
+uint64_t GetOutputBufferPauseLen() {
+  return output_pause_len;
+}
+
 PinkConn::PinkConn(const int fd,
                    const std::string &ip_port,
                    ServerThread *thread,
@@ -20,6 +50,8 @@ PinkConn::PinkConn(const int fd,
     : fd_(fd),
       ip_port_(ip_port),
       is_reply_(false),
+      output_buffer_class_(kOutputBufferNormal),
+      soft_limit_since_(0),
 #ifdef __ENABLE_SSL
       ssl_(nullptr),
 #endif
@@ -35,6 +67,26 @@ PinkConn::~PinkConn() {
 #endif
 }
 
+bool PinkConn::OutputBufferOverLimit(time_t now) {
+  uint64_t len = pending_reply_len();
+  if (len == 0) {
+    soft_limit_since_ = 0;
+    return false;
+  }
+  OutputBufferLimit limit = GetOutputBufferLimit(output_buffer_class_);
+  if (limit.hard_limit > 0 && len >= limit.hard_limit) {
+    return true;
+  }
+  if (limit.soft_limit == 0 || len < limit.soft_limit) {
+    soft_limit_since_ = 0;
+    return false;
+  }
+  if (soft_limit_since_ == 0) {
+    soft_limit_since_ = now;
+  }
+  return now - soft_limit_since_ >= limit.soft_seconds;
+}
+
 bool PinkConn::SetNonblock() {
   flags_ = Setnonblocking(fd());
   if (flags_ == -1) {
@@ -7,6 +7,7 @@
 #define PINK_SRC_PINK_ITEM_H_
 
 #include <string>
+#include <functional>
 
 #include "pink/include/pink_define.h"
 
@@ -20,6 +21,14 @@ class PinkItem {
         ip_port_(ip_port),
         notify_type_(type) {
   }
+  /*
+   * A task to run in the thread owning the epoll
+   */
+  explicit PinkItem(const std::function<void()>& task)
+      : fd_(-1),
+        notify_type_(kNotiTask),
+        task_(task) {
+  }
 
   int fd() const {
     return fd_;
@@ -32,10 +41,15 @@ class PinkItem {
     return notify_type_;
   }
 
+  const std::function<void()>& task() const {
+    return task_;
+  }
+
  private:
   int fd_;
   std::string ip_port_;
   NotifyType notify_type_;
+  std::function<void()> task_;
 };
 
 }  // namespace pink
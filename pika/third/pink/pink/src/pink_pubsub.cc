@@ -3,6 +3,8 @@
 // LICENSE file in the root directory of this source tree. An additional grant
 // of patent rights can be found in the PATENTS file in the same directory.
 
+#include <time.h>
+
 #include <vector>
 #include <algorithm>
 #include <sstream>
@@ -76,6 +78,7 @@ void PubSubThread::MoveConnIn(std::shared_ptr<PinkConn> conn) {
     conns_[conn->fd()] = conn;
   }
   conn->set_pink_epoll(pink_epoll_);
+  conn->set_output_buffer_class(kOutputBufferPubSub);
   pink_epoll_->PinkAddEvent(conn->fd(), EPOLLIN | EPOLLERR | EPOLLHUP);
 }
 
@@ -383,6 +386,7 @@ void *PubSubThread::ThreadMain() {
           read(msg_pfd_[0], triger, 1);
           std::string channel, msg;
           int32_t receivers = 0;
+          time_t now = time(nullptr);
           channel = channel_;
           msg = message_;
           channel_.clear();
@@ -398,6 +402,10 @@ void *PubSubThread::ThreadMain() {
                 it->second[i]->WriteResp(resp);
                 WriteStatus write_status = it->second[i]->SendReply();
                   it->second[i]->RespUnlock();
+                if (write_status == kWriteHalf
+                    && it->second[i]->OutputBufferOverLimit(now)) {
+                  write_status = kWriteError;
+                }
                 if (write_status == kWriteHalf) {
                   pink_epoll_->PinkModEvent(it->second[i]->fd(),
                                             EPOLLIN, EPOLLOUT);
@@ -425,6 +433,10 @@ void *PubSubThread::ThreadMain() {
                 it->second[i]->WriteResp(resp);
                 WriteStatus write_status = it->second[i]->SendReply();
                   it->second[i]->RespUnlock();
+                if (write_status == kWriteHalf
+                    && it->second[i]->OutputBufferOverLimit(now)) {
+                  write_status = kWriteError;
+                }
                 if (write_status == kWriteHalf) {
                   pink_epoll_->PinkModEvent(it->second[i]->fd(),
                                             EPOLLIN, EPOLLOUT);
@@ -470,6 +482,9 @@ void *PubSubThread::ThreadMain() {
           if (write_status == kWriteAll) {
             in_conn->set_is_reply(false);
             pink_epoll_->PinkModEvent(pfe->fd, 0, EPOLLIN);  // Remove EPOLLOUT
+          } else if (write_status == kWriteHalf
+                     && in_conn->OutputBufferOverLimit(time(nullptr))) {
+            should_close = 1;
           } else if (write_status == kWriteHalf) {
             continue;  //  send all write buffer,
                        //  in case of next GetRequest()
@@ -5,8 +5,10 @@
 
 #include "pink/include/redis_conn.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <sys/uio.h>
 
 #include <string>
 #include <sstream>
@@ -16,6 +18,65 @@
 
 namespace pink {
 
+class RedisHeaderTable {
+ public:
+  explicit RedisHeaderTable(char prefix) {
+    for (int i = 0; i < kRedisSharedHeaderNum; i++) {
+      headers_[i].len = snprintf(headers_[i].data, sizeof(headers_[i].data),
+                                 "%c%d\r\n", prefix, i);
+    }
+  }
+
+  void Append(std::string* str, int64_t num) const {
+    str->append(headers_[num].data, headers_[num].len);
+  }
+
+ private:
+  struct Header {
+    char data[8];  // "$1023\r\n" and the terminating null
+    int len;
+  };
+  Header headers_[kRedisSharedHeaderNum];
+};
+
+static const RedisHeaderTable kBulkHeaders('$');
+static const RedisHeaderTable kMultiBulkHeaders('*');
+static const RedisHeaderTable kIntegerHeaders(':');
+
+void AppendRedisLen(std::string* str, int64_t num, char prefix) {
+  if (num >= 0 && num < kRedisSharedHeaderNum) {
+    switch (prefix) {
+      case '$':
+        kBulkHeaders.Append(str, num);
+        return;
+      case '*':
+        kMultiBulkHeaders.Append(str, num);
+        return;
+      case ':':
+        kIntegerHeaders.Append(str, num);
+        return;
+      default:
+        break;
+    }
+  }
+  // Digits are written backward from the end of buf
+  char buf[24];
+  char* end = buf + sizeof(buf);
+  char* p = end;
+  *--p = '\n';
+  *--p = '\r';
+  uint64_t value = num < 0 ? -static_cast<uint64_t>(num) : num;
+  do {
+    *--p = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  if (num < 0) {
+    *--p = '-';
+  }
+  *--p = prefix;
+  str->append(p, end - p);
+}
+
 RedisConn::RedisConn(const int fd,
                      const std::string& ip_port,
                      ServerThread* thread,
@@ -27,6 +88,8 @@ RedisConn::RedisConn(const int fd,
       rbuf_len_(0),
       msg_peak_(0),
       wbuf_pos_(0),
+      pending_reply_len_(0),
+      replied_in_place_(false),
       last_read_pos_(-1),
       bulk_len_(-1) {
   RedisParserSettings settings;
@@ -118,32 +181,68 @@ ReadStatus RedisConn::GetRequest() {
     last_read_pos_ = -1;
     bulk_len_ = redis_parser_.get_bulk_len();
   }
-  if (!response_.empty()) {
+  if (!ReplyEmpty()) {
     set_is_reply(true);
   }
-  return read_status; // OK || HALF || FULL_ERROR || PARSE_ERROR
+  if (replied_in_place_) {
+    replied_in_place_ = false;
+    if (read_status == kReadAll) {
+      read_status = kReadReplied;
+    }
+  }
+  return read_status; // OK || HALF || REPLIED || FULL_ERROR || PARSE_ERROR
 }
 
 WriteStatus RedisConn::SendReply() {
   ssize_t nwritten = 0;
-  size_t wbuf_len = response_.size();
-  while (wbuf_len > 0) {
-    nwritten = write(fd(), response_.data() + wbuf_pos_, wbuf_len - wbuf_pos_);
+  struct iovec iov[REDIS_WRITEV_IOVCNT];
+  while (!ReplyEmpty()) {
+    int iovcnt = 0;
+    size_t pos = wbuf_pos_;
+    for (std::deque<std::string>::iterator it = wchunks_.begin();
+         it != wchunks_.end() && iovcnt < REDIS_WRITEV_IOVCNT; ++it) {
+      iov[iovcnt].iov_base = const_cast<char*>(it->data()) + pos;
+      iov[iovcnt].iov_len = it->size() - pos;
+      iovcnt++;
+      pos = 0;
+    }
+    if (iovcnt < REDIS_WRITEV_IOVCNT && !response_.empty()) {
+      iov[iovcnt].iov_base = const_cast<char*>(response_.data()) + pos;
+      iov[iovcnt].iov_len = response_.size() - pos;
+      iovcnt++;
+    }
+
+    nwritten = writev(fd(), iov, iovcnt);
     if (nwritten <= 0) {
       break;
     }
-    wbuf_pos_ += nwritten;
-    if (wbuf_pos_ == wbuf_len) {
-      // Have sended all response data
-      if (wbuf_len > DEFAULT_WBUF_SIZE) {
-        std::string buf;
-        buf.reserve(DEFAULT_WBUF_SIZE);
-        response_.swap(buf);
-      }
-      response_.clear();
 
-      wbuf_len = 0;
+    uint64_t pending = pending_reply_len_.load(std::memory_order_relaxed);
+    pending_reply_len_.store(pending > static_cast<uint64_t>(nwritten)
+                             ? pending - nwritten : 0,
+                             std::memory_order_relaxed);
+
+    // Drop what have been sent
+    size_t left = nwritten;
+    while (left > 0) {
+      std::string& front = wchunks_.empty() ? response_ : wchunks_.front();
+      size_t remain = front.size() - wbuf_pos_;
+      if (left < remain) {
+        wbuf_pos_ += left;
+        break;
+      }
+      left -= remain;
       wbuf_pos_ = 0;
+      if (!wchunks_.empty()) {
+        wchunks_.pop_front();
+      } else {
+        if (response_.size() > DEFAULT_WBUF_SIZE) {
+          std::string buf;
+          buf.reserve(DEFAULT_WBUF_SIZE);
+          response_.swap(buf);
+        }
+        response_.clear();
+      }
     }
   }
   if (nwritten == -1) {
@@ -154,14 +253,46 @@ WriteStatus RedisConn::SendReply() {
       return kWriteError;
     }
   }
-  if (wbuf_len == 0) {
+  if (ReplyEmpty()) {
+    pending_reply_len_.store(0, std::memory_order_relaxed);
     return kWriteAll;
   } else {
     return kWriteHalf;
   }
 }
 
+void RedisConn::AppendReply(std::string* reply) {
+  if (reply->empty()) {
+    return;
+  }
+  pending_reply_len_.fetch_add(reply->size(), std::memory_order_relaxed);
+  if (reply->size() >= REDIS_REPLY_CHUNK_LEN
+      || response_.size() + reply->size() > REDIS_REPLY_CHUNK_LEN) {
+    SealResponse();
+  }
+  if (reply->size() >= REDIS_REPLY_CHUNK_LEN) {
+    wchunks_.push_back(std::move(*reply));
+    reply->clear();
+  } else {
+    response_.append(*reply);
+    reply->clear();
+  }
+}
+
+void RedisConn::SealResponse() {
+  if (response_.empty()) {
+    return;
+  }
+  // wbuf_pos_ still refers to the same bytes if response_ becomes the
+  // first chunk
+  wchunks_.push_back(std::string());
+  wchunks_.back().swap(response_);
+  // The replies following a full chunk likely fill one too
+  response_.reserve(REDIS_REPLY_CHUNK_LEN);
+}
+
 void RedisConn::WriteResp(const std::string& resp) {
+  pending_reply_len_.fetch_add(resp.size(), std::memory_order_relaxed);
   response_.append(resp);
   set_is_reply(true);
 }
@@ -198,7 +329,7 @@ void RedisConn::SyncProcessRedisCmd(const RedisCmdArgsType& argv, std::string* r
   // you need to implement this method yourself
 }
 
-void RedisConn::AsynProcessRedisCmds(const std::vector<RedisCmdArgsType>& argvs, std::string* response) {
+void RedisConn::AsynProcessRedisCmds(std::vector<RedisCmdArgsType>* argvs, std::string* response) {
   // If the current HandleType is kAsynchronous
   // you need to implement this method yourself
 }
@@ -220,7 +351,7 @@ int RedisConn::ParserDealMessageCb(RedisParser* parser, const RedisCmdArgsType&
   return 0;
 }
 
-int RedisConn::ParserCompleteCb(RedisParser* parser, const std::vector<RedisCmdArgsType>& argvs) {
+int RedisConn::ParserCompleteCb(RedisParser* parser, std::vector<RedisCmdArgsType>* argvs) {
   RedisConn* conn = reinterpret_cast<RedisConn*>(parser->data);
   if (conn->GetHandleType() == HandleType::kAsynchronous) {
     conn->AsynProcessRedisCmds(argvs, &(conn->response_));
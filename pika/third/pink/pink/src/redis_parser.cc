@@ -179,8 +179,14 @@ void RedisParser::SetParserStatus(RedisParserStatus status,
 }
 
 void RedisParser::CacheHalfArgv() {
-  std::string tmp(input_buf_ + cur_pos_, length_ - cur_pos_);
-  half_argv_ = tmp;
+  if (input_buf_ == input_str_.data()) {
+    // Keep the buffer, a big bulk arrives in many reads and should not be
+    // copied over and over again
+    input_str_.erase(0, cur_pos_);
+    half_argv_.swap(input_str_);
+  } else {
+    half_argv_.assign(input_buf_ + cur_pos_, length_ - cur_pos_);
+  }
   cur_pos_ = length_;
 }
 
@@ -274,6 +280,19 @@ RedisParserStatus RedisParser::ProcessMultibulkBuffer() {
     if ((length_ - 1) - cur_pos_ + 1 < bulk_len_ + 2) {
       // Data not enough
       break;
+    } else if (bulk_len_ >= REDIS_MBULK_BIG_ARG
+               && input_buf_ == input_str_.data()
+               && cur_pos_ == 0 && length_ == bulk_len_ + 2) {
+      // The cached buffer holds exactly this big argument, hand it over
+      // instead of copying
+      input_str_.resize(bulk_len_);
+      argv_.push_back(std::move(input_str_));
+      input_str_.clear();
+      input_buf_ = input_str_.data();
+      cur_pos_ = 0;
+      length_ = 0;
+      bulk_len_ = -1;
+      multibulk_len_--;
     } else {
       argv_.emplace_back(input_buf_ + cur_pos_, bulk_len_);
       cur_pos_ = cur_pos_ + bulk_len_ + 2;
@@ -312,11 +331,17 @@ RedisParserStatus RedisParser::ProcessInputBuffer(
   if (status_code_ == kRedisParserInitDone ||
       status_code_ == kRedisParserHalf ||
       status_code_ == kRedisParserDone) {
-    // TODO AZ: avoid copy
-    std::string tmp_str(input_buf, length);
-    input_str_ = half_argv_ + tmp_str;
-    input_buf_ = input_str_.c_str();
-    length_ = length + half_argv_.size();
+    if (half_argv_.empty()) {
+      // Parse on the caller's buffer directly
+      input_buf_ = input_buf;
+      length_ = length;
+    } else {
+      half_argv_.append(input_buf, length);
+      input_str_.swap(half_argv_);
+      half_argv_.clear();
+      input_buf_ = input_str_.data();
+      length_ = input_str_.size();
+    }
     if (redis_parser_type_ == REDIS_PARSER_REQUEST) {
       ProcessRequestBuffer();
     } else if (redis_parser_type_ == REDIS_PARSER_RESPONSE) {
@@ -367,20 +392,20 @@ RedisParserStatus RedisParser::ProcessRequestBuffer() {
       return kRedisParserError;
     }
     if (!argv_.empty()) {
-      argvs_.push_back(argv_);
       if (parser_settings_.DealMessage) {
         if (parser_settings_.DealMessage(this, argv_) != 0) {
           SetParserStatus(kRedisParserError, kRedisParserDealError);
           return status_code_;
         }
       }
+      argvs_.push_back(std::move(argv_));
     }
     argv_.clear();
     // Reset
     ResetCommandStatus();
   }
   if (parser_settings_.Complete && !argvs_.empty()) {
-    if (parser_settings_.Complete(this, argvs_) != 0) {
+    if (parser_settings_.Complete(this, &argvs_) != 0) {
       SetParserStatus(kRedisParserError, kRedisParserCompleteError);
       return status_code_;
     }
@@ -399,7 +424,11 @@ void RedisParser::ResetCommandStatus() {
 void RedisParser::ResetRedisParser() {
   cur_pos_ = 0;
   input_buf_ = NULL;
-  input_str_.clear();
+  if (input_str_.capacity() > REDIS_MBULK_BIG_ARG) {
+    std::string().swap(input_str_);
+  } else {
+    input_str_.clear();
+  }
   length_ = 0;
 }
 
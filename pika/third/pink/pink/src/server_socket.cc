@@ -28,6 +28,7 @@ ServerSocket::ServerSocket(int port, bool is_block)
       tcp_send_buffer_(0),
       tcp_recv_buffer_(0),
       keep_alive_(false),
+      reuse_port_(false),
       listening_(false),
   is_block_(is_block) {
 }
@@ -51,6 +52,13 @@ int ServerSocket::Listen(const std::string &bind_ip) {
     return kSetSockOptError;
   }
 
+  if (reuse_port_) {
+    ret = setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes));
+    if (ret < 0) {
+      return kSetSockOptError;
+    }
+  }
+
   servaddr_.sin_family = AF_INET;
   if (bind_ip.empty()) {
     servaddr_.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -161,8 +161,6 @@ void *ServerThread::ThreadMain() {
   int nfds;
   PinkFiredEvent *pfe;
   Status s;
-  struct sockaddr_in cliaddr;
-  socklen_t clilen = sizeof(struct sockaddr);
   int fd, connfd;
 
   struct timeval when;
@@ -177,8 +175,6 @@ void *ServerThread::ThreadMain() {
   }
 
   std::string ip_port;
-  char port_buf[32];
-  char ip_addr[INET_ADDRSTRLEN] = "";
 
   while (!should_stop()) {
     if (cron_interval_ > 0) {
@@ -207,36 +203,11 @@ void *ServerThread::ThreadMain() {
        */
       if (server_fds_.find(fd) != server_fds_.end()) {
         if (pfe->mask & EPOLLIN) {
-          connfd = accept(fd, (struct sockaddr *) &cliaddr, &clilen);
-          if (connfd == -1) {
-            log_warn("accept error, errno numberis %d, error reason %s",
-                     errno, strerror(errno));
-            continue;
-          }
-          fcntl(connfd, F_SETFD, fcntl(connfd, F_GETFD) | FD_CLOEXEC);
-
-          // not use nagel to avoid tcp 40ms delay
-          if (SetTcpNoDelay(connfd) == -1) {
-            log_warn("setsockopt error, errno numberis %d, error reason %s",
-                     errno, strerror(errno));
-            close(connfd);
-            continue;
-          }
-          
-          // Just ip
-          ip_port =
-            inet_ntop(AF_INET, &cliaddr.sin_addr, ip_addr, sizeof(ip_addr));
-
-          if (!handle_->AccessHandle(ip_port) ||
-              !handle_->AccessHandle(connfd, ip_port)) {
-            close(connfd);
+          connfd = AcceptConn(fd, &ip_port);
+          if (connfd < 0) {
             continue;
           }
 
-          ip_port.append(":");
-          snprintf(port_buf, sizeof(port_buf), "%d", ntohs(cliaddr.sin_port));
-          ip_port.append(port_buf);
-
           /*
            * Handle new connection,
            * implemented in derived class
@@ -272,6 +243,47 @@ void *ServerThread::ThreadMain() {
   return nullptr;
 }
 
+int ServerThread::AcceptConn(int listen_fd, std::string* ip_port) {
+  struct sockaddr_in cliaddr;
+  socklen_t clilen = sizeof(struct sockaddr);
+  char port_buf[32];
+  char ip_addr[INET_ADDRSTRLEN] = "";
+
+  int connfd = accept(listen_fd, (struct sockaddr *) &cliaddr, &clilen);
+  if (connfd == -1) {
+    // Another acceptor may have taken it
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      log_warn("accept error, errno numberis %d, error reason %s",
+               errno, strerror(errno));
+    }
+    return -1;
+  }
+  fcntl(connfd, F_SETFD, fcntl(connfd, F_GETFD) | FD_CLOEXEC);
+
+  // not use nagel to avoid tcp 40ms delay
+  if (SetTcpNoDelay(connfd) == -1) {
+    log_warn("setsockopt error, errno numberis %d, error reason %s",
+             errno, strerror(errno));
+    close(connfd);
+    return -1;
+  }
+
+  // Just ip
+  *ip_port =
+    inet_ntop(AF_INET, &cliaddr.sin_addr, ip_addr, sizeof(ip_addr));
+
+  if (!handle_->AccessHandle(*ip_port) ||
+      !handle_->AccessHandle(connfd, *ip_port)) {
+    close(connfd);
+    return -1;
+  }
+
+  ip_port->append(":");
+  snprintf(port_buf, sizeof(port_buf), "%d", ntohs(cliaddr.sin_port));
+  ip_port->append(port_buf);
+  return connfd;
+}
+
 #ifdef __ENABLE_SSL
 static std::vector<std::unique_ptr<slash::Mutex>> ssl_mutex_;
 
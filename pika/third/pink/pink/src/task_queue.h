@@ -0,0 +1,145 @@
+// Copyright (c) 2018-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef PINK_SRC_TASK_QUEUE_H_
+#define PINK_SRC_TASK_QUEUE_H_
+
+#include <atomic>
+#include <vector>
+
+#include "pink/include/thread_pool.h"
+
+namespace pink {
+
+/*
+ * Bounded lock free MPMC queue, every slot carries a sequence number
+ * telling producers and consumers whose turn it is.
+ * Used as the per worker queue of ThreadPool: any thread may push,
+ * the owner worker pops and idle workers steal from it.
+ * The ring is rounded up to a power of two, but holds no more than
+ * capacity tasks.
+ */
+class TaskQueue {
+ public:
+  explicit TaskQueue(size_t capacity)
+      : capacity_(capacity),
+        mask_(RoundUpPowerOfTwo(capacity) - 1),
+        slots_(mask_ + 1),
+        enqueue_pos_(0),
+        dequeue_pos_(0) {
+    for (size_t i = 0; i <= mask_; ++i) {
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /*
+   * Return false if the queue is full
+   */
+  bool TryPush(TaskFunc func, void* arg) {
+    Slot* slot;
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      slot = &slots_[pos & mask_];
+      size_t seq = slot->seq.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        // A stale dequeue_pos_ only makes us see the queue fuller, a stale
+        // pos fails the CAS below
+        size_t head = dequeue_pos_.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(pos - head)
+            >= static_cast<intptr_t>(capacity_)) {
+          return false;
+        }
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->func = func;
+    slot->arg = arg;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /*
+   * Return false if the queue is empty
+   */
+  bool TryPop(TaskFunc* func, void** arg) {
+    Slot* slot;
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      slot = &slots_[pos & mask_];
+      size_t seq = slot->seq.load(std::memory_order_acquire);
+      intptr_t diff =
+        static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    *func = slot->func;
+    *arg = slot->arg;
+    slot->seq.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Full() const {
+    // Head first, the tail read later is never behind it
+    size_t head = dequeue_pos_.load(std::memory_order_acquire);
+    return enqueue_pos_.load(std::memory_order_acquire) - head >= capacity_;
+  }
+
+  bool Empty() const {
+    return enqueue_pos_.load(std::memory_order_acquire) ==
+      dequeue_pos_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static size_t RoundUpPowerOfTwo(size_t n) {
+    size_t v = 2;
+    while (v < n) {
+      v <<= 1;
+    }
+    return v;
+  }
+
+  struct Slot {
+    std::atomic<size_t> seq;
+    TaskFunc func;
+    void* arg;
+  };
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::vector<Slot> slots_;
+
+  // Keep producers and consumers on different cache lines
+  char pad0_[64];
+  std::atomic<size_t> enqueue_pos_;
+  char pad1_[64];
+  std::atomic<size_t> dequeue_pos_;
+  char pad2_[64];
+
+  /*
+   * No allowed copy and copy assign
+   */
+  TaskQueue(const TaskQueue&);
+  void operator=(const TaskQueue&);
+};
+
+}  // namespace pink
+
+#endif  // PINK_SRC_TASK_QUEUE_H_
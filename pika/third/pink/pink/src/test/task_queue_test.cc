@@ -0,0 +1,138 @@
+// Copyright (c) 2018-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+#include "pink/src/task_queue.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "pink/include/thread_pool.h"
+
+using pink::TaskQueue;
+using pink::ThreadPool;
+
+static const size_t kProducers = 4;
+static const size_t kConsumers = 4;
+static const size_t kPerProducer = 200000;
+static const size_t kTotal = kProducers * kPerProducer;
+
+static void Noop(void*) {
+}
+
+static void* Value(size_t v) {
+  return reinterpret_cast<void*>(static_cast<uintptr_t>(v));
+}
+
+TEST(TaskQueueTest, Capacity) {
+  // The ring is 4 slots, 3 of them usable
+  TaskQueue queue(3);
+  EXPECT_TRUE(queue.Empty());
+  for (size_t i = 0; i < 3; i++) {
+    EXPECT_TRUE(queue.TryPush(&Noop, Value(i)));
+  }
+  EXPECT_TRUE(queue.Full());
+  EXPECT_FALSE(queue.TryPush(&Noop, Value(3)));
+
+  pink::TaskFunc func;
+  void* arg;
+  for (size_t i = 0; i < 3; i++) {
+    ASSERT_TRUE(queue.TryPop(&func, &arg));
+    EXPECT_EQ(&Noop, func);
+    EXPECT_EQ(Value(i), arg);
+  }
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_FALSE(queue.TryPop(&func, &arg));
+}
+
+TEST(TaskQueueTest, CapacityOne) {
+  TaskQueue queue(1);
+  pink::TaskFunc func;
+  void* arg;
+  for (size_t i = 0; i < 10; i++) {
+    EXPECT_TRUE(queue.TryPush(&Noop, Value(i)));
+    EXPECT_FALSE(queue.TryPush(&Noop, Value(i)));
+    ASSERT_TRUE(queue.TryPop(&func, &arg));
+    EXPECT_EQ(Value(i), arg);
+  }
+}
+
+TEST(TaskQueueTest, MultiProducerMultiConsumer) {
+  // Small, so the producers keep finding it full
+  TaskQueue queue(64);
+
+  std::vector<std::atomic<int> > seen(kTotal);
+  for (auto& s : seen) {
+    s.store(0);
+  }
+  std::atomic<size_t> popped(0);
+
+  std::vector<std::thread> threads;
+  for (size_t p = 0; p < kProducers; p++) {
+    threads.emplace_back([&queue, p]() {
+      for (size_t i = 0; i < kPerProducer; i++) {
+        while (!queue.TryPush(&Noop, Value(p * kPerProducer + i))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (size_t c = 0; c < kConsumers; c++) {
+    threads.emplace_back([&queue, &seen, &popped]() {
+      pink::TaskFunc func;
+      void* arg;
+      // Values of one producer come out in the order it pushed them
+      std::vector<size_t> last(kProducers, 0);
+      std::vector<bool> any(kProducers, false);
+      while (popped.load() < kTotal) {
+        if (!queue.TryPop(&func, &arg)) {
+          std::this_thread::yield();
+          continue;
+        }
+        size_t v = reinterpret_cast<uintptr_t>(arg);
+        ASSERT_LT(v, kTotal);
+        size_t p = v / kPerProducer;
+        if (any[p]) {
+          EXPECT_LT(last[p], v);
+        }
+        any[p] = true;
+        last[p] = v;
+        seen[v]++;
+        popped++;
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(kTotal, popped.load());
+  EXPECT_TRUE(queue.Empty());
+  for (size_t i = 0; i < kTotal; i++) {
+    ASSERT_EQ(1, seen[i].load()) << "value " << i;
+  }
+}
+
+static void Count(void* arg) {
+  (*static_cast<std::atomic<int>*>(arg))++;
+}
+
+TEST(TaskQueueTest, PoolSmallerThanWorkers) {
+  // A queue of each worker gets one slot at least, Schedule would wait
+  // forever on queues of none
+  ThreadPool pool(4, 0);
+  ASSERT_EQ(0, pool.start_thread_pool());
+  std::atomic<int> count(0);
+  for (int i = 0; i < 10000; i++) {
+    pool.Schedule(&Count, &count);
+  }
+  while (pool.task_num() > 0) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(0, pool.stop_thread_pool());
+  EXPECT_EQ(10000, count.load());
+}
@@ -0,0 +1,206 @@
+// Copyright (c) 2018-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+#include "pink/src/timer_wheel.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using pink::TimerWheel;
+
+// Ticks spanned by a slot of each level, 64 slots a level, 4 levels
+static const uint64_t kLevelTicks[] = {1, 64, 64 * 64, 64 * 64 * 64};
+static const uint64_t kMaxTicks = 64ULL * 64 * 64 * 64;
+
+// The values expired by moving the wheel to now
+template <typename T>
+static std::vector<T> AdvanceTo(TimerWheel<T>* wheel, uint64_t now) {
+  std::vector<T> expired;
+  wheel->Advance(now, &expired);
+  return expired;
+}
+
+TEST(TimerWheelTest, ExpireAtTick) {
+  // Ticks of 10ms, a timer expires at the first tick not before it
+  TimerWheel<int> wheel(10, 1000);
+  wheel.Add(1005, 1);
+  wheel.Add(1010, 2);
+  wheel.Add(1011, 3);
+  EXPECT_EQ(3u, wheel.size());
+
+  EXPECT_TRUE(AdvanceTo(&wheel, 1009).empty());
+  EXPECT_EQ(std::vector<int>({1, 2}), AdvanceTo(&wheel, 1010));
+  EXPECT_TRUE(AdvanceTo(&wheel, 1019).empty());
+  EXPECT_EQ(std::vector<int>({3}), AdvanceTo(&wheel, 1020));
+  EXPECT_EQ(0u, wheel.size());
+}
+
+TEST(TimerWheelTest, PastTimerExpiresOnNextTick) {
+  TimerWheel<int> wheel(10, 1000);
+  wheel.Add(0, 1);
+  wheel.Add(1000, 2);
+  // Still the same tick
+  EXPECT_TRUE(AdvanceTo(&wheel, 1009).empty());
+  EXPECT_EQ(std::vector<int>({1, 2}), AdvanceTo(&wheel, 1010));
+}
+
+TEST(TimerWheelTest, CascadeBetweenLevels) {
+  // Start in the middle of the slots of every level, so the timers are
+  // moved down by the cascades of partly passed slots
+  const uint64_t start = kLevelTicks[3] + kLevelTicks[2] * 5
+                         + kLevelTicks[1] * 7 + 13;
+  TimerWheel<uint64_t> wheel(1, start);
+  std::vector<uint64_t> deltas;
+  for (int level = 1; level < 4; level++) {
+    uint64_t span = kLevelTicks[level] * 64;
+    for (uint64_t d : {kLevelTicks[level] - 1, kLevelTicks[level],
+                       kLevelTicks[level] + 1, span - 1}) {
+      deltas.push_back(d);
+    }
+  }
+  for (uint64_t d : deltas) {
+    wheel.Add(start + d, start + d);
+  }
+  std::sort(deltas.begin(), deltas.end());
+  deltas.erase(std::unique(deltas.begin(), deltas.end()), deltas.end());
+
+  // Each timer expires exactly at its tick, not a tick earlier
+  uint64_t now = start;
+  for (uint64_t d : deltas) {
+    EXPECT_TRUE(AdvanceTo(&wheel, start + d - 1).empty()) << "delta " << d;
+    std::vector<uint64_t> expired = AdvanceTo(&wheel, start + d);
+    ASSERT_FALSE(expired.empty()) << "delta " << d;
+    for (uint64_t when : expired) {
+      EXPECT_EQ(start + d, when);
+    }
+    now = start + d;
+  }
+  EXPECT_EQ(0u, wheel.size());
+  EXPECT_TRUE(AdvanceTo(&wheel, now + kMaxTicks).empty());
+}
+
+TEST(TimerWheelTest, CascadeRandom) {
+  // Against the expiry computed directly, with timers on all levels and
+  // advances of any length
+  srand(301);
+  const uint64_t tick = 7;
+  uint64_t now = 123456789;
+  TimerWheel<int> wheel(tick, now);
+  std::map<int, uint64_t> pending;
+  int next_id = 0;
+  for (int round = 0; round < 1000; round++) {
+    for (int i = rand() % 4; i > 0; i--) {
+      int level = rand() % 4;
+      uint64_t when = now + rand() % (kLevelTicks[level] * 64 * tick);
+      wheel.Add(when, next_id);
+      pending[next_id++] = (when + tick - 1) / tick;
+    }
+    // Mostly short steps, now and then over many slots of a level
+    now += rand() % 8 == 0 ? rand() % (kLevelTicks[rand() % 3] * 64 * tick)
+                           : rand() % (8 * tick);
+    std::vector<int> expired = AdvanceTo(&wheel, now);
+    for (int id : expired) {
+      ASSERT_TRUE(pending.count(id)) << "expired twice " << id;
+      EXPECT_LE(pending[id], now / tick) << "early " << id;
+      pending.erase(id);
+    }
+    for (const auto& timer : pending) {
+      ASSERT_GT(timer.second, now / tick) << "late " << timer.first;
+    }
+    ASSERT_EQ(pending.size(), wheel.size());
+  }
+}
+
+TEST(TimerWheelTest, ClampFarTimers) {
+  TimerWheel<int> wheel(1, 1000);
+  wheel.Add(1000 + 10 * kMaxTicks, 1);
+  EXPECT_TRUE(AdvanceTo(&wheel, 1000 + kMaxTicks - 2).empty());
+  EXPECT_EQ(std::vector<int>({1}), AdvanceTo(&wheel, 1000 + kMaxTicks - 1));
+}
+
+TEST(TimerWheelTest, Rearm) {
+  // As the cron of a worker does, arm the timer again when it expires
+  const uint64_t period = 250;
+  TimerWheel<int> wheel(10, 0);
+  wheel.Add(period, 1);
+  wheel.Add(period * 20, 2);
+  int fired = 0;
+  for (uint64_t now = 0; now <= period * 100; now += 30) {
+    for (int value : AdvanceTo(&wheel, now)) {
+      if (value == 1) {
+        fired++;
+        wheel.Add(now + period, 1);
+      }
+    }
+    EXPECT_GE(wheel.size(), 1u);
+  }
+  // Once in every period, late by up to one advance of 30ms
+  EXPECT_GE(fired, 90);
+  EXPECT_LE(fired, 100);
+
+  // Armed again at the tick it expired, it does not expire at once
+  TimerWheel<int> again(10, 0);
+  again.Add(100, 1);
+  EXPECT_EQ(std::vector<int>({1}), AdvanceTo(&again, 100));
+  again.Add(100, 1);
+  EXPECT_TRUE(AdvanceTo(&again, 109).empty());
+  EXPECT_EQ(std::vector<int>({1}), AdvanceTo(&again, 110));
+}
+
+TEST(TimerWheelTest, RearmAfterIdle) {
+  // The wheel jumps over the time it was empty, later timers are placed
+  // from the new time
+  TimerWheel<int> wheel(1, 0);
+  EXPECT_TRUE(AdvanceTo(&wheel, 50 * kMaxTicks).empty());
+  wheel.Add(50 * kMaxTicks + 100, 1);
+  EXPECT_TRUE(AdvanceTo(&wheel, 50 * kMaxTicks + 99).empty());
+  EXPECT_EQ(std::vector<int>({1}), AdvanceTo(&wheel, 50 * kMaxTicks + 100));
+}
+
+TEST(TimerWheelTest, Cancel) {
+  // Timers are not removed from the wheel, the owner drops those whose
+  // object has gone or which have been armed again, as a worker does
+  // with the weak_ptr of a conn
+  struct Timer {
+    std::weak_ptr<int> owner;
+    int generation;
+  };
+  TimerWheel<Timer> wheel(10, 0);
+  std::shared_ptr<int> closed = std::make_shared<int>(0);
+  std::shared_ptr<int> rearmed = std::make_shared<int>(0);
+  std::shared_ptr<int> kept = std::make_shared<int>(0);
+  wheel.Add(100, Timer{closed, 0});
+  wheel.Add(100, Timer{rearmed, 0});
+  wheel.Add(100, Timer{kept, 0});
+
+  closed.reset();
+  *rearmed = 1;
+  wheel.Add(5000, Timer{rearmed, 1});
+  EXPECT_EQ(4u, wheel.size());
+
+  std::vector<Timer> expired = AdvanceTo(&wheel, 100);
+  EXPECT_EQ(3u, expired.size());
+  int live = 0;
+  for (const auto& timer : expired) {
+    std::shared_ptr<int> owner = timer.owner.lock();
+    if (owner != nullptr && *owner == timer.generation) {
+      EXPECT_EQ(kept, owner);
+      live++;
+    }
+  }
+  EXPECT_EQ(1, live);
+
+  // The one armed again is still pending
+  EXPECT_EQ(1u, wheel.size());
+  expired = AdvanceTo(&wheel, 5000);
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(rearmed, expired[0].owner.lock());
+  EXPECT_EQ(1, expired[0].generation);
+}
@@ -7,18 +7,51 @@
 
 #include "pink/include/thread_pool.h"
 #include "pink/src/pink_thread_name.h"
+#include "pink/src/task_queue.h"
 
 namespace pink {
 
+static inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Spin rounds before a worker goes to sleep. A worker doubles its limit
+// when spinning found a task, and halves it when it went to sleep anyway
+static const int kMinSpinRounds = 1;
+static const int kMaxSpinRounds = 32;
+// Wait time of Schedule when every queue is full (ms)
+static const uint32_t kFullWaitTime = 10;
+
+ThreadPool::Worker::Worker(ThreadPool* tp, size_t index, size_t queue_size,
+                           const std::string& name)
+  : start_(false),
+    thread_pool_(tp),
+    index_(index),
+    worker_name_(name),
+    queue_(new TaskQueue(queue_size)),
+    cv_(&mu_),
+    sleeping_(false),
+    notified_(false),
+    spin_limit_(kMinSpinRounds) {
+}
+
+ThreadPool::Worker::~Worker() {
+  delete queue_;
+}
+
 void* ThreadPool::Worker::WorkerMain(void* arg) {
-  ThreadPool* tp = static_cast<ThreadPool*>(arg);
-  tp->runInThread();
+  Worker* worker = static_cast<Worker*>(arg);
+  worker->thread_pool_->runInThread(worker);
   return nullptr;
 }
 
 int ThreadPool::Worker::start() {
   if (!start_.load()) {
-    if (pthread_create(&thread_id_, NULL, &WorkerMain, thread_pool_)) {
+    if (pthread_create(&thread_id_, NULL, &WorkerMain, this)) {
       return -1;
     } else {
       if (!worker_name_.empty()) {
@@ -32,6 +65,7 @@ int ThreadPool::Worker::start() {
 
 int ThreadPool::Worker::stop() {
   if (start_.load()) {
+    Wakeup();
     if (pthread_join(thread_id_, nullptr)) {
       return -1;
     } else {
@@ -41,6 +75,12 @@ int ThreadPool::Worker::stop() {
   return 0;
 }
 
+void ThreadPool::Worker::Wakeup() {
+  slash::MutexLock l(&mu_);
+  notified_ = true;
+  cv_.Signal();
+}
+
 ThreadPool::ThreadPool(size_t worker_num,
                        size_t max_queue_size,
                        const std::string& thread_pool_name) :
@@ -50,8 +90,10 @@ ThreadPool::ThreadPool(size_t worker_num,
   running_(false),
   should_stop_(false),
   task_num_(0),
-  rsignal_(&mu_),
-  wsignal_(&mu_) {}
+  idle_num_(0),
+  next_queue_(0),
+  wsignal_(&mu_),
+  wait_num_(0) {}
 
 ThreadPool::~ThreadPool() {
   stop_thread_pool();
@@ -63,7 +105,17 @@ int ThreadPool::start_thread_pool() {
     for (size_t i = 0; i < worker_num_; ++i) {
       std::stringstream thread_name;
       thread_name << thread_pool_name_ << i;
-      workers_.push_back(new Worker(this, thread_name.str()));
+      // The queues hold max_queue_size_ tasks in all, and at least one
+      // each, or Schedule would never find room in them
+      size_t queue_size = max_queue_size_ / worker_num_
+        + (i < max_queue_size_ % worker_num_ ? 1 : 0);
+      if (queue_size == 0) {
+        queue_size = 1;
+      }
+      workers_.push_back(new Worker(this, i, queue_size, thread_name.str()));
+    }
+    // Start after all queues exist, workers steal from each other
+    for (size_t i = 0; i < worker_num_; ++i) {
       int res = workers_[i]->start();
       if (res != 0) {
         return kCreateThreadError;
@@ -78,17 +130,19 @@ int ThreadPool::stop_thread_pool() {
   int res = 0;
   if (running_.load()) {
     should_stop_.store(true);
-    rsignal_.SignalAll();
     wsignal_.SignalAll();
     for (const auto worker : workers_) {
       res = worker->stop();
       if (res != 0) {
         break;
-      } else {
+      }
+    }
+    if (res == 0) {
+      for (const auto worker : workers_) {
         delete worker;
       }
+      workers_.clear();
     }
-    workers_.clear();
     running_.store(false);
   }
   return res;
@@ -103,41 +157,122 @@ void ThreadPool::set_should_stop() {
 }
 
 void ThreadPool::Schedule(TaskFunc func, void* arg) {
-  mu_.Lock();
-  while (queue_.size() >= max_queue_size_ && !should_stop()) {
-    wsignal_.Wait();
-  }
-  if (!should_stop()) {
-    queue_.push(Task(func, arg));
-    task_num_++;
-    rsignal_.SignalAll();
+  task_num_++;
+  while (!should_stop()) {
+    // Producers start from different queues, so they seldom hit the same one
+    size_t start = next_queue_.fetch_add(1, std::memory_order_relaxed);
+    for (size_t i = 0; i < worker_num_; ++i) {
+      size_t index = (start + i) % worker_num_;
+      if (workers_[index]->queue_->TryPush(func, arg)) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (idle_num_.load() > 0) {
+          WakeupOne(index);
+        }
+        return;
+      }
+    }
+    // Every queue is full. A worker popping after our wait_num_++ signals
+    // under mu_, so it can not signal before we wait; one popping before
+    // has freed a slot that HasRoom sees
+    slash::MutexLock l(&mu_);
+    wait_num_++;
+    if (!HasRoom()) {
+      wsignal_.TimedWait(kFullWaitTime);
+    }
+    wait_num_--;
   }
-  mu_.Unlock();
+  task_num_--;
 }
 
 size_t ThreadPool::queue_size() {
   return max_queue_size_;
 }
 
-void ThreadPool::runInThread() {
+void ThreadPool::WakeupOne(size_t hint) {
+  for (size_t i = 0; i < worker_num_; ++i) {
+    Worker* worker = workers_[(hint + i) % worker_num_];
+    if (worker->sleeping_.load()) {
+      worker->Wakeup();
+      return;
+    }
+  }
+}
+
+bool ThreadPool::TryPop(Worker* worker, TaskFunc* func, void** arg) {
+  if (worker->queue_->TryPop(func, arg)) {
+    return true;
+  }
+  // Steal from the others
+  for (size_t i = 1; i < worker_num_; ++i) {
+    Worker* victim = workers_[(worker->index_ + i) % worker_num_];
+    if (victim->queue_->TryPop(func, arg)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::HasRoom() {
+  for (const auto worker : workers_) {
+    if (!worker->queue_->Full()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::HasTask() {
+  for (const auto worker : workers_) {
+    if (!worker->queue_->Empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::runInThread(Worker* worker) {
+  TaskFunc func;
+  void* arg;
+  int spin = 0;
   while (!should_stop()) {
-    mu_.Lock();
-    while (queue_.empty() && !should_stop()) {
-      rsignal_.Wait();
-    }
-    if (should_stop()) {
-      mu_.Unlock();
-      break;
-    }
-    if (!queue_.empty()) {
-      TaskFunc func = queue_.front().func;
-      void* arg = queue_.front().arg;
-      queue_.pop();
+    if (TryPop(worker, &func, &arg)) {
       task_num_--;
-      wsignal_.SignalAll();
-      mu_.Unlock();
+      if (wait_num_.load() > 0) {
+        slash::MutexLock l(&mu_);
+        wsignal_.Signal();
+      }
+      if (spin > 0 && worker->spin_limit_ < kMaxSpinRounds) {
+        worker->spin_limit_ *= 2;
+      }
+      spin = 0;
       (*func)(arg);
+      continue;
+    }
+
+    if (spin < worker->spin_limit_) {
+      spin++;
+      CpuRelax();
+      continue;
+    }
+    spin = 0;
+    if (worker->spin_limit_ > kMinSpinRounds) {
+      worker->spin_limit_ /= 2;
+    }
+
+    // Announce sleeping first, then check again, so a task scheduled
+    // meanwhile either is seen here or wakes us up
+    worker->sleeping_.store(true);
+    idle_num_++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!HasTask()) {
+      slash::MutexLock l(&worker->mu_);
+      while (!worker->notified_ && !should_stop()) {
+        worker->cv_.Wait();
+      }
+      worker->notified_ = false;
     }
+    idle_num_--;
+    worker->sleeping_.store(false);
   }
 }
 }  // namespace pink
@@ -0,0 +1,129 @@
+// Copyright (c) 2018-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef PINK_SRC_TIMER_WHEEL_H_
+#define PINK_SRC_TIMER_WHEEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+namespace pink {
+
+/*
+ * Hierarchical timer wheel, kLevels wheels of kSlots slots each, slots of
+ * level n span kSlots^n ticks. Adding a timer is O(1), advancing is
+ * O(ticks passed + timers expired), a timer is moved down at most
+ * kLevels - 1 times before it expires.
+ * Timers are never cancelled, the owner checks whether an expired value
+ * is still meaningful. Not thread safe, it belongs to one thread.
+ */
+template <typename T>
+class TimerWheel {
+ public:
+  TimerWheel(uint64_t tick_ms, uint64_t now_ms)
+      : tick_ms_(tick_ms > 0 ? tick_ms : 1),
+        current_tick_(now_ms / tick_ms_),
+        size_(0) {
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  /*
+   * Timers in the past expire on the next Advance, those too far away
+   * are clamped to the farthest tick the wheels hold
+   */
+  void Add(uint64_t when_ms, const T& value) {
+    uint64_t expire_tick = (when_ms + tick_ms_ - 1) / tick_ms_;
+    if (expire_tick <= current_tick_) {
+      expire_tick = current_tick_ + 1;
+    }
+    Place(Timer(expire_tick, value));
+    size_++;
+  }
+
+  /*
+   * Move the wheels to now_ms, append the values of expired timers
+   */
+  void Advance(uint64_t now_ms, std::vector<T>* expired) {
+    uint64_t target_tick = now_ms / tick_ms_;
+    if (size_ == 0 && target_tick > current_tick_) {
+      current_tick_ = target_tick;
+      return;
+    }
+    while (current_tick_ < target_tick) {
+      current_tick_++;
+      Cascade();
+      std::vector<Timer>& slot = wheels_[0][current_tick_ & kSlotMask];
+      for (auto& timer : slot) {
+        expired->push_back(std::move(timer.value));
+      }
+      size_ -= slot.size();
+      slot.clear();
+      if (size_ == 0) {
+        current_tick_ = target_tick;
+      }
+    }
+  }
+
+ private:
+  static const int kLevels = 4;
+  static const int kSlotBits = 6;
+  static const uint64_t kSlots = 1 << kSlotBits;
+  static const uint64_t kSlotMask = kSlots - 1;
+  static const uint64_t kMaxTicks = 1ULL << (kSlotBits * kLevels);
+
+  struct Timer {
+    Timer(uint64_t t, const T& v) : expire_tick(t), value(v) {}
+    uint64_t expire_tick;
+    T value;
+  };
+
+  uint64_t tick_ms_;
+  // Ticks not after it have been expired
+  uint64_t current_tick_;
+  size_t size_;
+  std::vector<Timer> wheels_[kLevels][kSlots];
+
+  void Place(Timer&& timer) {
+    if (timer.expire_tick - current_tick_ >= kMaxTicks) {
+      timer.expire_tick = current_tick_ + kMaxTicks - 1;
+    }
+    uint64_t delta = timer.expire_tick - current_tick_;
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (kSlots << (kSlotBits * level))) {
+      level++;
+    }
+    uint64_t index = (timer.expire_tick >> (kSlotBits * level)) & kSlotMask;
+    wheels_[level][index].push_back(std::move(timer));
+  }
+
+  /*
+   * When current_tick_ crosses the span of a higher level slot, spread
+   * its timers over the lower levels, the highest level first
+   */
+  void Cascade() {
+    int top = 0;
+    while (top < kLevels - 1 &&
+           (current_tick_ & ((1ULL << (kSlotBits * (top + 1))) - 1)) == 0) {
+      top++;
+    }
+    for (int level = top; level > 0; level--) {
+      uint64_t index = (current_tick_ >> (kSlotBits * level)) & kSlotMask;
+      std::vector<Timer> timers;
+      timers.swap(wheels_[level][index]);
+      for (auto& timer : timers) {
+        Place(std::move(timer));
+      }
+    }
+  }
+};
+
+}  // namespace pink
+#endif  // PINK_SRC_TIMER_WHEEL_H_
@@ -10,9 +10,24 @@
 #include "pink/include/pink_conn.h"
 #include "pink/src/pink_item.h"
 #include "pink/src/pink_epoll.h"
+#include "pink/src/server_socket.h"
 
 namespace pink {
 
+// Conns are checked at least this often, for buffer resizing and
+// keepalive_timeout changes
+static const int kConnTimerMaxSec = 60;
+static const uint64_t kConnTimerTickMs = 100;
+
+static uint64_t TimevalMs(const struct timeval& tv) {
+  return static_cast<uint64_t>(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+}
+
+static struct timeval CurrentTimeval() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now;
+}
 
 WorkerThread::WorkerThread(ConnFactory *conn_factory,
                            ServerThread* server_thread,
@@ -21,7 +36,14 @@ WorkerThread::WorkerThread(ConnFactory *conn_factory,
         server_thread_(server_thread),
         conn_factory_(conn_factory),
         cron_interval_(cron_interval),
-        keepalive_timeout_(kDefaultKeepAliveTime) {
+        keepalive_timeout_(kDefaultKeepAliveTime),
+        accept_num_(0),
+        conn_num_(0),
+        tasks_closed_(false),
+        conn_timers_(kConnTimerTickMs, TimevalMs(CurrentTimeval())) {
+  for (int i = 0; i < kMaxConnPages; i++) {
+    conn_pages_[i].store(nullptr, std::memory_order_relaxed);
+  }
   /*
    * install the protobuf handler here
    */
@@ -29,36 +51,116 @@ WorkerThread::WorkerThread(ConnFactory *conn_factory,
 }
 
 WorkerThread::~WorkerThread() {
+  for (auto socket_p : server_sockets_) {
+    delete socket_p;
+  }
+  for (int i = 0; i < kMaxConnPages; i++) {
+    delete conn_pages_[i].load();
+  }
   delete(pink_epoll_);
 }
 
-int WorkerThread::conn_num() const {
-  slash::ReadLock l(&rwlock_);
-  return conns_.size();
+std::shared_ptr<PinkConn>* WorkerThread::ConnSlot(int fd) const {
+  if (fd < 0 || fd >= kMaxConnPages * kConnPageSize) {
+    return nullptr;
+  }
+  ConnPage* page = conn_pages_[fd / kConnPageSize].load(std::memory_order_acquire);
+  if (page == nullptr) {
+    return nullptr;
+  }
+  return &(page->conns[fd % kConnPageSize]);
+}
+
+std::shared_ptr<PinkConn> WorkerThread::LoadConn(int fd) const {
+  std::shared_ptr<PinkConn>* slot = ConnSlot(fd);
+  if (slot == nullptr) {
+    return nullptr;
+  }
+  return std::atomic_load(slot);
+}
+
+bool WorkerThread::StoreConn(int fd, const std::shared_ptr<PinkConn>& conn) {
+  if (fd < 0 || fd >= kMaxConnPages * kConnPageSize) {
+    return false;
+  }
+  std::atomic<ConnPage*>& page = conn_pages_[fd / kConnPageSize];
+  if (page.load(std::memory_order_relaxed) == nullptr) {
+    page.store(new ConnPage(), std::memory_order_release);
+  }
+  std::atomic_store(&(page.load(std::memory_order_relaxed)->conns[fd % kConnPageSize]), conn);
+  return true;
+}
+
+std::shared_ptr<PinkConn> WorkerThread::RemoveConn(int fd) {
+  std::shared_ptr<PinkConn>* slot = ConnSlot(fd);
+  if (slot == nullptr) {
+    return nullptr;
+  }
+  // Exchange, so only one of the worker and a MoveConnOut caller
+  // gets the conn
+  std::shared_ptr<PinkConn> conn =
+    std::atomic_exchange(slot, std::shared_ptr<PinkConn>());
+  if (conn) {
+    conn_num_--;
+  }
+  return conn;
+}
+
+bool WorkerThread::PostTask(const std::function<void()>& task) {
+  pink_epoll_->notify_queue_lock();
+  if (tasks_closed_) {
+    pink_epoll_->notify_queue_unlock();
+    return false;
+  }
+  pink_epoll_->notify_queue_.push(PinkItem(task));
+  pink_epoll_->notify_queue_unlock();
+  write(pink_epoll_->notify_send_fd(), "", 1);
+  return true;
+}
+
+int WorkerThread::ListenReusePort(const std::set<std::string>& ips, int port) {
+  std::set<std::string> bind_ips = ips;
+  if (bind_ips.find("0.0.0.0") != bind_ips.end()) {
+    bind_ips.clear();
+    bind_ips.insert("0.0.0.0");
+  }
+  for (const auto& ip : bind_ips) {
+    ServerSocket* socket_p = new ServerSocket(port);
+    server_sockets_.push_back(socket_p);
+    socket_p->set_reuse_port(true);
+    int ret = socket_p->Listen(ip);
+    if (ret != kSuccess) {
+      return ret;
+    }
+    pink_epoll_->PinkAddEvent(socket_p->sockfd(), EPOLLIN | EPOLLERR | EPOLLHUP);
+    server_fds_.insert(socket_p->sockfd());
+  }
+  return kSuccess;
 }
 
 std::vector<ServerThread::ConnInfo> WorkerThread::conns_info() const {
   std::vector<ServerThread::ConnInfo> result;
-  slash::ReadLock l(&rwlock_);
-  for (auto& conn : conns_) {
-    result.push_back({
-                      conn.first,
-                      conn.second->ip_port(),
-                      conn.second->last_interaction()
-                     });
+  for (int i = 0; i < kMaxConnPages; i++) {
+    if (conn_pages_[i].load(std::memory_order_acquire) == nullptr) {
+      continue;
+    }
+    for (int fd = i * kConnPageSize; fd < (i + 1) * kConnPageSize; fd++) {
+      std::shared_ptr<PinkConn> conn = LoadConn(fd);
+      if (conn) {
+        result.push_back({fd, conn->ip_port(), conn->last_interaction(),
+                          conn->pending_reply_len()});
+      }
+    }
   }
   return result;
 }
 
 std::shared_ptr<PinkConn> WorkerThread::MoveConnOut(int fd) {
-  slash::WriteLock l(&rwlock_);
-  std::shared_ptr<PinkConn> conn = nullptr;
-  auto iter = conns_.find(fd);
-  if (iter != conns_.end()) {
-    int fd = iter->first;
-    conn = iter->second;
+  // Never wait for the worker, it may be blocked in scheduling a task
+  // to the pool thread calling us
+  std::shared_ptr<PinkConn> conn = RemoveConn(fd);
+  if (conn) {
     pink_epoll_->PinkDelEvent(fd);
-    conns_.erase(iter);
   }
   return conn;
 }
@@ -81,6 +183,10 @@ void *WorkerThread::ThreadMain() {
     timeout = PINK_CRON_INTERVAL;
   }
 
+  pink_epoll_->notify_queue_lock();
+  tasks_closed_ = false;
+  pink_epoll_->notify_queue_unlock();
+
   while (!should_stop()) {
     if (cron_interval_ > 0) {
       gettimeofday(&now, NULL);
@@ -109,33 +215,15 @@ void *WorkerThread::ThreadMain() {
             for (int32_t idx = 0; idx < nread; ++idx) {
               {
                 pink_epoll_->notify_queue_lock();
-                ti = pink_epoll_->notify_queue_.front();
+                ti = std::move(pink_epoll_->notify_queue_.front());
                 pink_epoll_->notify_queue_.pop();
                 pink_epoll_->notify_queue_unlock();
               }
 
-              if (ti.notify_type() == kNotiConnect) {
-                std::shared_ptr<PinkConn> tc = conn_factory_->NewPinkConn(
-                    ti.fd(), ti.ip_port(),
-                    server_thread_, private_data_, pink_epoll_);
-                if (!tc || !tc->SetNonblock()) {
-                  continue;
-                }
-
-#ifdef __ENABLE_SSL
-                // Create SSL failed
-                if (server_thread_->security() &&
-                  !tc->CreateSSL(server_thread_->ssl_ctx())) {
-                  CloseFd(tc);
-                  continue;
-                }
-#endif
-
-                {
-                  slash::WriteLock l(&rwlock_);
-                  conns_[ti.fd()] = tc;
-                }
-                pink_epoll_->PinkAddEvent(ti.fd(), EPOLLIN);
+              if (ti.notify_type() == kNotiTask) {
+                ti.task()();
+              } else if (ti.notify_type() == kNotiConnect) {
+                NewConn(ti.fd(), ti.ip_port());
               } else if (ti.notify_type() == kNotiClose) {
                 // should close?
               } else if (ti.notify_type() == kNotiEpollout) {
@@ -143,28 +231,36 @@ void *WorkerThread::ThreadMain() {
               } else if (ti.notify_type() == kNotiEpollin) {
                 pink_epoll_->PinkModEvent(ti.fd(), 0, EPOLLIN);
               } else if (ti.notify_type() == kNotiEpolloutAndEpollin) {
-                pink_epoll_->PinkModEvent(ti.fd(), 0, EPOLLOUT | EPOLLIN);
+                ReplyQueued(ti.fd(), now.tv_sec);
               }
             }
           }
         } else {
           continue;
         }
+      } else if (server_fds_.find(pfe->fd) != server_fds_.end()) {
+        if (pfe->mask & EPOLLIN) {
+          std::string ip_port;
+          int connfd = server_thread_->AcceptConn(pfe->fd, &ip_port);
+          if (connfd >= 0) {
+            NewConn(connfd, ip_port);
+          }
+        } else if (pfe->mask & (EPOLLHUP | EPOLLERR)) {
+          // error on the listen fd, other workers still accept
+          log_warn("listen fd %d error, stop accepting on it", pfe->fd);
+          pink_epoll_->PinkDelEvent(pfe->fd);
+          server_fds_.erase(pfe->fd);
+        }
       } else {
         in_conn = NULL;
         int should_close = 0;
         if (pfe == NULL) {
           continue;
         }
-        {
-          slash::ReadLock l(&rwlock_);
-          std::map<int, std::shared_ptr<PinkConn>>::iterator iter = conns_.find(pfe->fd);
-          if (iter == conns_.end()) {
-            pink_epoll_->PinkDelEvent(pfe->fd);
-            continue;
-          }
-
-          in_conn = iter->second;
+        in_conn = LoadConn(pfe->fd);
+        if (in_conn == nullptr) {
+          pink_epoll_->PinkDelEvent(pfe->fd);
+          continue;
         }
 
         if ((pfe->mask & EPOLLOUT) && in_conn->is_reply()) {
@@ -173,7 +269,9 @@ void *WorkerThread::ThreadMain() {
           if (write_status == kWriteAll) {
             pink_epoll_->PinkModEvent(pfe->fd, 0, EPOLLIN);
             in_conn->set_is_reply(false);
-          } else if (write_status == kWriteHalf) {
+          } else if (write_status == kWriteHalf
+                     && !in_conn->OutputBufferOverLimit(now.tv_sec)) {
+            CheckOutputBuffer(pfe->fd, in_conn);
             continue;
           } else {
             should_close = 1;
@@ -181,6 +279,13 @@ void *WorkerThread::ThreadMain() {
         }
 
         if (!should_close && (pfe->mask & EPOLLIN)) {
+          // Leave the requests in the socket till the replies are sent
+          uint64_t pause_len = GetOutputBufferPauseLen();
+          if (pause_len > 0 && in_conn->is_reply()
+              && in_conn->pending_reply_len() >= pause_len) {
+            pink_epoll_->PinkModEvent(pfe->fd, 0, EPOLLOUT);
+            continue;
+          }
           ReadStatus read_status = in_conn->GetRequest();
           in_conn->set_last_interaction(now);
           if (read_status == kReadAll) {
@@ -189,19 +294,31 @@ void *WorkerThread::ThreadMain() {
             // Mod Event to EPOLLOUT
           } else if (read_status == kReadHalf) {
             continue;
+          } else if (read_status == kReadReplied) {
+            // Nothing went to a thread pool, send the reply and read on
+            WriteStatus write_status = in_conn->SendReply();
+            if (write_status == kWriteAll) {
+              in_conn->set_is_reply(false);
+              continue;
+            } else if (write_status == kWriteHalf) {
+              ReplyQueued(pfe->fd, now.tv_sec);
+              continue;
+            } else {
+              should_close = 1;
+            }
           } else {
             should_close = 1;
           }
         }
 
         if ((pfe->mask & EPOLLERR) || (pfe->mask & EPOLLHUP) || should_close) {
-          {
-            slash::WriteLock l(&rwlock_);
-            pink_epoll_->PinkDelEvent(pfe->fd);
+          pink_epoll_->PinkDelEvent(pfe->fd);
+          // EPOLLERR and EPOLLHUP still come after a pool thread moved
+          // the conn out, the fd is not ours to close then
+          if (RemoveConn(pfe->fd)) {
             CloseFd(in_conn);
-            in_conn = NULL;
-            conns_.erase(pfe->fd);
           }
+          in_conn = NULL;
         }
       }  // connection event
     }  // for (int i = 0; i < nfds; i++)
@@ -211,79 +328,198 @@ void *WorkerThread::ThreadMain() {
   return NULL;
 }
 
-void WorkerThread::DoCronTask() {
-  struct timeval now;
-  gettimeofday(&now, NULL);
-  slash::WriteLock l(&rwlock_);
+void WorkerThread::NewConn(int connfd, const std::string& ip_port) {
+  std::shared_ptr<PinkConn> tc = conn_factory_->NewPinkConn(
+      connfd, ip_port, server_thread_, private_data_, pink_epoll_);
+  if (!tc || !tc->SetNonblock()) {
+    return;
+  }
 
-  // Check whether close all connection
-  slash::MutexLock kl(&killer_mutex_);
-  if (deleting_conn_ipport_.count(kKillAllConnsTask)) {
-    for (auto& conn : conns_) {
-      CloseFd(conn.second);
-    }
-    conns_.clear();
-    deleting_conn_ipport_.clear();
+#ifdef __ENABLE_SSL
+  // Create SSL failed
+  if (server_thread_->security() &&
+    !tc->CreateSSL(server_thread_->ssl_ctx())) {
+    CloseFd(tc);
     return;
   }
+#endif
+
+  if (!StoreConn(connfd, tc)) {
+    log_warn("fd %d out of the conn table, close it", connfd);
+    CloseFd(tc);
+    return;
+  }
+  conn_num_++;
+  pink_epoll_->PinkAddEvent(connfd, EPOLLIN);
+  accept_num_++;
+  ArmConnTimer(connfd, tc, tc->last_interaction());
+}
 
-  std::map<int, std::shared_ptr<PinkConn>>::iterator iter = conns_.begin();
-  while (iter != conns_.end()) {
-    std::shared_ptr<PinkConn> conn = iter->second;
-    // Check connection should be closed
-    if (deleting_conn_ipport_.count(conn->ip_port())) {
+void WorkerThread::ArmConnTimer(int fd, const std::shared_ptr<PinkConn>& conn,
+                                const struct timeval& now) {
+  // Only the cron advances the timers
+  if (cron_interval_ <= 0) {
+    return;
+  }
+  int keepalive_timeout = keepalive_timeout_;
+  uint64_t when = TimevalMs(now) + kConnTimerMaxSec * 1000;
+  if (keepalive_timeout > 0) {
+    // Timed out once idle for more than keepalive_timeout seconds
+    struct timeval last = conn->last_interaction();
+    uint64_t deadline = (static_cast<uint64_t>(last.tv_sec)
+                         + keepalive_timeout + 1) * 1000;
+    if (deadline < when) {
+      when = deadline;
+    }
+  }
+  conn_timers_.Add(when, ConnTimer{fd, conn});
+}
+
+void WorkerThread::CheckOutputBuffer(int fd,
+                                     const std::shared_ptr<PinkConn>& conn) {
+  if (conn->over_soft_limit()) {
+    soft_limit_fds_.insert(fd);
+  }
+}
+
+void WorkerThread::ReplyQueued(int fd, time_t now) {
+  std::shared_ptr<PinkConn> conn = LoadConn(fd);
+  if (conn == nullptr) {
+    pink_epoll_->PinkModEvent(fd, 0, EPOLLOUT | EPOLLIN);
+    return;
+  }
+  if (conn->OutputBufferOverLimit(now)) {
+    log_warn("%s output buffer %lu over limit, close it",
+             conn->ip_port().c_str(), conn->pending_reply_len());
+    pink_epoll_->PinkDelEvent(fd);
+    if (RemoveConn(fd)) {
       CloseFd(conn);
-      deleting_conn_ipport_.erase(conn->ip_port());
-      iter = conns_.erase(iter);
+    }
+    return;
+  }
+  CheckOutputBuffer(fd, conn);
+  uint64_t pause_len = GetOutputBufferPauseLen();
+  if (pause_len > 0 && conn->pending_reply_len() >= pause_len) {
+    pink_epoll_->PinkModEvent(fd, 0, EPOLLOUT);
+  } else {
+    pink_epoll_->PinkModEvent(fd, 0, EPOLLOUT | EPOLLIN);
+  }
+}
+
+void WorkerThread::DoCronTask() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  std::vector<ConnTimer> expired;
+  conn_timers_.Advance(TimevalMs(now), &expired);
+  for (const auto& timer : expired) {
+    std::shared_ptr<PinkConn> conn = LoadConn(timer.fd);
+    if (conn == nullptr || conn != timer.conn.lock()) {
+      // Closed or moved out since the timer was armed
       continue;
     }
 
     // Check keepalive timeout connection
-    if (keepalive_timeout_ > 0 &&
-        (now.tv_sec - conn->last_interaction().tv_sec > keepalive_timeout_)) {
-      CloseFd(conn);
-      server_thread_->handle_->FdTimeoutHandle(conn->fd(), conn->ip_port());
-      iter = conns_.erase(iter);
+    int keepalive_timeout = keepalive_timeout_;
+    if (keepalive_timeout > 0 &&
+        (now.tv_sec - conn->last_interaction().tv_sec > keepalive_timeout)) {
+      pink_epoll_->PinkDelEvent(timer.fd);
+      // Moved out since the load, the timer is dropped
+      if (RemoveConn(timer.fd)) {
+        CloseFd(conn);
+        server_thread_->handle_->FdTimeoutHandle(conn->fd(), conn->ip_port());
+      }
       continue;
     }
 
     // Maybe resize connection buffer
     conn->TryResizeBuffer();
+    ArmConnTimer(timer.fd, conn, now);
+  }
 
-    ++iter;
+  // Replies stay unsent while the client does not read
+  for (auto iter = soft_limit_fds_.begin(); iter != soft_limit_fds_.end(); ) {
+    int fd = *iter;
+    std::shared_ptr<PinkConn> conn = LoadConn(fd);
+    if (conn == nullptr) {
+      iter = soft_limit_fds_.erase(iter);
+    } else if (conn->OutputBufferOverLimit(now.tv_sec)) {
+      log_warn("%s output buffer %lu over limit, close it",
+               conn->ip_port().c_str(), conn->pending_reply_len());
+      pink_epoll_->PinkDelEvent(fd);
+      if (RemoveConn(fd)) {
+        CloseFd(conn);
+      }
+      iter = soft_limit_fds_.erase(iter);
+    } else if (!conn->over_soft_limit()) {
+      iter = soft_limit_fds_.erase(iter);
+    } else {
+      ++iter;
+    }
   }
 }
 
 bool WorkerThread::TryKillConn(const std::string& ip_port) {
   bool find = false;
   if (ip_port != kKillAllConnsTask) {
-    slash::ReadLock l(&rwlock_);
-    for (auto& iter : conns_) {
-      if (iter.second->ip_port() == ip_port) {
+    std::vector<ServerThread::ConnInfo> infos = conns_info();
+    for (auto& info : infos) {
+      if (info.ip_port == ip_port) {
         find = true;
         break;
       }
     }
   }
   if (find || ip_port == kKillAllConnsTask) {
-    slash::MutexLock l(&killer_mutex_);
-    deleting_conn_ipport_.insert(ip_port);
+    PostTask(std::bind(&WorkerThread::KillConns, this, ip_port));
     return true;
   }
   return false;
 }
 
+void WorkerThread::KillConns(const std::string& ip_port) {
+  for (int i = 0; i < kMaxConnPages; i++) {
+    if (conn_pages_[i].load(std::memory_order_relaxed) == nullptr) {
+      continue;
+    }
+    for (int fd = i * kConnPageSize; fd < (i + 1) * kConnPageSize; fd++) {
+      std::shared_ptr<PinkConn> conn = LoadConn(fd);
+      if (conn == nullptr) {
+        continue;
+      }
+      if (ip_port == kKillAllConnsTask || conn->ip_port() == ip_port) {
+        pink_epoll_->PinkDelEvent(fd);
+        conn = RemoveConn(fd);
+        if (conn) {
+          CloseFd(conn);
+        }
+      }
+    }
+  }
+}
+
 void WorkerThread::CloseFd(std::shared_ptr<PinkConn> conn) {
   close(conn->fd());
   server_thread_->handle_->FdClosedHandle(conn->fd(), conn->ip_port());
 }
 
 void WorkerThread::Cleanup() {
-  slash::WriteLock l(&rwlock_);
-  for (auto& iter : conns_) {
-    CloseFd(iter.second);
+  // Run the tasks left, so nothing posted is lost
+  std::queue<PinkItem> left;
+  pink_epoll_->notify_queue_lock();
+  tasks_closed_ = true;
+  left.swap(pink_epoll_->notify_queue_);
+  pink_epoll_->notify_queue_unlock();
+  while (!left.empty()) {
+    if (left.front().notify_type() == kNotiTask) {
+      left.front().task()();
+    } else if (left.front().notify_type() == kNotiConnect) {
+      close(left.front().fd());
+    }
+    left.pop();
   }
-  conns_.clear();
+
+  KillConns(kKillAllConnsTask);
 }
 
 };  // namespace pink
@@ -20,6 +20,7 @@
 
 #include "pink/include/server_thread.h"
 #include "pink/src/pink_epoll.h"
+#include "pink/src/timer_wheel.h"
 #include "pink/include/pink_thread.h"
 #include "pink/include/pink_define.h"
 
@@ -30,6 +31,7 @@ class PinkEpoll;
 class PinkFiredEvent;
 class PinkConn;
 class ConnFactory;
+class ServerSocket;
 
 class WorkerThread : public Thread {
  public:
@@ -42,10 +44,20 @@ class WorkerThread : public Thread {
     keepalive_timeout_ = timeout;
   }
 
-  int conn_num() const;
+  int conn_num() const {
+    return conn_num_;
+  }
 
   std::vector<ServerThread::ConnInfo> conns_info() const;
 
+  bool HasConn(int fd) const {
+    return LoadConn(fd) != nullptr;
+  }
+
+  /*
+   * Take the conn out of the table and the epoll set in the calling
+   * thread, never waits for the worker thread
+   */
   std::shared_ptr<PinkConn> MoveConnOut(int fd);
 
 
@@ -54,9 +66,16 @@ class WorkerThread : public Thread {
   }
   bool TryKillConn(const std::string& ip_port);
 
+  /*
+   * Listen on ips:port with SO_REUSEPORT, so this worker accepts
+   * connections by itself instead of getting them from dispatch thread.
+   * Must be called before StartThread
+   */
+  int ListenReusePort(const std::set<std::string>& ips, int port);
 
-  mutable slash::RWMutex rwlock_; /* For external statistics */
-  std::map<int, std::shared_ptr<PinkConn>> conns_;
+  uint64_t accept_num() const {
+    return accept_num_;
+  }
 
   void* private_data_;
 
@@ -73,11 +92,67 @@ class WorkerThread : public Thread {
 
   std::atomic<int> keepalive_timeout_;  // keepalive second
 
+  /*
+   * Listen sockets owned by this worker in reuse port mode
+   */
+  std::vector<ServerSocket*> server_sockets_;
+  std::set<int> server_fds_;
+  std::atomic<uint64_t> accept_num_;
+
+  /*
+   * Connections indexed by fd. Pages are allocated on demand and never
+   * freed before destruction, so the table does not move.
+   * Only the worker thread fills the slots, by std::atomic_store; slots
+   * are read by std::atomic_load and cleared by std::atomic_exchange, so
+   * MoveConnOut can clear one from other threads, other changes are sent
+   * through the notify queue as kNotiTask
+   */
+  static const int kConnPageSize = 1024;
+  static const int kMaxConnPages = 1024;
+  struct ConnPage {
+    std::shared_ptr<PinkConn> conns[kConnPageSize];
+  };
+  std::atomic<ConnPage*> conn_pages_[kMaxConnPages];
+  std::atomic<int> conn_num_;
+
+  // Refuse tasks once Cleanup started
+  bool tasks_closed_;
+
+  /*
+   * Every conn has an idle timer, due when it would time out if it stays
+   * idle. Activity only updates last_interaction, the cron checks the due
+   * conns and rearms those active since, so it never walks all conns.
+   * Timers of closed conns are dropped when they are due
+   */
+  struct ConnTimer {
+    int fd;
+    std::weak_ptr<PinkConn> conn;
+  };
+  TimerWheel<ConnTimer> conn_timers_;
+  // Conns over the soft limit of their output buffer, checked by the cron
+  std::set<int> soft_limit_fds_;
+
+  std::shared_ptr<PinkConn>* ConnSlot(int fd) const;
+  std::shared_ptr<PinkConn> LoadConn(int fd) const;
+  bool StoreConn(int fd, const std::shared_ptr<PinkConn>& conn);
+  std::shared_ptr<PinkConn> RemoveConn(int fd);
+
+  bool PostTask(const std::function<void()>& task);
+
   virtual void *ThreadMain() override;
   void DoCronTask();
 
-  slash::Mutex killer_mutex_;
-  std::set<std::string> deleting_conn_ipport_;
+  void NewConn(int connfd, const std::string& ip_port);
+  void ArmConnTimer(int fd, const std::shared_ptr<PinkConn>& conn,
+                    const struct timeval& now);
+  void CheckOutputBuffer(int fd, const std::shared_ptr<PinkConn>& conn);
+  /*
+   * Called when the replies of an asynchronous request are queued, close
+   * the conn if they are over its output buffer limit, and stop reading
+   * from it while they are many
+   */
+  void ReplyQueued(int fd, time_t now);
+  void KillConns(const std::string& ip_port);
 
   // clean conns
   void CloseFd(std::shared_ptr<PinkConn> conn);
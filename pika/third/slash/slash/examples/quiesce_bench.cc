@@ -0,0 +1,77 @@
+// Copyright (c) 2015-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+/*
+ * Read side cost of pthread_rwlock_t against QuiesceMutex, when every
+ * thread takes the read lock around a tiny critical section, the way
+ * pika takes the server lock around each command.
+ * usage: quiesce_bench [max threads] [seconds per run]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "slash/include/env.h"
+#include "slash/include/slash_mutex.h"
+
+using namespace slash;
+
+static std::atomic<bool> stop;
+
+template <typename ReadFunc>
+static double Run(int thread_num, int seconds, ReadFunc read) {
+  std::atomic<uint64_t> total(0);
+  stop.store(false);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < thread_num; i++) {
+    threads.emplace_back([&]() {
+      uint64_t ops = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        read();
+        ops++;
+      }
+      total += ops;
+    });
+  }
+  SleepForMicroseconds(seconds * 1000000);
+  stop.store(true);
+  for (auto& t : threads) {
+    t.join();
+  }
+  return total.load() / 1000000.0 / seconds;
+}
+
+int main(int argc, char* argv[]) {
+  int max_threads = argc > 1 ? atoi(argv[1]) : 64;
+  int seconds = argc > 2 ? atoi(argv[2]) : 2;
+
+  pthread_rwlock_t rwlock;
+  pthread_rwlock_init(&rwlock, NULL);
+  QuiesceMutex quiesce;
+  volatile uint64_t shared = 0;
+
+  printf("%8s %20s %20s\n", "threads", "rwlock(Mops/s)", "quiesce(Mops/s)");
+  for (int n = 1; n <= max_threads; n *= 2) {
+    double rw = Run(n, seconds, [&]() {
+      pthread_rwlock_rdlock(&rwlock);
+      uint64_t v = shared;
+      (void)v;
+      pthread_rwlock_unlock(&rwlock);
+    });
+    double qs = Run(n, seconds, [&]() {
+      quiesce.ReadLock();
+      uint64_t v = shared;
+      (void)v;
+      quiesce.ReadUnlock();
+    });
+    printf("%8d %20.2f %20.2f\n", n, rw, qs);
+  }
+  pthread_rwlock_destroy(&rwlock);
+  return 0;
+}
@@ -2,6 +2,7 @@
 #define SLASH_MUTEXLOCK_H_
 
 #include <pthread.h>
+#include <atomic>
 #include <string>
 #include <unordered_map>
 
@@ -96,6 +97,64 @@ class WriteLock {
   void operator=(const WriteLock&);
 };
 
+/*
+ * Reader writer lock for a read side taken all the time and a write side
+ * taken rarely. A reader only bumps the counter of its own thread slot,
+ * so readers on different cores share no cache line. A writer stops new
+ * readers and waits for the counters of all slots to drain.
+ *
+ * Like a writer preferring rwlock, a thread must not take the read side
+ * again while it holds it, a writer waiting between would deadlock.
+ */
+class QuiesceMutex {
+ public:
+  QuiesceMutex();
+  ~QuiesceMutex();
+
+  void ReadLock();
+  // Fails at once while a writer holds or waits for the lock
+  bool TryReadLock();
+  void ReadUnlock();
+  void WriteLock();
+  void WriteUnlock();
+
+ private:
+  static const int kSlotNum = 256;
+
+  struct Slot {
+    std::atomic<int64_t> readers;
+    char pad[64 - sizeof(std::atomic<int64_t>)];
+  };
+
+  Slot* ThreadSlot();
+
+  Slot slots_[kSlotNum];
+  std::atomic<bool> writing_;
+
+  // Writers queue and blocked readers sleep on mu_
+  Mutex mu_;
+  CondVar* cv_;
+
+  // No copying
+  QuiesceMutex(const QuiesceMutex&);
+  void operator=(const QuiesceMutex&);
+};
+
+class QuiesceWriteLock {
+ public:
+  explicit QuiesceWriteLock(QuiesceMutex* mu)
+      : mu_(mu) {
+    this->mu_->WriteLock();
+  }
+  ~QuiesceWriteLock() { this->mu_->WriteUnlock(); }
+
+ private:
+  QuiesceMutex *const mu_;
+  // No copying allowed
+  QuiesceWriteLock(const QuiesceWriteLock&);
+  void operator=(const QuiesceWriteLock&);
+};
+
 class CondVar {
  public:
   explicit CondVar(Mutex* mu);
@@ -1,8 +1,10 @@
 #include "slash/include/slash_mutex.h"
 
 #include <cstdlib>
+#include <sched.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/time.h>
 
 namespace slash {
@@ -71,6 +73,86 @@ void RWMutex::ReadUnlock() {
   PthreadCall("rw read unlock", pthread_rwlock_unlock(&rw_mu_));
 }
 
+// Threads get slots round robin, more threads than slots share them
+static std::atomic<uint32_t> quiesce_next_slot(0);
+static thread_local int quiesce_thread_slot = -1;
+
+QuiesceMutex::QuiesceMutex()
+  : writing_(false),
+    cv_(new CondVar(&mu_)) {
+  for (int i = 0; i < kSlotNum; i++) {
+    slots_[i].readers.store(0, std::memory_order_relaxed);
+  }
+}
+
+QuiesceMutex::~QuiesceMutex() {
+  delete cv_;
+}
+
+QuiesceMutex::Slot* QuiesceMutex::ThreadSlot() {
+  if (quiesce_thread_slot < 0) {
+    quiesce_thread_slot = quiesce_next_slot.fetch_add(1) % kSlotNum;
+  }
+  return &slots_[quiesce_thread_slot];
+}
+
+void QuiesceMutex::ReadLock() {
+  Slot* slot = ThreadSlot();
+  while (true) {
+    // Pairs with the store and loads in WriteLock, both sides are seq_cst
+    // so one of them must see the other
+    slot->readers.fetch_add(1, std::memory_order_seq_cst);
+    if (!writing_.load(std::memory_order_seq_cst)) {
+      return;
+    }
+    slot->readers.fetch_sub(1, std::memory_order_release);
+    MutexLock l(&mu_);
+    while (writing_.load(std::memory_order_relaxed)) {
+      cv_->Wait();
+    }
+  }
+}
+
+bool QuiesceMutex::TryReadLock() {
+  Slot* slot = ThreadSlot();
+  slot->readers.fetch_add(1, std::memory_order_seq_cst);
+  if (!writing_.load(std::memory_order_seq_cst)) {
+    return true;
+  }
+  slot->readers.fetch_sub(1, std::memory_order_release);
+  return false;
+}
+
+void QuiesceMutex::ReadUnlock() {
+  ThreadSlot()->readers.fetch_sub(1, std::memory_order_release);
+}
+
+void QuiesceMutex::WriteLock() {
+  {
+    MutexLock l(&mu_);
+    while (writing_.load(std::memory_order_relaxed)) {
+      cv_->Wait();
+    }
+    writing_.store(true, std::memory_order_seq_cst);
+  }
+  for (int i = 0; i < kSlotNum; i++) {
+    int spins = 0;
+    while (slots_[i].readers.load(std::memory_order_seq_cst) != 0) {
+      if (++spins < 100) {
+        sched_yield();
+      } else {
+        usleep(100);
+      }
+    }
+  }
+}
+
+void QuiesceMutex::WriteUnlock() {
+  MutexLock l(&mu_);
+  writing_.store(false, std::memory_order_seq_cst);
+  cv_->SignalAll();
+}
+
 CondVar::CondVar(Mutex* mu)
   : mu_(mu) {
     pthread_condattr_t condattr;
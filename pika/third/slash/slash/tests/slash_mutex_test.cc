@@ -0,0 +1,90 @@
+// Copyright (c) 2015-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "slash/include/slash_mutex.h"
+#include "slash/include/slash_testharness.h"
+
+namespace slash {
+
+class QuiesceMutexTest { };
+
+TEST(QuiesceMutexTest, WriterExcludesReaders) {
+  QuiesceMutex mu;
+  // Written in two steps by the writer, readers must never see them differ
+  volatile int64_t a = 0, b = 0;
+  std::atomic<bool> stop(false);
+  std::atomic<int64_t> torn(0), reads(0);
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 8; i++) {
+    readers.emplace_back([&]() {
+      while (!stop.load()) {
+        mu.ReadLock();
+        if (a != b) {
+          torn++;
+        }
+        mu.ReadUnlock();
+        reads++;
+      }
+    });
+  }
+  for (int i = 0; i < 2000; i++) {
+    mu.WriteLock();
+    a = a + 1;
+    std::this_thread::yield();
+    b = b + 1;
+    mu.WriteUnlock();
+  }
+  stop.store(true);
+  for (auto& t : readers) {
+    t.join();
+  }
+  ASSERT_EQ(0, torn.load());
+  ASSERT_EQ(2000, b);
+  ASSERT_TRUE(reads.load() > 0);
+}
+
+TEST(QuiesceMutexTest, WriterWaitsForReaders) {
+  QuiesceMutex mu;
+  std::atomic<bool> in_read(false), written(false);
+  std::atomic<bool> written_in_read(false);
+  std::thread reader([&]() {
+    mu.ReadLock();
+    in_read.store(true);
+    usleep(100000);
+    // The writer is blocked until we leave, checked by the main thread,
+    // ASSERT_* does not fail the test from here
+    written_in_read.store(written.load());
+    mu.ReadUnlock();
+  });
+  while (!in_read.load()) {
+  }
+  mu.WriteLock();
+  written.store(true);
+  mu.WriteUnlock();
+  reader.join();
+  ASSERT_TRUE(!written_in_read.load());
+}
+
+TEST(QuiesceMutexTest, TryReadLockFailsWhileWriting) {
+  QuiesceMutex mu;
+  ASSERT_TRUE(mu.TryReadLock());
+  mu.ReadUnlock();
+
+  mu.WriteLock();
+  ASSERT_TRUE(!mu.TryReadLock());
+  mu.WriteUnlock();
+
+  ASSERT_TRUE(mu.TryReadLock());
+  mu.ReadUnlock();
+}
+
+}  // namespace slash
@@ -0,0 +1,252 @@
+// Copyright (c) 2015-present, Qihoo, Inc.  All rights reserved.
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+#include "pink/include/pink_cli.h"
+#include "pink/include/redis_cli.h"
+
+/*
+ * Replay the binlog of a master on a fresh slave and measure how fast the
+ * slave applies it. The slave trysyncs from the start of every binlog
+ * shard, so the master must still have its first binlog files.
+ */
+
+static void Usage() {
+  fprintf(stderr,
+          "Usage: binlog_replay_bench [-h] -m master_ip:port -s slave_ip:port [-w] [-n items -k keys -v value_len -p pipeline -t timeout]\n"
+          "\tbinlog_replay_bench writes items to the master if asked, points a fresh slave at it\n"
+          "\tand waits until the slave logged and applied the whole binlog of the master\n"
+          "\t-h     -- show this help\n"
+          "\t-m     -- master, its binlog is replayed\n"
+          "\t-s     -- slave, empty with the same binlog-shard-num as the master\n"
+          "\t-n     -- items to write to the master first, default: 0, the binlog it has, captured or not\n"
+          "\t-k     -- keys the items are spread over, default: 100000\n"
+          "\t-v     -- value length, default: 64\n"
+          "\t-p     -- items sent at once, default: 100\n"
+          "\t-t     -- seconds to wait for the slave, default: 600\n"
+          "\t-w     -- turn readonly off on the slave after slaveof, as for a slave clients write to\n"
+          "  example: ./binlog_replay_bench -m 127.0.0.1:9221 -s 127.0.0.1:9231 -n 1000000\n"
+         );
+}
+
+static uint64_t NowMicros() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+static bool ParseAddr(const char* addr, std::string* ip, int* port) {
+  const char* colon = strrchr(addr, ':');
+  if (colon == NULL) {
+    return false;
+  }
+  ip->assign(addr, colon - addr);
+  *port = atoi(colon + 1);
+  return *port > 0;
+}
+
+static pink::PinkCli* Connect(const std::string& ip, int port) {
+  pink::PinkCli* cli = pink::NewRedisCli();
+  cli->set_connect_timeout(1000);
+  Status s = cli->Connect(ip, port);
+  if (!s.ok()) {
+    fprintf(stderr, "Connect %s:%d failed, %s\n", ip.c_str(), port, s.ToString().c_str());
+    exit(-1);
+  }
+  return cli;
+}
+
+static std::string Command(pink::PinkCli* cli, const pink::RedisCmdArgsType& argv) {
+  std::string cmd;
+  pink::SerializeRedisCommand(argv, &cmd);
+  Status s = cli->Send(&cmd);
+  pink::RedisCmdArgsType reply;
+  if (s.ok()) {
+    s = cli->Recv(&reply);
+  }
+  if (!s.ok()) {
+    fprintf(stderr, "%s failed, %s\n", argv[0].c_str(), s.ToString().c_str());
+    exit(-1);
+  }
+  return reply.empty() ? "" : reply[0];
+}
+
+// The value of field in an INFO reply, empty if it is not there
+static std::string InfoField(const std::string& info, const std::string& field) {
+  std::string key = "\n" + field + ":";
+  size_t pos = ("\n" + info).find(key);
+  if (pos == std::string::npos) {
+    return "";
+  }
+  pos += key.size() - 1;
+  size_t end = info.find_first_of("\r\n", pos);
+  return info.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+}
+
+// "filenum offset" of every binlog shard
+static std::vector<std::string> BinlogOffsets(pink::PinkCli* cli) {
+  std::string info = Command(cli, {"info", "log"});
+  std::vector<std::string> offsets;
+  offsets.push_back(InfoField(info, "binlog_offset"));
+  for (int i = 1; ; i++) {
+    std::string offset = InfoField(info, "binlog_offset_shard" + std::to_string(i));
+    if (offset.empty()) {
+      break;
+    }
+    offsets.push_back(offset);
+  }
+  return offsets;
+}
+
+static void WriteItems(pink::PinkCli* cli, long items, long keys, int value_len, int pipeline) {
+  std::string value(value_len, 'v');
+  std::string batch;
+  long sent = 0;
+  uint64_t start = NowMicros();
+  while (sent < items) {
+    batch.clear();
+    int n = 0;
+    for (; n < pipeline && sent < items; n++, sent++) {
+      std::string cmd;
+      pink::SerializeRedisCommand(
+          {"set", "replay_bench_" + std::to_string(random() % keys), value}, &cmd);
+      batch.append(cmd);
+    }
+    Status s = cli->Send(&batch);
+    for (int i = 0; s.ok() && i < n; i++) {
+      s = cli->Recv(NULL);
+    }
+    if (!s.ok()) {
+      fprintf(stderr, "Write items failed, %s\n", s.ToString().c_str());
+      exit(-1);
+    }
+  }
+  uint64_t us = NowMicros() - start;
+  fprintf(stderr, "Wrote %ld items to the master in %.2fs, %.0f items/s\n",
+          items, us / 1e6, items * 1e6 / us);
+}
+
+int main(int argc, char *argv[]) {
+  std::string master_ip, slave_ip;
+  int master_port = 0, slave_port = 0;
+  long items = 0, keys = 100000;
+  int value_len = 64, pipeline = 100, timeout = 600;
+  bool writable = false;
+  int c;
+  while (-1 != (c = getopt(argc, argv, "hm:s:n:k:v:p:t:w"))) {
+    switch (c) {
+      case 'm':
+        if (!ParseAddr(optarg, &master_ip, &master_port)) {
+          Usage();
+          exit(-1);
+        }
+        break;
+      case 's':
+        if (!ParseAddr(optarg, &slave_ip, &slave_port)) {
+          Usage();
+          exit(-1);
+        }
+        break;
+      case 'n': items = atol(optarg); break;
+      case 'k': keys = atol(optarg) > 0 ? atol(optarg) : 1; break;
+      case 'v': value_len = atoi(optarg); break;
+      case 'p': pipeline = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+      case 't': timeout = atoi(optarg); break;
+      case 'w': writable = true; break;
+      default:
+        Usage();
+        exit(-1);
+    }
+  }
+  if (master_port == 0 || slave_port == 0) {
+    Usage();
+    exit(-1);
+  }
+
+  pink::PinkCli* master = Connect(master_ip, master_port);
+  pink::PinkCli* slave = Connect(slave_ip, slave_port);
+  if (items > 0) {
+    WriteItems(master, items, keys, value_len, pipeline);
+  }
+
+  std::vector<std::string> target = BinlogOffsets(master);
+  std::vector<std::string> begin = BinlogOffsets(slave);
+  if (target.size() != begin.size()) {
+    fprintf(stderr, "binlog-shard-num differs, master %zu, slave %zu\n",
+            target.size(), begin.size());
+    exit(-1);
+  }
+  for (size_t i = 0; i < begin.size(); i++) {
+    if (begin[i] != "0 0") {
+      fprintf(stderr, "The slave is not fresh, binlog shard %zu at %s\n", i, begin[i].c_str());
+      exit(-1);
+    }
+  }
+
+  // A fresh slave trysyncs at 0 0 of every shard, so it gets the whole
+  // binlog of the master, "slaveof ip port filenum offset" would not do
+  // with several binlog shards
+  std::string reply = Command(slave, {"slaveof", master_ip, std::to_string(master_port)});
+  if (reply != "OK") {
+    fprintf(stderr, "slaveof failed, %s\n", reply.c_str());
+    exit(-1);
+  }
+  // slaveof turns readonly on, whatever slave-read-only says
+  if (writable) {
+    reply = Command(slave, {"readonly", "off"});
+    if (reply != "OK") {
+      fprintf(stderr, "readonly off failed, %s\n", reply.c_str());
+      exit(-1);
+    }
+  }
+
+  uint64_t slaveof_time = NowMicros();
+  uint64_t first_time = 0;
+  uint64_t peak_qps = 0;
+  while (true) {
+    std::vector<std::string> offsets = BinlogOffsets(slave);
+    std::string repl = Command(slave, {"info", "replication"});
+    std::string pending = InfoField(repl, "repl_apply_pending");
+    uint64_t qps = strtoull(InfoField(repl, "repl_apply_ops_per_sec").c_str(), NULL, 10);
+    if (qps > peak_qps) {
+      peak_qps = qps;
+    }
+    if (first_time == 0 && offsets != begin) {
+      first_time = NowMicros();
+    }
+    // Servers without repl_apply_pending apply as they log
+    if (offsets == target && (pending.empty() || pending == "0")) {
+      break;
+    }
+    if (NowMicros() - slaveof_time > static_cast<uint64_t>(timeout) * 1000000) {
+      fprintf(stderr, "Timeout, the slave is at %s, the master at %s\n",
+              offsets[0].c_str(), target[0].c_str());
+      exit(-1);
+    }
+    usleep(10000);
+  }
+  uint64_t end_time = NowMicros();
+  if (first_time == 0) {
+    first_time = end_time;
+  }
+
+  fprintf(stderr, "Replayed in %.2fs, %.2fs after slaveof, peak repl_apply_ops_per_sec %lu\n",
+          (end_time - first_time) / 1e6, (end_time - slaveof_time) / 1e6, peak_qps);
+  if (items > 0 && end_time > first_time) {
+    fprintf(stderr, "%.0f items/s\n", items * 1e6 / (end_time - first_time));
+  }
+
+  delete master;
+  delete slave;
+  return 0;
+}
@@ -191,7 +191,7 @@ Status Binlog::Put(const std::string &item) {
   }
 
   int pro_offset;
-  s = Produce(Slice(item.data(), item.size()), &pro_offset);
+  s = Produce(Slice(item.data(), item.size()), false, &pro_offset);
   if (s.ok()) {
     slash::RWLock(&(version_->rwlock_), true);
     //version_->plus_item_num();
@@ -204,7 +204,7 @@ Status Binlog::Put(const std::string &item) {
 }
 
 // Note: mutex lock should be held
-Status Binlog::Put(const char* item, int len) {
+Status Binlog::Put(const char* item, int len, bool compressed) {
   Status s;
 
   /* Check to roll log file */
@@ -231,7 +231,7 @@ Status Binlog::Put(const char* item, int len) {
   }
 
   int pro_offset;
-  s = Produce(Slice(item, len), &pro_offset);
+  s = Produce(Slice(item, len), compressed, &pro_offset);
   if (s.ok()) {
     slash::RWLock(&(version_->rwlock_), true);
     version_->pro_offset_ = pro_offset;
@@ -243,7 +243,7 @@ Status Binlog::Put(const char* item, int len) {
   return s;
 }
  
-Status Binlog::EmitPhysicalRecord(RecordType t, const char *ptr, size_t n, int *temp_pro_offset) {
+Status Binlog::EmitPhysicalRecord(RecordType t, bool compressed, const char *ptr, size_t n, int *temp_pro_offset) {
     Status s;
     assert(n <= 0xffffff);
     assert(block_offset_ + kHeaderSize + n <= kBlockSize);
@@ -261,7 +261,7 @@ Status Binlog::EmitPhysicalRecord(RecordType t, const char *ptr, size_t n, int *
     buf[4] = static_cast<char>((now & 0xff00) >> 8);
     buf[5] = static_cast<char>((now & 0xff0000) >> 16);
     buf[6] = static_cast<char>((now & 0xff000000) >> 24);
-    buf[7] = static_cast<char>(t);
+    buf[7] = static_cast<char>(compressed ? (t | kRecordCompressed) : static_cast<unsigned int>(t));
 
     s = queue_->Append(Slice(buf, kHeaderSize));
     if (s.ok()) {
@@ -279,7 +279,7 @@ Status Binlog::EmitPhysicalRecord(RecordType t, const char *ptr, size_t n, int *
     return s;
 }
 
-Status Binlog::Produce(const Slice &item, int *temp_pro_offset) {
+Status Binlog::Produce(const Slice &item, bool compressed, int *temp_pro_offset) {
   Status s;
   const char *ptr = item.data();
   size_t left = item.size();
@@ -313,7 +313,7 @@ Status Binlog::Produce(const Slice &item, int *temp_pro_offset) {
       type = kMiddleType;
     }
 
-    s = EmitPhysicalRecord(type, ptr, fragment_length, temp_pro_offset);
+    s = EmitPhysicalRecord(type, compressed, ptr, fragment_length, temp_pro_offset);
     ptr += fragment_length;
     left -= fragment_length;
     begin = false;
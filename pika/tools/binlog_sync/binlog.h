@@ -40,7 +40,8 @@ class Binlog
   void Unlock()       { mutex_.Unlock(); }
 
   Status Put(const std::string &item);
-  Status Put(const char* item, int len);
+  // compressed if the item is compressed by the master, see kRecordCompressed
+  Status Put(const char* item, int len, bool compressed = false);
 
   Status GetProducerStatus(uint32_t* filenum, uint64_t* pro_offset);
   /*
@@ -62,13 +63,13 @@ class Binlog
  private:
 
   void InitLogFile();
-  Status EmitPhysicalRecord(RecordType t, const char *ptr, size_t n, int *temp_pro_offset);
+  Status EmitPhysicalRecord(RecordType t, bool compressed, const char *ptr, size_t n, int *temp_pro_offset);
 
 
   /*
    * Produce
    */
-  Status Produce(const Slice &item, int *pro_offset);
+  Status Produce(const Slice &item, bool compressed, int *pro_offset);
 
   uint32_t consumer_num_;
   uint64_t item_num_;
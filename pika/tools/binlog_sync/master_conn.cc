@@ -7,6 +7,7 @@
 #include "master_conn.h"
 #include "binlog_receiver_thread.h"
 #include "binlog_sync.h"
+#include "pika_binlog_item.h"
 
 extern BinlogSync *g_binlog_sync;
 
@@ -34,6 +35,16 @@ int MasterConn::DealMessage() {
     return -2;
   }
 
+  // Keep the compressed item as it is, so the binlog agrees with the master's
+  if (argv_.size() == 2 && argv_[0] == kBinlogCompressedCmd) {
+    g_binlog_sync->logger()->Put(argv_[1].data(), argv_[1].size(), true);
+    return 0;
+  }
+  if (argv_.size() == 2 && argv_[0] == kBinlogBinaryCmd) {
+    g_binlog_sync->logger()->Put(argv_[1]);
+    return 0;
+  }
+
   RestoreArgs();
 
   //g_binlog_sync->logger_->Lock();
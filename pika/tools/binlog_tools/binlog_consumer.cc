@@ -8,9 +8,11 @@
 
 #include <glog/logging.h>
 #include <poll.h>
+#include <snappy.h>
 #include <iostream>
 
 #include "pika_define.h"
+#include "pika_binlog_item.h"
 
 using slash::Status;
 using slash::Slice;
@@ -91,10 +93,12 @@ Status BinlogConsumer::Consume(std::string &scratch, uint64_t* produce_time) {
   }
 
   slash::Slice fragment;
+  bool compressed = false;
   while (true) {
     const unsigned int record_type = ReadPhysicalRecord(&fragment, produce_time);
+    compressed = (record_type & kRecordCompressed) != 0;
 
-    switch (record_type) {
+    switch (record_type & ~kRecordCompressed) {
       case kFullType:
         scratch = std::string(fragment.data(), fragment.size());
         s = Status::OK();
@@ -125,6 +129,21 @@ Status BinlogConsumer::Consume(std::string &scratch, uint64_t* produce_time) {
       break;
     }
   }
+  if (compressed) {
+    std::string item;
+    if (!snappy::Uncompress(scratch.data(), scratch.size(), &item)) {
+      return Status::IOError("Data Corruption");
+    }
+    scratch.swap(item);
+  }
+  // The tools take commands, a binary item goes back to resp
+  if (IsBinaryBinlogItem(scratch)) {
+    std::string resp;
+    if (!BinlogItemToResp(scratch, &resp)) {
+      return Status::IOError("Data Corruption");
+    }
+    scratch.swap(resp);
+  }
   return Status::OK();
 }
 
@@ -277,7 +296,7 @@ uint64_t NewBinlogConsumer::GetNext(bool &is_error) {
     const uint32_t a = static_cast<uint32_t>(header[0]) & 0xff;
     const uint32_t b = static_cast<uint32_t>(header[1]) & 0xff;
     const uint32_t c = static_cast<uint32_t>(header[2]) & 0xff;
-    const unsigned int type = header[7];
+    const unsigned int type = static_cast<unsigned char>(header[7]) & ~kRecordCompressed;
     const uint32_t length = a | (b << 8) | (c << 16);
 
     if (type == kFullType) {
@@ -325,7 +344,7 @@ unsigned int NewBinlogConsumer::ReadPhysicalRecord(slash::Slice *result, uint64_
   const uint32_t e = static_cast<uint32_t>(header[4]) & 0xff;
   const uint32_t f = static_cast<uint32_t>(header[5]) & 0xff;
   const uint32_t g = static_cast<uint32_t>(header[6]) & 0xff;
-  const unsigned int type = header[7];
+  const unsigned int type = static_cast<unsigned char>(header[7]);
   const uint32_t length = a | (b << 8) | (c << 16);
   *produce_time = d | (e << 8) | (f << 16) | (g << 24);
   if (type == kZeroType || length == 0) {